@@ -0,0 +1,90 @@
+#include "arena.hpp"
+
+// system includes
+#include <new>
+
+const std::size_t Arena::ALIGN;
+
+Arena* Arena::active = nullptr;
+
+Arena::Arena(std::size_t blockSize)
+    : blockSize(blockSize), block(0), ptr(nullptr), end(nullptr) {
+}
+
+Arena::~Arena() {
+    for (Block& b : blocks) {
+        ::operator delete(b.begin);
+    }
+}
+
+void Arena::nextBlock(std::size_t bytes) {
+    // reuse the blocks kept after a reset or release first
+    std::size_t next = blocks.empty() ? 0 : block + 1;
+    for (; next < blocks.size(); ++next) {
+        if (static_cast<std::size_t>(blocks[next].end - blocks[next].begin) >= bytes) {
+            block = next;
+            ptr = blocks[next].begin;
+            end = blocks[next].end;
+            return;
+        }
+    }
+
+    std::size_t size = bytes > blockSize ? bytes : blockSize;
+    Block b;
+    b.begin = static_cast<char*>(::operator new(size));
+    b.end = b.begin + size;
+    blocks.push_back(b);
+    block = blocks.size() - 1;
+    ptr = b.begin;
+    end = b.end;
+}
+
+Arena::Mark Arena::mark() const {
+    Mark m;
+    m.block = block;
+    m.ptr = ptr;
+    return m;
+}
+
+void Arena::release(const Mark& mark) {
+    if (blocks.empty()) {
+        return;
+    }
+    block = mark.block;
+    ptr = (mark.ptr != nullptr) ? mark.ptr : blocks[block].begin;
+    end = blocks[block].end;
+}
+
+void Arena::reset() {
+    block = 0;
+    ptr = blocks.empty() ? nullptr : blocks[0].begin;
+    end = blocks.empty() ? nullptr : blocks[0].end;
+}
+
+std::size_t Arena::capacity() const {
+    std::size_t total = 0;
+    for (const Block& b : blocks) {
+        total += b.end - b.begin;
+    }
+    return total;
+}
+
+ArenaScope::ArenaScope(Arena* arena) : previous(Arena::active) {
+    Arena::active = arena;
+}
+
+ArenaScope::~ArenaScope() {
+    Arena::active = previous;
+}
+
+ArenaRegion::ArenaRegion() : arena(Arena::current()), start() {
+    if (arena != nullptr) {
+        start = arena->mark();
+    }
+}
+
+ArenaRegion::~ArenaRegion() {
+    if (arena != nullptr) {
+        arena->release(start);
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// An Arena is a bump-pointer region allocator. Allocation is a pointer
+// increment, individual frees are no-ops, and everything is released at
+// once by reset() or back to a mark by release(). Blocks are kept for
+// reuse until the arena is destroyed.
+class Arena {
+public:
+  // a position in the arena to release back to
+  struct Mark {
+    std::size_t block;
+    char * ptr;
+  };
+
+  explicit Arena(std::size_t blockSize = 64 * 1024);
+  ~Arena();
+
+  void * allocate(std::size_t bytes) {
+    bytes = (bytes + ALIGN - 1) & ~(ALIGN - 1);
+    if (static_cast<std::size_t>(end - ptr) < bytes) {
+      nextBlock(bytes);
+    }
+    void * p = ptr;
+    ptr += bytes;
+    return p;
+  }
+
+  Mark mark() const;
+  void release(const Mark & mark);
+  void reset();
+
+  // bytes reserved in blocks
+  std::size_t capacity() const;
+
+  // the arena ArenaAllocator draws from, nullptr for the heap
+  static Arena * current() { return active; }
+
+  // every allocation is aligned like malloc
+  static const std::size_t ALIGN = alignof(std::max_align_t);
+
+private:
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  void nextBlock(std::size_t bytes);
+
+  struct Block {
+    char * begin;
+    char * end;
+  };
+
+  std::size_t blockSize;
+  std::vector<Block> blocks;
+  std::size_t block;
+  char * ptr;
+  char * end;
+
+  friend class ArenaScope;
+  static Arena * active;
+};
+
+// Routes ArenaAllocator to an arena, or to the heap for nullptr, for the
+// lifetime of the scope. Anything that must outlive the arena has to be
+// created under an ArenaScope(nullptr).
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena * arena);
+  ~ArenaScope();
+
+private:
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope & operator=(const ArenaScope &) = delete;
+
+  Arena * previous;
+};
+
+// Releases the current arena back to where it was when the region began,
+// for temporaries that are known not to escape
+class ArenaRegion {
+public:
+  ArenaRegion();
+  ~ArenaRegion();
+
+private:
+  ArenaRegion(const ArenaRegion &) = delete;
+  ArenaRegion & operator=(const ArenaRegion &) = delete;
+
+  Arena * arena;
+  Arena::Mark start;
+};
+
+// allocate from the current arena, or the heap when there is none,
+// each block is tagged so it can be freed correctly either way
+const std::size_t ARENA_HEADER = Arena::ALIGN;
+const std::uintptr_t HEAP_TAG = 0;
+const std::uintptr_t ARENA_TAG = 1;
+
+inline void * arena_allocate(std::size_t bytes) {
+  Arena * arena = Arena::current();
+  char * p;
+  std::uintptr_t tag;
+  if (arena != nullptr) {
+    p = static_cast<char *>(arena->allocate(ARENA_HEADER + bytes));
+    tag = ARENA_TAG;
+  }
+  else {
+    p = static_cast<char *>(::operator new(ARENA_HEADER + bytes));
+    tag = HEAP_TAG;
+  }
+  *reinterpret_cast<std::uintptr_t *>(p) = tag;
+  return p + ARENA_HEADER;
+}
+
+inline void arena_deallocate(void * p) noexcept {
+  char * block = static_cast<char *>(p) - ARENA_HEADER;
+  if (*reinterpret_cast<std::uintptr_t *>(block) == HEAP_TAG) {
+    ::operator delete(block);
+  }
+}
+
+// A standard allocator over the current arena
+template <typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  ArenaAllocator() noexcept {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &) noexcept {}
+
+  T * allocate(std::size_t n) {
+    return static_cast<T *>(arena_allocate(n * sizeof(T)));
+  }
+  void deallocate(T * p, std::size_t) noexcept {
+    arena_deallocate(p);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &) { return false; }
+
+#endif
@@ -0,0 +1,846 @@
+// Benchmarks for the slisp interpreter on large generated scenes.
+// Not part of the test suite, build the slisp_bench target in Release
+// mode and run: slisp_bench [scale]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "interpreter.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// an Interpreter that exposes its AST and backends for measurement
+class BenchInterpreter : public Interpreter {
+public:
+    const Expression& tree() const { return ast; }
+
+    Chunk compileTree() const { return VM::compile(ast, env); }
+    Expression runChunk(const Chunk& chunk) { return vm.run(chunk, env, graphics); }
+
+    // as evalForm(), the closure lives in the arena with the AST
+    Closure compileClosure() {
+        ArenaScope scope(arenaEnabled ? &arena : nullptr);
+        return Closure::compile(ast, env);
+    }
+    Expression runClosure(const Closure& closure) {
+        ArenaScope scope(arenaEnabled ? &arena : nullptr);
+        return closure.run(env, graphics);
+    }
+
+    std::size_t arenaBytes() const { return arena.capacity(); }
+
+    OptimizerStats optimizeTree() {
+        ArenaScope scope(arenaEnabled ? &arena : nullptr);
+        Optimizer optimizer(env);
+        optimizer.optimize(ast);
+        return optimizer.stats();
+    }
+};
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Write wheel i of a scene, a rim and eight spokes of the given radius
+void writeWheel(std::ostream& out, std::size_t i, const std::string& radius) {
+    double x = static_cast<double>(i % 100) * 30;
+    double y = static_cast<double>(i / 100) * 30;
+    out << " (define rim" << i << " (arc (point " << x << " " << y << ") (point (+ "
+        << x << " " << radius << ") " << y << ") (* 2 pi)))\n";
+    out << " (draw rim" << i << ")\n";
+    out << " (draw";
+    for (int k = 0; k < 8; ++k) {
+        out << " (line (point " << x << " " << y << ") (point (+ " << x
+            << " (* " << radius << " (cos (/ (* " << k << " pi) 4)))) (- " << y
+            << " (* " << radius << " (sin (/ (* " << k << " pi) 4))))))";
+    }
+    out << ")\n";
+}
+
+// Generate a scene of `wheels` wheels, each with a rim and eight spokes,
+// in the style of tests/test_car.slp
+std::string generateScene(std::size_t wheels) {
+    std::ostringstream out;
+    out << "(begin\n";
+    for (std::size_t i = 0; i < wheels; ++i) {
+        writeWheel(out, i, "10");
+    }
+    out << ")\n";
+    return out.str();
+}
+
+// Generate the scene of generateScene with its first wheel sized by
+// the global radius, to be redefined
+std::string generateRadiusScene(std::size_t wheels) {
+    std::ostringstream out;
+    out << "(begin\n (define radius 10)\n";
+    for (std::size_t i = 0; i < wheels; ++i) {
+        writeWheel(out, i, i == 0 ? "radius" : "10");
+    }
+    out << ")\n";
+    return out.str();
+}
+
+// Generate a compute-heavy program of `terms` nested arithmetic and
+// comparison expressions that define nothing, so it can be rerun
+std::string generateArithmetic(std::size_t terms) {
+    std::ostringstream out;
+    out << "(begin\n";
+    for (std::size_t i = 0; i < terms; ++i) {
+        out << " (if (< (+ (* " << i << " 0.5) (- 3 (/ " << i % 7 + 1 << " 2))) (* 2 (+ 1 2 3 4)))"
+            << " (+ (* 3 (- " << i << " 1)) (/ (+ 1 " << i << ") 4))"
+            << " (- (* 2 (+ " << i << " 1 2 3)) (* 4 (- 5 (/ 6 " << i % 5 + 1 << ")))))\n";
+    }
+    out << ")\n";
+    return out.str();
+}
+
+// Generate the scene of generateScene with for loops instead of
+// unrolled forms, for a whole number of rows of up to 100 wheels
+std::string generateLoopScene(std::size_t wheels) {
+    std::size_t cols = wheels < 100 ? wheels : 100;
+    std::ostringstream out;
+    out << "(begin\n"
+        << " (for (row 0 " << wheels / cols << ")\n"
+        << "  (for (col 0 " << cols << ")\n"
+        << "   (draw (arc (point (* 30 col) (* 30 row)) (point (+ (* 30 col) 10) (* 30 row)) (* 2 pi)))\n"
+        << "   (for (k 0 8)\n"
+        << "    (draw (line (point (* 30 col) (* 30 row)) (point (+ (* 30 col) (* 10 (cos (/ (* k pi) 4))))"
+        << " (- (* 30 row) (* 10 (sin (/ (* k pi) 4))))))))))\n"
+        << ")\n";
+    return out.str();
+}
+
+// Generate a scene of `shapes` global numbers, every one of which a
+// loop reads 100 times, to time references to many globals
+std::string generateGlobals(std::size_t shapes) {
+    std::ostringstream out;
+    out << "(begin\n";
+    for (std::size_t i = 0; i < shapes; ++i) {
+        out << " (define x" << i << " " << i << ")\n";
+    }
+    out << " (for (k 0 100) (+";
+    for (std::size_t i = 0; i < shapes; ++i) {
+        out << " x" << i;
+    }
+    out << "))\n)\n";
+    return out.str();
+}
+
+// Generate a scene that defines `shapes` helper arcs and draws only
+// every tenth of them, like a generated script drawing a subset
+std::string generateHelpers(std::size_t shapes) {
+    std::ostringstream out;
+    out << "(begin\n";
+    for (std::size_t i = 0; i < shapes; ++i) {
+        out << " (define h" << i << " (arc (point " << i << " 0) (point (+ " << i << " 5) 0) (/ pi 2)))\n";
+    }
+    out << " (draw";
+    for (std::size_t i = 0; i < shapes; i += 10) {
+        out << " h" << i;
+    }
+    out << ")\n)\n";
+    return out.str();
+}
+
+// Generate a circle of `segments` lines, drawn by one unrolled draw
+// of every line or by a map over a range
+std::string generateCurve(std::size_t segments, bool lazy) {
+    const double step = 2 * std::atan2(0, -1) / segments;
+    std::ostringstream out;
+    out << "(begin\n (define r 100)\n (draw";
+    if (lazy) {
+        out << " (map (i (range " << segments << ")) (line (point (* r (cos (* i " << step << ")))"
+            << " (* r (sin (* i " << step << ")))) (point (* r (cos (* (+ i 1) " << step << ")))"
+            << " (* r (sin (* (+ i 1) " << step << "))))))";
+    }
+    else {
+        for (std::size_t i = 0; i < segments; ++i) {
+            out << "\n  (line (point (* r (cos " << i * step << ")) (* r (sin " << i * step << ")))"
+                << " (point (* r (cos " << (i + 1) * step << ")) (* r (sin " << (i + 1) * step << "))))";
+        }
+    }
+    out << "))\n";
+    return out.str();
+}
+
+// Generate a binary tree of lines `depth` levels deep, drawn by two
+// recursive user procedures, 2^(depth+1) - 1 calls of branch and
+// 2^depth - 1 of grow
+std::string generateTree(std::size_t depth) {
+    std::ostringstream out;
+    out << "(begin\n"
+        << " (define grow (lambda (x y ex ey len angle depth)\n"
+        << "  (begin (draw (line (point x y) (point ex ey)))\n"
+        << "   (branch ex ey (* len 0.7) (+ angle 0.5) (- depth 1))\n"
+        << "   (branch ex ey (* len 0.7) (- angle 0.5) (- depth 1)))))\n"
+        << " (define branch (lambda (x y len angle depth)\n"
+        << "  (if (< depth 1) 0\n"
+        << "   (grow x y (+ x (* len (cos angle))) (+ y (* len (sin angle))) len angle depth))))\n"
+        << " (branch 0 0 100 (/ pi 2) " << depth << "))\n";
+    return out.str();
+}
+
+// Generate a Koch curve of 4^depth lines, 2 * 4^depth - 1 calls: each
+// koch above the last level calls split, which with peak makes four
+// calls of koch
+std::string generateKoch(std::size_t depth) {
+    std::ostringstream out;
+    out << "(begin\n"
+        << " (define koch (lambda (x1 y1 x2 y2 depth)\n"
+        << "  (if (< depth 1) (draw (line (point x1 y1) (point x2 y2)))\n"
+        << "   (split x1 y1 (/ (- x2 x1) 3) (/ (- y2 y1) 3) (- depth 1)))))\n"
+        << " (define split (lambda (x y dx dy depth)\n"
+        << "  (begin (koch x y (+ x dx) (+ y dy) depth)\n"
+        << "   (peak (+ x dx) (+ y dy) dx dy depth)\n"
+        << "   (koch (+ x dx dx) (+ y dy dy) (+ x dx dx dx) (+ y dy dy dy) depth))))\n"
+        << " (define peak (lambda (x y dx dy depth)\n"
+        << "  (begin (koch x y (+ x (- (* dx 0.5) (* dy 0.866025))) (+ y (* dx 0.866025) (* dy 0.5)) depth)\n"
+        << "   (koch (+ x (- (* dx 0.5) (* dy 0.866025))) (+ y (* dx 0.866025) (* dy 0.5)) (+ x dx) (+ y dy) depth))))\n"
+        << " (koch 0 0 300 0 " << depth << "))\n";
+    return out.str();
+}
+
+// Generate a chain of `depth` nested additions, (+ 1 (+ 1 ... 1))
+std::string generateDeep(std::size_t depth) {
+    std::string out;
+    for (std::size_t i = 0; i < depth; ++i) {
+        out += "(+ 1 ";
+    }
+    return out + "1" + std::string(depth, ')');
+}
+
+// Generate a single addition of `width` numbers
+std::string generateWide(std::size_t width) {
+    std::ostringstream out;
+    out << "(+";
+    for (std::size_t i = 0; i < width; ++i) {
+        out << " " << i % 10;
+    }
+    out << ")\n";
+    return out.str();
+}
+
+// number of nodes in an expression tree
+std::size_t countNodes(const Expression& exp) {
+    std::size_t n = 1;
+    for (const Expression& sub : exp.tail) {
+        n += countNodes(sub);
+    }
+    return n;
+}
+
+// bytes held by an expression tree, counting each node once
+// plus the unused capacity of every tail vector
+std::size_t treeBytes(const Expression& exp) {
+    std::size_t bytes = exp.tail.capacity() * sizeof(Expression);
+    for (const Expression& sub : exp.tail) {
+        bytes += treeBytes(sub);
+    }
+    return bytes;
+}
+
+void benchScene(std::size_t wheels, int reps, bool useArena) {
+    std::string program = generateScene(wheels);
+
+    double parseTime = 0;
+    double evalTime = 0;
+    std::size_t nodes = 0;
+    std::size_t bytes = 0;
+    for (int r = 0; r < reps; ++r) {
+        BenchInterpreter interp;
+        interp.setArenaEnabled(useArena);
+        std::istringstream in(program);
+
+        Clock::time_point start = Clock::now();
+        if (!interp.parse(in)) {
+            std::cerr << "Error: generated scene failed to parse" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        parseTime += secondsSince(start);
+
+        nodes = countNodes(interp.tree());
+        bytes = sizeof(Expression) + treeBytes(interp.tree());
+
+        start = Clock::now();
+        interp.eval();
+        evalTime += secondsSince(start);
+    }
+
+    std::cout << "scene: " << wheels << " wheels, " << program.size() << " bytes of source, "
+              << nodes << " nodes, " << (useArena ? "arena" : "heap") << "\n";
+    std::cout << "  bytes/node     " << std::fixed << std::setprecision(1)
+              << static_cast<double>(bytes) / nodes << "\n";
+    std::cout << "  parse          " << std::setprecision(3) << 1e3 * parseTime / reps << " ms\n";
+    std::cout << "  eval           " << 1e3 * evalTime / reps << " ms, "
+              << std::setprecision(1) << nodes * reps / evalTime / 1e6 << " Mnodes/s\n";
+}
+
+// parse and tree eval time of a program whose lists are nested up to
+// depth deep
+void benchNesting(const std::string& name, const std::string& program, std::size_t depth, int reps) {
+    double parseTime = 0;
+    double evalTime = 0;
+    for (int r = 0; r < reps; ++r) {
+        BenchInterpreter interp;
+        interp.setMaxNesting(depth);
+        std::istringstream in(program);
+
+        Clock::time_point start = Clock::now();
+        if (!interp.parse(in)) {
+            std::cerr << "Error: generated " << name << " program failed to parse" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        parseTime += secondsSince(start);
+
+        start = Clock::now();
+        interp.eval();
+        evalTime += secondsSince(start);
+    }
+
+    std::cout << "nesting: " << name << ", " << program.size() << " bytes of source, depth " << depth << "\n";
+    std::cout << "  parse          " << std::fixed << std::setprecision(3) << 1e3 * parseTime / reps << " ms, "
+              << std::setprecision(1) << program.size() * reps / parseTime / 1e6 << " MB/s\n";
+    std::cout << "  tree eval      " << std::setprecision(3) << 1e3 * evalTime / reps << " ms\n";
+}
+
+// a scene written with loops against the same scene unrolled
+void benchLoops(std::size_t wheels, int reps) {
+    const char* names[] = { "unrolled", "loop" };
+    for (int looped = 0; looped < 2; ++looped) {
+        std::string program = looped ? generateLoopScene(wheels) : generateScene(wheels);
+
+        double parseTime = 0;
+        double evalTime = 0;
+        std::size_t nodes = 0;
+        std::size_t bytes = 0;
+        std::size_t drawn = 0;
+        for (int r = 0; r < reps; ++r) {
+            BenchInterpreter interp;
+            std::istringstream in(program);
+
+            Clock::time_point start = Clock::now();
+            if (!interp.parse(in)) {
+                std::cerr << "Error: generated scene failed to parse" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            parseTime += secondsSince(start);
+            nodes = countNodes(interp.tree());
+
+            start = Clock::now();
+            interp.eval();
+            evalTime += secondsSince(start);
+            bytes = interp.arenaBytes();
+            drawn = interp.getGraphicsVector().size();
+        }
+
+        std::cout << "loops: " << wheels << " wheels " << names[looped] << ", " << program.size()
+                  << " bytes of source, " << nodes << " nodes, " << drawn << " graphics\n";
+        std::cout << "  arena          " << bytes / 1024 << " KiB\n";
+        std::cout << "  parse          " << std::fixed << std::setprecision(3) << 1e3 * parseTime / reps << " ms\n";
+        std::cout << "  eval           " << 1e3 * evalTime / reps << " ms\n";
+    }
+}
+
+// a parametric curve drawn lazily by map against the same curve unrolled
+void benchCurve(std::size_t segments, int reps) {
+    const char* names[] = { "unrolled", "map" };
+    for (int lazy = 0; lazy < 2; ++lazy) {
+        std::string program = generateCurve(segments, lazy != 0);
+
+        double totalTime = 0;
+        std::size_t nodes = 0;
+        std::size_t bytes = 0;
+        std::size_t drawn = 0;
+        for (int r = 0; r < reps; ++r) {
+            BenchInterpreter interp;
+            std::istringstream in(program);
+
+            Clock::time_point start = Clock::now();
+            if (!interp.parse(in)) {
+                std::cerr << "Error: generated curve failed to parse" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            interp.eval();
+            totalTime += secondsSince(start);
+            nodes = countNodes(interp.tree());
+            bytes = interp.arenaBytes();
+            drawn = interp.getGraphicsVector().size();
+        }
+
+        std::cout << "curve: " << segments << " segments " << names[lazy] << ", " << program.size()
+                  << " bytes of source, " << nodes << " nodes, " << drawn << " graphics\n";
+        std::cout << "  arena          " << bytes / 1024 << " KiB\n";
+        std::cout << "  parse and eval " << std::fixed << std::setprecision(3) << 1e3 * totalTime / reps << " ms\n";
+    }
+}
+
+// user procedure calls per second of a recursive generator, on each
+// backend
+void benchCalls(const std::string& name, const std::string& program, std::size_t calls, int reps) {
+    const Interpreter::EvalMode modes[] = { Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval };
+    const char* names[] = { "tree eval      ", "vm             ", "closure        " };
+    std::cout << "calls: " << name << ", " << program.size() << " bytes of source, " << calls << " calls\n";
+    for (int m = 0; m < 3; ++m) {
+        double evalTime = 0;
+        std::size_t drawn = 0;
+        CallCacheStats cache;
+        for (int r = 0; r < reps; ++r) {
+            Interpreter interp;
+            interp.setEvalMode(modes[m]);
+            std::istringstream in(program);
+            if (!interp.parse(in)) {
+                std::cerr << "Error: generated " << name << " failed to parse" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            Clock::time_point start = Clock::now();
+            interp.eval();
+            evalTime += secondsSince(start);
+            drawn = interp.getGraphicsVector().size();
+            cache = interp.getCallCacheStats();
+        }
+        std::cout << "  " << names[m] << std::fixed << std::setprecision(3) << 1e3 * evalTime / reps << " ms, "
+                  << std::setprecision(2) << calls * reps / evalTime / 1e6 << " Mcalls/s, " << drawn
+                  << " graphics";
+        if (cache.hits + cache.misses > 0) {
+            std::cout << ", " << std::setprecision(1) << 100.0 * cache.hits / (cache.hits + cache.misses)
+                      << "% inline cache hits";
+        }
+        std::cout << "\n";
+    }
+}
+
+// whole-program parse and eval against evalStream on the same scene
+void benchStream(std::size_t wheels, int reps) {
+    std::string program = generateScene(wheels);
+
+    double wholeTime = 0;
+    double streamTime = 0;
+    for (int r = 0; r < reps; ++r) {
+        {
+            Interpreter interp;
+            std::istringstream in(program);
+            Clock::time_point start = Clock::now();
+            interp.parse(in);
+            interp.eval();
+            wholeTime += secondsSince(start);
+        }
+        {
+            Interpreter interp;
+            std::istringstream in(program);
+            Clock::time_point start = Clock::now();
+            interp.evalStream(in, [&interp](const Expression&) { interp.clearGraphics(); });
+            streamTime += secondsSince(start);
+        }
+    }
+
+    std::cout << "stream: " << wheels << " wheels\n";
+    std::cout << "  parse+eval     " << std::fixed << std::setprecision(3)
+              << 1e3 * wholeTime / reps << " ms\n";
+    std::cout << "  evalStream     " << 1e3 * streamTime / reps << " ms\n";
+}
+
+// parse program into interp, which must be fresh if program defines anything
+void parseInto(BenchInterpreter& interp, const std::string& program) {
+    std::istringstream in(program);
+    if (!interp.parse(in)) {
+        std::cerr << "Error: generated program failed to parse" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+// tree-walking eval against compiling to bytecode or closures and running them
+void benchBackends(const std::string& name, const std::string& program, int reps) {
+    double treeTime = 0;
+    double compileTime = 0;
+    double runTime = 0;
+    double closureCompileTime = 0;
+    double closureRunTime = 0;
+    std::size_t nodes = 0;
+    Expression treeResult;
+    Expression vmResult;
+    Expression closureResult;
+    for (int r = 0; r < reps; ++r) {
+        {
+            BenchInterpreter interp;
+            parseInto(interp, program);
+            nodes = countNodes(interp.tree());
+            Clock::time_point start = Clock::now();
+            treeResult = interp.eval(interp.tree());
+            treeTime += secondsSince(start);
+        }
+        {
+            BenchInterpreter interp;
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            Chunk chunk = interp.compileTree();
+            compileTime += secondsSince(start);
+
+            start = Clock::now();
+            vmResult = interp.runChunk(chunk);
+            runTime += secondsSince(start);
+        }
+        {
+            BenchInterpreter interp;
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            Closure closure = interp.compileClosure();
+            closureCompileTime += secondsSince(start);
+
+            start = Clock::now();
+            closureResult = interp.runClosure(closure);
+            closureRunTime += secondsSince(start);
+        }
+    }
+
+    if (!(treeResult == vmResult) || !(treeResult == closureResult)) {
+        std::cerr << "Error: backends disagree on " << name << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "backends: " << name << ", " << nodes << " nodes\n";
+    std::cout << "  tree eval      " << std::fixed << std::setprecision(3)
+              << 1e3 * treeTime / reps << " ms\n";
+    std::cout << "  vm compile     " << 1e3 * compileTime / reps << " ms\n";
+    std::cout << "  vm run         " << 1e3 * runTime / reps << " ms, "
+              << std::setprecision(1) << treeTime / runTime << "x tree eval\n";
+    std::cout << "  closure compile" << std::setprecision(3) << std::setw(8)
+              << 1e3 * closureCompileTime / reps << " ms\n";
+    std::cout << "  closure run    " << 1e3 * closureRunTime / reps << " ms, "
+              << std::setprecision(1) << treeTime / closureRunTime << "x tree eval\n";
+}
+
+// eval() against running the Optimizer and then eval() on the result
+void benchOptimizer(const std::string& name, const std::string& program, int reps) {
+    double plainTime = 0;
+    double optimizeTime = 0;
+    double optimizedTime = 0;
+    OptimizerStats stats;
+    for (int r = 0; r < reps; ++r) {
+        {
+            BenchInterpreter interp;
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            interp.eval();
+            plainTime += secondsSince(start);
+        }
+        {
+            BenchInterpreter interp;
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            stats = interp.optimizeTree();
+            optimizeTime += secondsSince(start);
+
+            start = Clock::now();
+            interp.eval();
+            optimizedTime += secondsSince(start);
+        }
+    }
+
+    std::cout << "optimizer: " << name << ", folded " << stats.folded
+              << ", propagated " << stats.propagated << "\n";
+    std::cout << "  eval           " << std::fixed << std::setprecision(3)
+              << 1e3 * plainTime / reps << " ms\n";
+    std::cout << "  optimize       " << 1e3 * optimizeTime / reps << " ms\n";
+    std::cout << "  optimized eval " << 1e3 * optimizedTime / reps << " ms\n";
+}
+
+// parse and eval() without and with hash-consing, and the memory the
+// parse tree takes either way
+void benchHashCons(const std::string& name, const std::string& program, int reps) {
+    double parseTime[2] = { 0, 0 };
+    double evalTime[2] = { 0, 0 };
+    std::size_t bytes[2] = { 0, 0 };
+    std::size_t arenaBytes[2] = { 0, 0 };
+    HashConsStats stats;
+    for (int r = 0; r < reps; ++r) {
+        for (int shared = 0; shared < 2; ++shared) {
+            BenchInterpreter interp;
+            interp.setHashConsEnabled(shared == 1);
+            Clock::time_point start = Clock::now();
+            parseInto(interp, program);
+            parseTime[shared] += secondsSince(start);
+            bytes[shared] = treeBytes(interp.tree());
+            arenaBytes[shared] = interp.arenaBytes();
+
+            start = Clock::now();
+            interp.eval();
+            evalTime[shared] += secondsSince(start);
+            if (shared == 1) {
+                stats = interp.getHashConsStats();
+            }
+        }
+    }
+
+    std::cout << "hash-consing: " << name << ", " << stats.lists << " lists kept, "
+              << stats.shared << " shared\n";
+    std::cout << "  tree           " << bytes[0] / 1024 << " KB, shared " << bytes[1] / 1024
+              << " KB, " << stats.bytesSaved / 1024 << " KB saved with the lists kept\n";
+    std::cout << "  arena          " << arenaBytes[0] / 1024 << " KB, shared " << arenaBytes[1] / 1024 << " KB\n";
+    std::cout << "  parse          " << std::fixed << std::setprecision(3)
+              << 1e3 * parseTime[0] / reps << " ms, shared " << 1e3 * parseTime[1] / reps << " ms\n";
+    std::cout << "  eval           " << 1e3 * evalTime[0] / reps << " ms, shared "
+              << 1e3 * evalTime[1] / reps << " ms\n";
+}
+
+// a REPL session entering the draw lines of a scene of `wheels` wheels
+// twice, each line parsed and evaluated on its own, as sldraw does,
+// without and with the values of shared lists cached across lines
+void benchResultCache(std::size_t wheels, int reps) {
+    std::vector<std::string> lines;
+    std::istringstream scene(generateScene(wheels));
+    std::string line;
+    while (std::getline(scene, line)) {
+        if (line.compare(0, 8, " (draw (") == 0) {
+            lines.push_back(line);
+        }
+    }
+
+    double parseTime[2] = { 0, 0 };
+    double evalTime[2] = { 0, 0 };
+    ResultCacheStats stats;
+    for (int r = 0; r < reps; ++r) {
+        for (int cached = 0; cached < 2; ++cached) {
+            BenchInterpreter interp;
+            interp.setHashConsEnabled(true);
+            interp.setResultCacheCapacity(cached == 1 ? Interpreter::DEFAULT_RESULT_CACHE : 0);
+            for (int pass = 0; pass < 2; ++pass) {
+                for (const std::string& entry : lines) {
+                    Clock::time_point start = Clock::now();
+                    parseInto(interp, entry);
+                    parseTime[cached] += secondsSince(start);
+                    start = Clock::now();
+                    interp.eval();
+                    evalTime[cached] += secondsSince(start);
+                }
+            }
+            if (cached == 1) {
+                stats = interp.getResultCacheStats();
+            }
+        }
+    }
+
+    std::cout << "result cache: " << 2 * lines.size() << " lines, " << stats.hits << " hits, "
+              << stats.misses << " misses\n";
+    std::cout << "  parse          " << std::fixed << std::setprecision(3)
+              << 1e3 * parseTime[0] / reps << " ms, cached " << 1e3 * parseTime[1] / reps << " ms\n";
+    std::cout << "  eval           " << 1e3 * evalTime[0] / reps << " ms, cached "
+              << 1e3 * evalTime[1] / reps << " ms, " << std::setprecision(1) << evalTime[0] / evalTime[1] << "x\n";
+}
+
+// eval() of a whole program keeping and skipping its unused defines
+void benchDeadCode(const std::string& name, const std::string& program, int reps) {
+    double evalTime[2] = { 0, 0 };
+    DeadCodeStats stats;
+    for (int r = 0; r < reps; ++r) {
+        for (int eliminate = 0; eliminate < 2; ++eliminate) {
+            BenchInterpreter interp;
+            interp.setDeadCodeEnabled(eliminate == 1);
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            interp.eval();
+            evalTime[eliminate] += secondsSince(start);
+            if (eliminate == 1) {
+                stats = interp.getDeadCodeStats();
+            }
+        }
+    }
+
+    std::cout << "dead code: " << name << ", eliminated " << stats.defines << " defines, "
+              << stats.nodes << " nodes\n";
+    std::cout << "  eval           " << std::fixed << std::setprecision(3)
+              << 1e3 * evalTime[0] / reps << " ms, eliminated " << 1e3 * evalTime[1] / reps << " ms\n";
+}
+
+// eval() in each mode without and with the TypeChecker, whose time
+// is included, so arithmetic proven on Numbers is evaluated unboxed
+void benchTypeCheck(const std::string& name, const std::string& program, int reps) {
+    const Interpreter::EvalMode modes[] = { Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval };
+    const char* names[] = { "tree eval      ", "vm             ", "closure        " };
+    TypeCheckStats stats;
+    std::ostringstream lines;
+    for (int m = 0; m < 3; ++m) {
+        double times[2] = { 0, 0 };
+        for (int checked = 0; checked < 2; ++checked) {
+            for (int r = 0; r < reps; ++r) {
+                BenchInterpreter interp;
+                interp.setEvalMode(modes[m]);
+                interp.setTypeCheckEnabled(checked == 1);
+                parseInto(interp, program);
+                Clock::time_point start = Clock::now();
+                interp.eval();
+                times[checked] += secondsSince(start);
+                stats = interp.getTypeCheckStats();
+            }
+        }
+        lines << "  " << names[m] << std::fixed << std::setprecision(3) << 1e3 * times[0] / reps << " ms, checked "
+              << 1e3 * times[1] / reps << " ms, " << std::setprecision(2) << times[0] / times[1] << "x\n";
+    }
+    std::cout << "typecheck: " << name << ", " << stats.numeric << " numeric lists, " << stats.errors
+              << " type errors\n" << lines.str();
+}
+
+// eval() in each mode without and with the SubexpressionEliminator,
+// whose time is included, so repeated pure calls are computed once
+void benchCse(const std::string& name, const std::string& program, int reps) {
+    const Interpreter::EvalMode modes[] = { Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval };
+    const char* names[] = { "tree eval      ", "vm             ", "closure        " };
+    CseStats stats;
+    std::ostringstream lines;
+    for (int m = 0; m < 3; ++m) {
+        double times[2] = { 0, 0 };
+        for (int hoisted = 0; hoisted < 2; ++hoisted) {
+            for (int r = 0; r < reps; ++r) {
+                BenchInterpreter interp;
+                interp.setEvalMode(modes[m]);
+                interp.setCseEnabled(hoisted == 1);
+                parseInto(interp, program);
+                Clock::time_point start = Clock::now();
+                interp.eval();
+                times[hoisted] += secondsSince(start);
+                stats = interp.getCseStats();
+            }
+        }
+        lines << "  " << names[m] << std::fixed << std::setprecision(3) << 1e3 * times[0] / reps << " ms, hoisted "
+              << 1e3 * times[1] / reps << " ms, " << std::setprecision(2) << times[0] / times[1] << "x\n";
+    }
+    std::cout << "cse: " << name << ", " << stats.replaced << " subexpressions into " << stats.temporaries
+              << " temporaries\n" << lines.str();
+}
+
+// eval() in each mode with eager and lazy defines, so the shapes a
+// scene defines and never draws are never computed
+void benchLazyDefine(const std::string& name, const std::string& program, int reps) {
+    const Interpreter::EvalMode modes[] = { Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval };
+    const char* names[] = { "tree eval      ", "vm             ", "closure        " };
+    std::ostringstream lines;
+    for (int m = 0; m < 3; ++m) {
+        double times[2] = { 0, 0 };
+        for (int lazy = 0; lazy < 2; ++lazy) {
+            for (int r = 0; r < reps; ++r) {
+                BenchInterpreter interp;
+                interp.setEvalMode(modes[m]);
+                interp.setDefineMode(lazy == 1 ? Environment::LazyDefine : Environment::EagerDefine);
+                parseInto(interp, program);
+                Clock::time_point start = Clock::now();
+                interp.eval();
+                times[lazy] += secondsSince(start);
+            }
+        }
+        lines << "  " << names[m] << std::fixed << std::setprecision(3) << 1e3 * times[0] / reps << " ms, lazy "
+              << 1e3 * times[1] / reps << " ms, " << std::setprecision(2) << times[0] / times[1] << "x\n";
+    }
+    std::cout << "lazy define: " << name << "\n" << lines.str();
+}
+
+// number of lists, that is calls and special forms, in an expression tree
+std::size_t countLists(const Expression& exp) {
+    std::size_t n = exp.head.type == ListType ? 1 : 0;
+    for (const Expression& sub : exp.tail) {
+        n += countLists(sub);
+    }
+    return n;
+}
+
+// Expression copies made by the tree-walking eval, per call or special form
+void benchCopies(std::size_t wheels) {
+    BenchInterpreter interp;
+    parseInto(interp, generateScene(wheels));
+    std::size_t lists = countLists(interp.tree());
+
+    std::size_t before = Expression::copies;
+    interp.eval();
+    std::size_t copies = Expression::copies - before;
+
+    std::cout << "copies: " << wheels << " wheels, " << lists << " calls\n";
+    std::cout << "  eval copies    " << copies << ", " << std::fixed << std::setprecision(2)
+              << static_cast<double>(copies) / lists << " per call\n";
+}
+
+} // namespace
+
+// a whole run of a scene against redefining the radius of one of its
+// wheels in reactive mode, evaluating again only the forms drawing it
+void benchReactive(std::size_t wheels, int reps) {
+    std::string program = generateRadiusScene(wheels);
+
+    double times[3] = { 0, 0, 0 };
+    std::size_t recomputed = 0;
+    for (int r = 0; r < reps; ++r) {
+        for (int reactive = 0; reactive < 2; ++reactive) {
+            BenchInterpreter interp;
+            interp.setReactiveEnabled(reactive == 1);
+            parseInto(interp, program);
+            Clock::time_point start = Clock::now();
+            interp.eval();
+            times[reactive] += secondsSince(start);
+            if (reactive == 1) {
+                // parsing it releases the scene, which is not timed
+                std::ostringstream redefine;
+                redefine << "(define radius " << 11 + r << ")";
+                parseInto(interp, redefine.str());
+                start = Clock::now();
+                interp.eval();
+                times[2] += secondsSince(start);
+                recomputed = interp.getReactiveStats().recomputed;
+            }
+        }
+    }
+
+    std::cout << "reactive: " << wheels << " wheels, " << 9 * wheels << " graphics\n";
+    std::cout << "  eval           " << std::fixed << std::setprecision(3) << 1e3 * times[0] / reps << " ms\n";
+    std::cout << "  reactive eval  " << 1e3 * times[1] / reps << " ms\n";
+    std::cout << "  redefine       " << 1e3 * times[2] / reps << " ms, " << recomputed << " forms evaluated again\n";
+}
+
+int main(int argc, char** argv) {
+    std::size_t scale = 2000;
+    if (argc > 1) {
+        scale = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    std::cout << "sizeof(Atom)       " << sizeof(Atom) << "\n";
+    std::cout << "sizeof(Expression) " << sizeof(Expression) << "\n";
+
+    benchScene(scale, 5, false);
+    benchScene(scale, 5, true);
+    benchCopies(scale);
+    benchNesting("deep", generateDeep(50 * scale), 50 * scale, 5);
+    benchNesting("wide", generateWide(50 * scale), 1, 5);
+    benchStream(scale, 5);
+    benchLoops(scale, 5);
+    benchLoops(10 * scale, 5);
+    benchCurve(50 * scale, 5);
+    {
+        // about 30 * scale calls each
+        std::size_t depth = 5;
+        while ((std::size_t(1) << depth) < 16 * scale) {
+            ++depth;
+        }
+        benchCalls("tree", generateTree(depth), (std::size_t(3) << depth) - 2, 5);
+        std::size_t kochDepth = depth / 2;
+        std::size_t lines = std::size_t(1) << (2 * kochDepth);
+        benchCalls("koch", generateKoch(kochDepth), 2 * lines - 1, 5);
+    }
+    benchBackends("scene", generateScene(scale), 5);
+    benchBackends("arithmetic", generateArithmetic(10 * scale), 5);
+    benchBackends("globals", generateGlobals(10 * scale), 5);
+    benchOptimizer("scene", generateScene(scale), 5);
+    benchHashCons("scene", generateScene(scale), 5);
+    benchResultCache(scale, 5);
+    benchDeadCode("helpers", generateHelpers(10 * scale), 5);
+    benchTypeCheck("arithmetic", generateArithmetic(10 * scale), 5);
+    benchTypeCheck("loops", generateLoopScene(10 * scale), 5);
+    benchCse("scene", generateScene(scale), 5);
+    benchCse("loops", generateLoopScene(10 * scale), 5);
+    benchLazyDefine("helpers", generateHelpers(10 * scale), 5);
+    benchReactive(3 * scale, 5);
+
+    return EXIT_SUCCESS;
+}
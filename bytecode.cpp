@@ -0,0 +1,802 @@
+#include "bytecode.hpp"
+
+// system includes
+#include <algorithm>
+#include <memory>
+
+// module includes
+#include "interpreter_semantic_error.hpp"
+#include "typecheck.hpp"
+
+namespace {
+
+// builtins with their own instruction, by name
+struct InlineBuiltin {
+    Symbol name;
+    OpCode op;
+};
+
+const InlineBuiltin INLINE_BUILTINS[] = {
+    { "+", AddOp },
+    { "-", SubOp },
+    { "*", MulOp },
+    { "/", DivOp },
+    { "<", LtOp },
+    { ">", GtOp },
+    { "<=", LteqOp },
+    { ">=", GteqOp },
+    { "=", EqOp },
+};
+
+// the instruction calling builtin sym, CallOp if it has none
+OpCode builtinOp(const Symbol& sym) {
+    for (const InlineBuiltin& builtin : INLINE_BUILTINS) {
+        if (sym == builtin.name) {
+            return builtin.op;
+        }
+    }
+    return CallOp;
+}
+
+const char* const INVALID_FORM = "Error: Invalid procedure, expression, number, boolean or special form.";
+
+// Compiles one expression into a chunk, tracking the stack depth
+class Compiler {
+public:
+    Compiler(Chunk& chunk, const Environment& env) : chunk(chunk), env(env), depth(0) {}
+
+    void expression(const Expression& exp);
+    void finish();
+
+private:
+    std::size_t emit(OpCode op, std::uint32_t arg = 0, std::uint32_t count = 0);
+    void push(std::size_t n = 1);
+    void pop(std::size_t n = 1);
+    void constant(const Atom& atom);
+    void fail(const std::string& message);
+    void call(const Expression& exp, const Environment::EnvResult& binding);
+    void apply(const Expression& exp, bool strict);
+    void slot(OpCode op, std::uint32_t index);
+    void body(const Expression& exp, std::size_t first);
+    void logic(const Expression& exp, SpecialFormId form);
+    void let(const Expression& exp);
+    void cond(const Expression& exp);
+    void loop(const Expression& exp, SpecialFormId form, Symbol::Id index);
+    void map(const Expression& exp);
+    void list(const Expression& exp);
+
+    Chunk& chunk;
+    const Environment& env;
+    std::size_t depth;
+};
+
+std::size_t Compiler::emit(OpCode op, std::uint32_t arg, std::uint32_t count) {
+    Instruction ins;
+    ins.op = op;
+    ins.count = count;
+    ins.arg = arg;
+    chunk.code.push_back(ins);
+    return chunk.code.size() - 1;
+}
+
+void Compiler::push(std::size_t n) {
+    depth += n;
+    if (depth > chunk.maxDepth) {
+        chunk.maxDepth = depth;
+    }
+}
+
+void Compiler::pop(std::size_t n) {
+    depth -= n;
+}
+
+void Compiler::constant(const Atom& atom) {
+    if (atom.type == NumberType) {
+        chunk.code[emit(NumberOp)].number = atom.value.num_value;
+        push();
+        return;
+    }
+    emit(ConstOp, static_cast<std::uint32_t>(chunk.constants.size()));
+    chunk.constants.push_back(atom);
+    push();
+}
+
+void Compiler::fail(const std::string& message) {
+    emit(FailOp, static_cast<std::uint32_t>(chunk.messages.size()));
+    chunk.messages.push_back(message);
+    // counts as the value it replaces
+    push();
+}
+
+// Evaluate the arguments in order, then call the builtin
+void Compiler::call(const Expression& exp, const Environment::EnvResult& binding) {
+    std::size_t first = exp.head.type == ListType ? 1 : 0;
+    for (std::size_t i = first; i < exp.tail.size(); ++i) {
+        expression(exp.tail[i]);
+    }
+    std::uint32_t count = static_cast<std::uint32_t>(exp.tail.size() - first);
+    Symbol name = exp.head.type == ListType ? exp.tail[0].head.value.sym_value : exp.head.value.sym_value;
+
+    chunk.code[emit(builtinOp(name), 0, count)].proc = binding.proc;
+    pop(count);
+    push();
+}
+
+// With the head of exp on the stack, call it on the rest of exp if it is
+// a user procedure. Otherwise the head is the value, unless strict.
+void Compiler::apply(const Expression& exp, bool strict) {
+    std::size_t check = emit(CalleeOp, 0, strict ? 1 : 0);
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        expression(exp.tail[i]);
+    }
+    std::uint32_t count = static_cast<std::uint32_t>(exp.tail.size() - 1);
+    emit(ApplyOp, 0, count);
+    pop(count);
+    chunk.code[check].arg = static_cast<std::uint32_t>(chunk.code.size());
+}
+
+// load or store a slot, which the frame must hold
+void Compiler::slot(OpCode op, std::uint32_t index) {
+    emit(op, index);
+    if (op == SlotOp) {
+        push();
+    }
+    else {
+        pop();
+    }
+    if (index + 1 > chunk.frameSize) {
+        chunk.frameSize = index + 1;
+    }
+}
+
+// evaluate exp.tail[first..] in order, leaving the last value
+void Compiler::body(const Expression& exp, std::size_t first) {
+    for (std::size_t i = first; i < exp.tail.size(); ++i) {
+        if (i > first) {
+            emit(PopOp);
+            pop();
+        }
+        if (i + 1 == exp.tail.size() || !is_valid_define(exp.tail[i])) {
+            expression(exp.tail[i]);
+            continue;
+        }
+        // a define whose value is unused may be lazy
+        std::size_t deferred = emit(DeferOp, 0, static_cast<std::uint32_t>(chunk.forms.size()));
+        chunk.forms.push_back(&exp.tail[i]);
+        expression(exp.tail[i]);
+        chunk.code[deferred].arg = static_cast<std::uint32_t>(chunk.code.size());
+    }
+}
+
+// and or or, stopping at the first argument that decides the value
+void Compiler::logic(const Expression& exp, SpecialFormId form) {
+    if (exp.tail.size() < 2) {
+        fail(form == AndId ? "Error: Invalid 'and' syntax." : "Error: Invalid 'or' syntax.");
+        return;
+    }
+    std::vector<std::size_t> exits;
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        expression(exp.tail[i]);
+        exits.push_back(emit(form == AndId ? AndOp : OrOp));
+        pop();
+    }
+    // every argument was the other Boolean
+    constant(boolean_atom(form == AndId));
+    for (std::size_t exit : exits) {
+        chunk.code[exit].arg = static_cast<std::uint32_t>(chunk.code.size());
+    }
+}
+
+// evaluate the values of a let, then set its locals and run the body
+void Compiler::let(const Expression& exp) {
+    if (!is_valid_let(exp)) {
+        fail("Error: Invalid 'let' syntax.");
+        return;
+    }
+    if (!is_resolved_let(exp)) {
+        fail("Error: Invalid 'let' Symbol.");
+        return;
+    }
+    const Expression& bindings = exp.tail[1];
+    for (const Expression& binding : bindings.tail) {
+        expression(binding.tail[1]);
+    }
+    for (std::size_t i = bindings.tail.size(); i > 0; --i) {
+        slot(StoreOp, bindings.tail[i - 1].tail[0].head.value.slot_value);
+    }
+    body(exp, 2);
+}
+
+// test each clause in turn, running the body of the first that holds
+void Compiler::cond(const Expression& exp) {
+    if (!is_valid_cond(exp)) {
+        fail("Error: Invalid 'cond' syntax.");
+        return;
+    }
+    std::vector<std::size_t> exits;
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        const Expression& clause = exp.tail[i];
+        if (is_else_clause(clause)) {
+            body(clause, 1);
+            pop();
+            exits.push_back(emit(JumpOp));
+            break;
+        }
+        expression(clause.tail[0]);
+        std::size_t next = emit(JumpIfFalseOp, 0, CondId);
+        pop();
+        body(clause, 1);
+        // only one clause leaves a value
+        pop();
+        exits.push_back(emit(JumpOp));
+        chunk.code[next].arg = static_cast<std::uint32_t>(chunk.code.size());
+    }
+    if (!is_else_clause(exp.tail.back())) {
+        // no clause was taken
+        emit(NoneOp);
+    }
+    push();
+    for (std::size_t exit : exits) {
+        chunk.code[exit].arg = static_cast<std::uint32_t>(chunk.code.size());
+    }
+}
+
+// With the range on the stack, run the body exp.tail[2..] once per
+// index, binding index if it is not NoSymbolId. The body of a map
+// draws its value.
+void Compiler::loop(const Expression& exp, SpecialFormId form, Symbol::Id index) {
+    emit(LoopOp, form, index);
+    pop(form == MapId ? 1 : 3);
+    // start, end, step, iteration and the value of the last body
+    push(5);
+    std::size_t top = emit(NextOp, 0, index);
+    pop();
+    for (std::size_t i = 2; i < exp.tail.size(); ++i) {
+        if (i > 2) {
+            emit(PopOp);
+            pop();
+        }
+        expression(exp.tail[i]);
+    }
+    if (form == MapId) {
+        emit(DrawOp);
+        emit(NoneOp);
+    }
+    emit(JumpOp, static_cast<std::uint32_t>(top));
+    chunk.code[top].arg = static_cast<std::uint32_t>(chunk.code.size());
+    pop(4);
+}
+
+// a map that is an argument of draw, leaving nothing on the stack
+void Compiler::map(const Expression& exp) {
+    if (!is_valid_map(exp)) {
+        fail("Error: Invalid 'map' syntax.");
+        emit(PopOp);
+        pop();
+        return;
+    }
+    expression(exp.tail[1].tail[1]);
+    loop(exp, MapId, exp.tail[1].tail[0].head.value.sym_value.id());
+    emit(PopOp);
+    pop();
+}
+
+void Compiler::list(const Expression& exp) {
+    if (exp.tail.empty()) {
+        constant(exp.head);
+        return;
+    }
+    if (exp.head.value.list_info.numeric_op != NotNumeric) {
+        // proven to be a Number by the TypeChecker
+        emit(UnboxedOp, static_cast<std::uint32_t>(chunk.forms.size()));
+        chunk.forms.push_back(&exp);
+        push();
+        return;
+    }
+
+    const Expression& first = exp.tail[0];
+
+    if (first.head.type == BooleanType || first.head.type == NumberType) {
+        // the rest of the list is never evaluated
+        constant(first.head);
+        return;
+    }
+    if (first.head.type == SlotType || first.head.type == LambdaType || first.head.type == ListType) {
+        // only a list at the head must be a user procedure
+        expression(first);
+        apply(exp, first.head.type == ListType);
+        return;
+    }
+    if (first.head.type != SymbolType) {
+        fail(INVALID_FORM);
+        return;
+    }
+
+    const Symbol& name = first.head.value.sym_value;
+    switch (name.id()) {
+    case DefineId:
+        if (exp.tail.size() != 3 || exp.tail[1].head.type != SymbolType) {
+            fail("Error: Invalid 'define' syntax.");
+            return;
+        }
+        expression(exp.tail[2]);
+        emit(DefineOp, exp.tail[1].head.value.sym_value.id());
+        return;
+    case BeginId:
+        if (exp.tail.size() == 1) {
+            emit(NoneOp);
+            push();
+            return;
+        }
+        body(exp, 1);
+        return;
+    case IfId: {
+        if (exp.tail.size() != 4) {
+            fail("Error: Invalid 'if' syntax.");
+            return;
+        }
+        expression(exp.tail[1]);
+        std::size_t toElse = emit(JumpIfFalseOp);
+        pop();
+        expression(exp.tail[2]);
+        std::size_t toEnd = emit(JumpOp);
+        // only one branch leaves a value
+        pop();
+        chunk.code[toElse].arg = static_cast<std::uint32_t>(chunk.code.size());
+        expression(exp.tail[3]);
+        chunk.code[toEnd].arg = static_cast<std::uint32_t>(chunk.code.size());
+        return;
+    }
+    case DrawId:
+        if (exp.tail.size() < 2) {
+            fail("Error: Invalid 'draw' syntax.");
+            return;
+        }
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            const Expression& arg = exp.tail[i];
+            if (is_map(arg)) {
+                map(arg);
+                continue;
+            }
+            expression(arg);
+            emit(DrawOp);
+            pop();
+        }
+        emit(NoneOp);
+        push();
+        return;
+    case ForId: {
+        if (!is_valid_for(exp)) {
+            fail("Error: Invalid 'for' syntax.");
+            return;
+        }
+        const Expression& range = exp.tail[1];
+        for (std::size_t i = 1; i < range.tail.size(); ++i) {
+            expression(range.tail[i]);
+        }
+        if (range.tail.size() == 3) {
+            constant(number_atom(1));
+        }
+        loop(exp, ForId, range.tail[0].head.value.sym_value.id());
+        return;
+    }
+    case RepeatId:
+        if (exp.tail.size() < 3) {
+            fail("Error: Invalid 'repeat' syntax.");
+            return;
+        }
+        // the same as a for from 0 to count
+        constant(number_atom(0));
+        expression(exp.tail[1]);
+        constant(number_atom(1));
+        loop(exp, RepeatId, NoSymbolId);
+        return;
+    case MapId:
+        // draw compiles the maps that are its arguments
+        fail("Error: 'map' is only valid as an argument of 'draw'.");
+        return;
+    case LambdaId:
+        emit(LambdaOp, static_cast<std::uint32_t>(chunk.forms.size()));
+        chunk.forms.push_back(&exp);
+        push();
+        return;
+    case AndId:
+    case OrId:
+        logic(exp, static_cast<SpecialFormId>(name.id()));
+        return;
+    case LetId:
+        let(exp);
+        return;
+    case CondId:
+        cond(exp);
+        return;
+    default: {
+        // builtins cannot be redefined, so a procedure now is one forever
+        const Environment::EnvResult* binding = env.lookup(name);
+        if (binding != nullptr && binding->type == Environment::ProcedureType) {
+            call(exp, *binding);
+            return;
+        }
+        // a defined symbol at the head ignores the rest of the list,
+        // unless it is a user procedure
+        emit(HeadOp, name.id());
+        push();
+        apply(exp, false);
+        return;
+    }
+    }
+}
+
+void Compiler::expression(const Expression& exp) {
+    switch (exp.head.type) {
+    case ListType:
+        list(exp);
+        return;
+    case SymbolType: {
+        const Environment::EnvResult* binding = env.lookup(exp.head.value.sym_value);
+        if (binding != nullptr && binding->type == Environment::ProcedureType) {
+            call(exp, *binding);
+            return;
+        }
+        emit(GlobalOp, exp.head.value.sym_value.id());
+        push();
+        return;
+    }
+    case BooleanType:
+    case NumberType:
+    case PointType:
+    case LineType:
+    case ArcType:
+    case RangeType:
+    case LambdaType:
+        constant(exp.head);
+        return;
+    case SlotType:
+        slot(SlotOp, exp.head.value.slot_value);
+        return;
+    case SharedType:
+        expression(*exp.head.value.shared_value);
+        return;
+    default:
+        fail(INVALID_FORM);
+        return;
+    }
+}
+
+void Compiler::finish() {
+    emit(ReturnOp);
+}
+
+// true if the top count values are all numbers
+bool allNumbers(const Atom* args, std::uint32_t count) {
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (args[i].type != NumberType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setNumber(Atom& atom, Number num) {
+    atom.type = NumberType;
+    atom.value.num_value = num;
+}
+
+void setBoolean(Atom& atom, Boolean b) {
+    atom.type = BooleanType;
+    atom.value.bool_value = b;
+}
+
+} // namespace
+
+Chunk VM::compile(const Expression& exp, const Environment& env) {
+    Chunk chunk;
+    Compiler compiler(chunk, env);
+    compiler.expression(exp);
+    compiler.finish();
+    return chunk;
+}
+
+Expression VM::run(const Chunk& chunk, Environment& env, std::vector<Atom>& graphics) {
+    try {
+        return execute(chunk, env, graphics);
+    }
+    catch (...) {
+        // release the index symbols of the loops that were running
+        for (Symbol::Id index : loops) {
+            env.removeExp(Symbol::fromId(index));
+        }
+        loops.clear();
+        calls.clear();
+        throw;
+    }
+}
+
+Expression VM::execute(const Chunk& chunk, Environment& env, std::vector<Atom>& graphics) {
+    if (stack.size() < chunk.frameSize + chunk.maxDepth + 1) {
+        stack.resize(chunk.frameSize + chunk.maxDepth + 1);
+    }
+
+    Atom* base = stack.data();
+    // the slots of the frame running, those of chunk at the bottom
+    Atom* fp = base;
+    Atom* sp = std::fill_n(base, chunk.frameSize, Atom());
+    const Chunk* current = &chunk;
+    const Instruction* code = chunk.code.data();
+    const Instruction* ip = code;
+
+    while (true) {
+        const Instruction& ins = *ip++;
+        switch (ins.op) {
+        case NumberOp:
+            setNumber(*sp++, ins.number);
+            break;
+        case ConstOp:
+            *sp++ = current->constants[ins.arg];
+            break;
+        case NoneOp:
+            *sp++ = Atom();
+            break;
+        case PopOp:
+            --sp;
+            break;
+        case GlobalOp:
+        case HeadOp: {
+            Symbol sym = Symbol::fromId(ins.arg);
+            const Atom* value = env.value(sym);
+            if (value == nullptr) {
+                throw InterpreterSemanticError((ins.op == HeadOp ? "Error: Unknown symbol: " : "Error: Unknown type: ") + sym.name());
+            }
+            *sp++ = *value;
+            break;
+        }
+        case SlotOp:
+            *sp++ = fp[ins.arg];
+            break;
+        case StoreOp:
+            fp[ins.arg] = *--sp;
+            break;
+        case LambdaOp: {
+            Atom lambda = env.addLambda(*current->forms[ins.arg], fp);
+            *sp++ = lambda;
+            break;
+        }
+        case UnboxedOp:
+            *sp = number_atom(eval_numeric(*current->forms[ins.arg], env, fp));
+            ++sp;
+            break;
+        case CalleeOp:
+            if (sp[-1].type != LambdaType) {
+                if (ins.count != 0) {
+                    throw InterpreterSemanticError(INVALID_FORM);
+                }
+                ip = code + ins.arg;
+            }
+            break;
+        case ApplyOp: {
+            Atom* args = sp - ins.count;
+            const Lambda& lambda = env.getLambda(args[-1].value.lambda_value);
+            if (ins.count != lambda.arity) {
+                throw InterpreterSemanticError("Error: Wrong number of arguments for lambda.");
+            }
+            if (!lambda.chunk) {
+                lambda.chunk = std::make_shared<const Chunk>(compile(lambda.body, env));
+            }
+            const Chunk* body = lambda.chunk.get();
+            CallFrame caller = { current, ip, static_cast<std::size_t>(fp - base) };
+            calls.push_back(caller);
+            // the body runs above its arguments and locals
+            const std::size_t locals = lambda.frameSize - lambda.arity;
+            std::size_t needed = static_cast<std::size_t>(sp - base) + locals + body->maxDepth + 1;
+            if (stack.size() < needed) {
+                std::size_t top = static_cast<std::size_t>(sp - base);
+                std::size_t frame = static_cast<std::size_t>(args - base);
+                stack.resize(std::max(needed, 2 * stack.size()));
+                base = stack.data();
+                sp = base + top;
+                args = base + frame;
+            }
+            fp = args;
+            sp = std::fill_n(sp, locals, Atom());
+            current = body;
+            code = body->code.data();
+            ip = code;
+            break;
+        }
+        case AddOp:
+            if (ins.count > 0 && allNumbers(sp - ins.count, ins.count)) {
+                Number sum = 0.0;
+                for (Atom* arg = sp - ins.count; arg != sp; ++arg) {
+                    sum += arg->value.num_value;
+                }
+                sp -= ins.count;
+                setNumber(*sp++, sum);
+                break;
+            }
+            goto call;
+        case MulOp:
+            if (ins.count > 0 && allNumbers(sp - ins.count, ins.count)) {
+                Number product = 1.0;
+                for (Atom* arg = sp - ins.count; arg != sp; ++arg) {
+                    product *= arg->value.num_value;
+                }
+                sp -= ins.count;
+                setNumber(*sp++, product);
+                break;
+            }
+            goto call;
+        case SubOp:
+            if (ins.count == 1 && sp[-1].type == NumberType) {
+                sp[-1].value.num_value = -sp[-1].value.num_value;
+                break;
+            }
+            if (ins.count == 2 && allNumbers(sp - 2, 2)) {
+                --sp;
+                sp[-1].value.num_value = sp[-1].value.num_value - sp[0].value.num_value;
+                break;
+            }
+            goto call;
+        case DivOp:
+            if (ins.count == 2 && allNumbers(sp - 2, 2) && sp[-1].value.num_value != 0) {
+                --sp;
+                sp[-1].value.num_value = sp[-1].value.num_value / sp[0].value.num_value;
+                break;
+            }
+            goto call;
+        case LtOp:
+        case GtOp:
+        case LteqOp:
+        case GteqOp:
+        case EqOp:
+            if (ins.count == 2 && allNumbers(sp - 2, 2)) {
+                Number a = sp[-2].value.num_value;
+                Number b = sp[-1].value.num_value;
+                Boolean result = ins.op == LtOp ? a < b :
+                    ins.op == GtOp ? a > b :
+                    ins.op == LteqOp ? a <= b :
+                    ins.op == GteqOp ? a >= b : a == b;
+                --sp;
+                setBoolean(sp[-1], result);
+                break;
+            }
+            goto call;
+        case CallOp:
+        call: {
+            // the arguments never outlive the call
+            ArenaRegion region;
+            ArgList args(sp - ins.count, sp);
+            Atom result = ins.proc(args);
+            sp -= ins.count;
+            *sp++ = result;
+            break;
+        }
+        case JumpOp:
+            ip = code + ins.arg;
+            break;
+        case JumpIfFalseOp:
+            --sp;
+            if (sp->type != BooleanType) {
+                throw InterpreterSemanticError(ins.count == CondId ? "Error: 'cond' test must evaluate to a Boolean." :
+                    "Error: 'if' condition must evaluate to a Boolean.");
+            }
+            if (!sp->value.bool_value) {
+                ip = code + ins.arg;
+            }
+            break;
+        case AndOp:
+        case OrOp:
+            if (sp[-1].type != BooleanType) {
+                throw InterpreterSemanticError(ins.op == AndOp ? "Error: 'and' arguments must evaluate to Booleans." :
+                    "Error: 'or' arguments must evaluate to Booleans.");
+            }
+            if (sp[-1].value.bool_value == (ins.op == OrOp)) {
+                ip = code + ins.arg;
+            }
+            else {
+                --sp;
+            }
+            break;
+        case DefineOp: {
+            Symbol sym = Symbol::fromId(ins.arg);
+            if (env.isKnown(sym) || is_special_form(sym)) {
+                throw InterpreterSemanticError("Error: Invalid define Symbol.");
+            }
+            env.addExp(sym, Expression(sp[-1]));
+            break;
+        }
+        case DeferOp: {
+            const Expression& form = *current->forms[ins.count];
+            if (env.defineMode() != Environment::EagerDefine && env.defer(form.tail[1].head.value.sym_value, form.tail[2])) {
+                *sp++ = Atom();
+                ip = code + ins.arg;
+            }
+            break;
+        }
+        case DrawOp:
+            --sp;
+            if (!is_graphic(*sp)) {
+                throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
+            }
+            graphics.push_back(*sp);
+            break;
+        case LoopOp: {
+            if (ins.arg == RepeatId) {
+                if (sp[-2].type != NumberType) {
+                    throw InterpreterSemanticError("Error: 'repeat' count must evaluate to a Number.");
+                }
+            }
+            else if (ins.arg == MapId) {
+                if (sp[-1].type != RangeType) {
+                    throw InterpreterSemanticError("Error: 'map' sequence must evaluate to a Range.");
+                }
+                Symbol index = Symbol::fromId(ins.count);
+                if (env.isKnown(index) || is_special_form(index)) {
+                    throw InterpreterSemanticError("Error: Invalid 'map' Symbol.");
+                }
+                Range sequence = sp[-1].value.range_value;
+                setNumber(sp[-1], sequence.start);
+                setNumber(*sp++, sequence.end);
+                setNumber(*sp++, sequence.step);
+                env.addExp(index, Expression(sequence.start));
+                loops.push_back(ins.count);
+            }
+            else {
+                if (!allNumbers(sp - 3, 3)) {
+                    throw InterpreterSemanticError("Error: 'for' range must evaluate to Numbers.");
+                }
+                if (sp[-1].value.num_value == 0) {
+                    throw InterpreterSemanticError("Error: 'for' step must not be zero.");
+                }
+                Symbol index = Symbol::fromId(ins.count);
+                if (env.isKnown(index) || is_special_form(index)) {
+                    throw InterpreterSemanticError("Error: Invalid 'for' Symbol.");
+                }
+                env.addExp(index, Expression(sp[-3]));
+                loops.push_back(ins.count);
+            }
+            setNumber(*sp++, 0);
+            // a loop that never runs its body has no value
+            *sp++ = Atom();
+            break;
+        }
+        case NextOp: {
+            // the index is start + iteration * step
+            Number step = sp[-3].value.num_value;
+            Number index = sp[-5].value.num_value + sp[-2].value.num_value * step;
+            if (step > 0 ? index < sp[-4].value.num_value : index > sp[-4].value.num_value) {
+                if (ins.count != NoSymbolId) {
+                    env.setExp(Symbol::fromId(ins.count), Expression(index));
+                }
+                sp[-2].value.num_value += 1;
+                --sp;
+                break;
+            }
+            if (ins.count != NoSymbolId) {
+                env.removeExp(Symbol::fromId(ins.count));
+                loops.pop_back();
+            }
+            sp[-5] = sp[-1];
+            sp -= 4;
+            ip = code + ins.arg;
+            break;
+        }
+        case FailOp:
+            throw InterpreterSemanticError(current->messages[ins.arg]);
+        case ReturnOp: {
+            if (calls.empty()) {
+                return Expression(sp[-1]);
+            }
+            // the result replaces the procedure and its arguments
+            fp[-1] = sp[-1];
+            sp = fp;
+            const CallFrame& caller = calls.back();
+            current = caller.chunk;
+            code = current->code.data();
+            ip = caller.ip;
+            fp = base + caller.frame;
+            calls.pop_back();
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+// system includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// The instructions of the slisp virtual machine. Every instruction
+// leaves the stack one deeper or shallower than it found it, except
+// the jumps and Fail.
+enum OpCode : std::uint8_t {
+    NumberOp,      // push number
+    ConstOp,       // push constants[arg]
+    NoneOp,        // push the empty value
+    PopOp,         // drop the top of the stack
+    GlobalOp,      // push the value bound to symbol arg
+    HeadOp,        // as GlobalOp, for a symbol at the head of a list
+    SlotOp,        // push slot arg of the frame running
+    StoreOp,       // pop into slot arg of the frame running
+    LambdaOp,      // push a user procedure made from the form forms[arg]
+    UnboxedOp,     // push the value of forms[arg], proven a Number, from
+                   // eval_numeric
+    CalleeOp,      // leave a user procedure on top to be applied, else
+                   // continue at arg, or fail if count is not 0
+    ApplyOp,       // run the user procedure below the top count values
+                   // on them, leaving its result in place of all of them
+    CallOp,        // call proc with the top count values
+    AddOp,         // inline builtins, falling back to proc
+    SubOp,         // with the top count values when an argument is
+    MulOp,         // not a number or the arity is wrong, so errors
+    DivOp,         // are reported by the builtin itself
+    LtOp,
+    GtOp,
+    LteqOp,
+    GteqOp,
+    EqOp,
+    JumpOp,        // continue at arg
+    JumpIfFalseOp, // pop a Boolean, continue at arg if it is False,
+                   // count is the form testing it, if or cond
+    AndOp,         // continue at arg leaving a False on top, else pop it
+    OrOp,          // continue at arg leaving a True on top, else pop it
+    DefineOp,      // bind symbol arg to the top value, leaving it
+    DeferOp,       // bind the symbol of the define forms[count], whose
+                   // value is unused, to a thunk of its value and push
+                   // the empty value, continuing at arg, unless the
+                   // value must be evaluated
+    DrawOp,        // pop a graphic onto the graphics list
+    LoopOp,        // check the start, end and step on top, or the Range
+                   // for a map, of the loop form arg and bind symbol
+                   // count, if any, to start, then push the iteration
+                   // and the empty value
+    NextOp,        // bind the next index of the loop below the top value
+                   // and pop it, or end the loop leaving the top value
+                   // and continue at arg
+    FailOp,        // throw messages[arg]
+    ReturnOp       // return the top value to the caller, or stop with
+                   // it as the result
+};
+
+struct Instruction {
+    OpCode op;
+    std::uint32_t count;
+    union {
+        std::uint32_t arg;
+        Number number;
+        Procedure proc;
+    };
+};
+
+// A Chunk is one compiled top-level expression
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<Atom> constants;
+    std::vector<std::string> messages;
+    // the lambda forms and the lists evaluated by eval_numeric, which
+    // live as long as the expression compiled
+    std::vector<const Expression*> forms;
+    // the deepest the value stack gets
+    std::size_t maxDepth;
+    // the slots of the frame at the bottom of the stack
+    std::size_t frameSize;
+
+    Chunk() : maxDepth(0), frameSize(0) {}
+};
+
+// VM compiles an expression to bytecode and runs it on a value stack.
+// It gives the same results, side effects and errors as
+// Interpreter::eval: syntax errors are compiled to Fail instructions
+// so that they are raised at the point the tree walker would reach them.
+class VM {
+public:
+    // Builtins are resolved against env, which must be the environment
+    // the chunk is run in. Other symbols are looked up when run.
+    static Chunk compile(const Expression& exp, const Environment& env);
+
+    Expression run(const Chunk& chunk, Environment& env, std::vector<Atom>& graphics);
+
+private:
+    Expression execute(const Chunk& chunk, Environment& env, std::vector<Atom>& graphics);
+
+    std::vector<Atom> stack;
+    // the index symbols of the loops running
+    std::vector<Symbol::Id> loops;
+
+    // where to return to from a user procedure
+    struct CallFrame {
+        const Chunk* chunk;
+        const Instruction* ip;
+        // where the caller's frame starts on the stack
+        std::size_t frame;
+    };
+    std::vector<CallFrame> calls;
+};
+
+#endif
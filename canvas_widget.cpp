@@ -17,6 +17,12 @@ void CanvasWidget::addGraphic(QGraphicsItem * item){
     scene->addItem(item);
 }
 
+void CanvasWidget::removeGraphic(QGraphicsItem * item){
+    // Remove the given graphics item from the scene and delete it
+    scene->removeItem(item);
+    delete item;
+}
+
 void CanvasWidget::clear() {
     // Remove all graphics items from the scene
     scene->clear();
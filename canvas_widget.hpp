@@ -20,6 +20,7 @@ public:
 public slots:
 
   void addGraphic(QGraphicsItem * item);
+  void removeGraphic(QGraphicsItem * item);
   void clear();
 
 private:
@@ -0,0 +1,754 @@
+#include "closure.hpp"
+
+// system includes
+#include <memory>
+
+// module includes
+#include "interpreter_semantic_error.hpp"
+#include "typecheck.hpp"
+
+namespace {
+
+const char* const INVALID_FORM = "Error: Invalid procedure, expression, number, boolean or special form.";
+
+// call the node's builtin on arguments that have already been evaluated
+Atom callWith(const ClosureNode& node, const Atom* args, std::size_t count) {
+    ArenaRegion region;
+    ArgList list(args, args + count);
+    return node.proc(list);
+}
+
+Atom numberFn(const ClosureNode& node, ClosureContext&) {
+    return number_atom(node.number);
+}
+
+Atom booleanFn(const ClosureNode& node, ClosureContext&) {
+    return boolean_atom(node.boolean);
+}
+
+Atom constantFn(const ClosureNode& node, ClosureContext& context) {
+    return context.constants[node.constant];
+}
+
+Atom noneFn(const ClosureNode&, ClosureContext&) {
+    return Atom();
+}
+
+Atom failFn(const ClosureNode& node, ClosureContext&) {
+    throw InterpreterSemanticError(node.message);
+}
+
+// a symbol that is not a builtin, bound by define when run
+Atom globalFn(const ClosureNode& node, ClosureContext& context) {
+    const Atom* value = context.env.value(Symbol::fromId(node.sym));
+    if (value == nullptr) {
+        throw InterpreterSemanticError("Error: Unknown type: " + Symbol::fromId(node.sym).name());
+    }
+    return *value;
+}
+
+// a parameter of the user procedure running
+Atom slotFn(const ClosureNode& node, ClosureContext& context) {
+    return context.frame[node.slot];
+}
+
+// a list proven to be a Number by the TypeChecker
+Atom unboxedFn(const ClosureNode& node, ClosureContext& context) {
+    return number_atom(eval_numeric(*node.form, context.env, context.frame));
+}
+
+Atom lambdaFn(const ClosureNode& node, ClosureContext& context) {
+    return context.env.addLambda(*node.form, context.frame);
+}
+
+// run the user procedure callee on the values of children[first..]
+Atom applyLambda(const Atom& callee, const ClosureNode& node, std::size_t first, ClosureContext& context) {
+    // the arguments are the frame of the body, which never outlives the call
+    ArenaRegion region;
+    ArgList args;
+    args.reserve(node.children.size() - first);
+    for (std::size_t i = first; i < node.children.size(); ++i) {
+        args.push_back(node.children[i](context));
+    }
+    const Lambda& lambda = context.env.getLambda(callee.value.lambda_value);
+    if (args.size() != lambda.arity) {
+        throw InterpreterSemanticError("Error: Wrong number of arguments for lambda.");
+    }
+    // with room for its locals
+    args.resize(lambda.frameSize);
+    if (!lambda.closure) {
+        ArenaScope heap(nullptr);
+        lambda.closure = std::make_shared<const Closure>(Closure::compile(lambda.body, context.env));
+    }
+    return lambda.closure->call(context.env, context.graphics, args.data());
+}
+
+// as globalFn, for a symbol at the head of a list, which is applied to
+// the children if it is a user procedure
+Atom headFn(const ClosureNode& node, ClosureContext& context) {
+    const Atom* value = context.env.value(Symbol::fromId(node.sym));
+    if (value == nullptr) {
+        throw InterpreterSemanticError("Error: Unknown symbol: " + Symbol::fromId(node.sym).name());
+    }
+    if (value->type == LambdaType) {
+        return applyLambda(*value, node, 0, context);
+    }
+    return *value;
+}
+
+// a list headed by children[0], applied to the other children if it is
+// a user procedure, which it must be if boolean is set
+Atom calleeFn(const ClosureNode& node, ClosureContext& context) {
+    Atom head = node.children[0](context);
+    if (head.type == LambdaType) {
+        return applyLambda(head, node, 1, context);
+    }
+    if (node.boolean) {
+        throw InterpreterSemanticError(INVALID_FORM);
+    }
+    return head;
+}
+
+Atom callFn(const ClosureNode& node, ClosureContext& context) {
+    // the arguments never outlive the call
+    ArenaRegion region;
+    ArgList args;
+    args.reserve(node.children.size());
+    for (const ClosureNode& child : node.children) {
+        args.push_back(child(context));
+    }
+    return node.proc(args);
+}
+
+Atom negateFn(const ClosureNode& node, ClosureContext& context) {
+    Atom arg = node.children[0](context);
+    if (arg.type == NumberType) {
+        return number_atom(-arg.value.num_value);
+    }
+    return callWith(node, &arg, 1);
+}
+
+// The binary builtins, computed as the builtin itself would when
+// both arguments are numbers and valid
+struct Add {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return number_atom(0.0 + a + b); }
+};
+
+struct Sub {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return number_atom(a - b); }
+};
+
+struct Mul {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return number_atom(1.0 * a * b); }
+};
+
+struct Div {
+    static bool valid(Number, Number b) { return b != 0; }
+    static Atom apply(Number a, Number b) { return number_atom(a / b); }
+};
+
+struct Lt {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return boolean_atom(a < b); }
+};
+
+struct Gt {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return boolean_atom(a > b); }
+};
+
+struct Lteq {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return boolean_atom(a <= b); }
+};
+
+struct Gteq {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return boolean_atom(a >= b); }
+};
+
+struct Eq {
+    static bool valid(Number, Number) { return true; }
+    static Atom apply(Number a, Number b) { return boolean_atom(a == b); }
+};
+
+// anything else goes to the builtin, which reports the error
+template <typename Op>
+Atom binaryFn(const ClosureNode& node, ClosureContext& context) {
+    Atom args[2] = { node.children[0](context), node.children[1](context) };
+    if (args[0].type == NumberType && args[1].type == NumberType &&
+        Op::valid(args[0].value.num_value, args[1].value.num_value)) {
+        return Op::apply(args[0].value.num_value, args[1].value.num_value);
+    }
+    return callWith(node, args, 2);
+}
+
+// builtins with their own node for two arguments, by name
+struct BinaryBuiltin {
+    Symbol name;
+    ClosureFn fn;
+};
+
+const BinaryBuiltin BINARY_BUILTINS[] = {
+    { "+", binaryFn<Add> },
+    { "-", binaryFn<Sub> },
+    { "*", binaryFn<Mul> },
+    { "/", binaryFn<Div> },
+    { "<", binaryFn<Lt> },
+    { ">", binaryFn<Gt> },
+    { "<=", binaryFn<Lteq> },
+    { ">=", binaryFn<Gteq> },
+    { "=", binaryFn<Eq> },
+};
+
+Atom defineFn(const ClosureNode& node, ClosureContext& context) {
+    Atom value = node.children[0](context);
+    Symbol sym = Symbol::fromId(node.sym);
+    if (context.env.isKnown(sym) || is_special_form(sym)) {
+        throw InterpreterSemanticError("Error: Invalid define Symbol.");
+    }
+    context.env.addExp(sym, Expression(value));
+    return value;
+}
+
+// the define form, whose value is unused, bound to a thunk unless the
+// value must be evaluated by children[0]
+Atom deferFn(const ClosureNode& node, ClosureContext& context) {
+    if (context.env.defineMode() != Environment::EagerDefine &&
+        context.env.defer(node.form->tail[1].head.value.sym_value, node.form->tail[2])) {
+        return Atom();
+    }
+    return node.children[0](context);
+}
+
+Atom beginFn(const ClosureNode& node, ClosureContext& context) {
+    std::size_t last = node.children.size() - 1;
+    for (std::size_t i = 0; i < last; ++i) {
+        node.children[i](context);
+    }
+    return node.children[last](context);
+}
+
+// and when boolean is false, or when it is true, stopping at the first
+// child that evaluates to boolean
+Atom logicFn(const ClosureNode& node, ClosureContext& context) {
+    for (const ClosureNode& child : node.children) {
+        Atom arg = child(context);
+        if (arg.type != BooleanType) {
+            throw InterpreterSemanticError(node.boolean ? "Error: 'or' arguments must evaluate to Booleans." :
+                "Error: 'and' arguments must evaluate to Booleans.");
+        }
+        if (arg.value.bool_value == node.boolean) {
+            return arg;
+        }
+    }
+    return boolean_atom(!node.boolean);
+}
+
+// the children are the test and the body of each clause in turn
+Atom condFn(const ClosureNode& node, ClosureContext& context) {
+    for (std::size_t i = 0; i < node.children.size(); i += 2) {
+        Atom test = node.children[i](context);
+        if (test.type != BooleanType) {
+            throw InterpreterSemanticError("Error: 'cond' test must evaluate to a Boolean.");
+        }
+        if (test.value.bool_value) {
+            return node.children[i + 1](context);
+        }
+    }
+    // no clause was taken
+    return Atom();
+}
+
+// the children are the values of the locals of the let form, then the body
+Atom letFn(const ClosureNode& node, ClosureContext& context) {
+    const Expression& bindings = node.form->tail[1];
+    const std::size_t count = bindings.tail.size();
+    {
+        // a value may use the slots of the locals before they are set
+        ArenaRegion region;
+        ArgList values;
+        values.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            values.push_back(node.children[i](context));
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            context.frame[bindings.tail[i].tail[0].head.value.slot_value] = values[i];
+        }
+    }
+    return node.children[count](context);
+}
+
+Atom ifFn(const ClosureNode& node, ClosureContext& context) {
+    Atom condition = node.children[0](context);
+    if (condition.type != BooleanType) {
+        throw InterpreterSemanticError("Error: 'if' condition must evaluate to a Boolean.");
+    }
+    const ClosureNode& branch = node.children[condition.value.bool_value ? 1 : 2];
+    return branch(context);
+}
+
+Atom mapFn(const ClosureNode& node, ClosureContext& context);
+
+Atom drawFn(const ClosureNode& node, ClosureContext& context) {
+    for (const ClosureNode& child : node.children) {
+        if (child.fn == mapFn) {
+            // draws its elements itself
+            child(context);
+            continue;
+        }
+        Atom graphic = child(context);
+        if (!is_graphic(graphic)) {
+            throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
+        }
+        context.graphics.push_back(graphic);
+    }
+    return Atom();
+}
+
+// Binds the index of a for loop for as long as the loop runs
+class LoopIndex {
+public:
+    LoopIndex(Environment& env, const Symbol& sym, Number start) : env(env), sym(sym) {
+        env.addExp(sym, Expression(start));
+    }
+    ~LoopIndex() { env.removeExp(sym); }
+
+    void set(Number index) { env.setExp(sym, Expression(index)); }
+
+private:
+    Environment& env;
+    Symbol sym;
+};
+
+// run the body, children[3..], at each index from start + iteration * step
+// while the index is before end
+Atom runLoop(const ClosureNode& node, ClosureContext& context, const Atom* range, LoopIndex* index) {
+    const Number start = range[0].value.num_value;
+    const Number end = range[1].value.num_value;
+    const Number step = range[2].value.num_value;
+    // a loop that never runs its body has no value
+    Atom result;
+    for (Number iteration = 0;; iteration += 1) {
+        Number value = start + iteration * step;
+        if (!(step > 0 ? value < end : value > end)) {
+            return result;
+        }
+        if (index != nullptr) {
+            index->set(value);
+        }
+        for (std::size_t i = 3; i < node.children.size(); ++i) {
+            result = node.children[i](context);
+        }
+    }
+}
+
+Atom forFn(const ClosureNode& node, ClosureContext& context) {
+    Atom range[3] = { node.children[0](context), node.children[1](context), node.children[2](context) };
+    if (range[0].type != NumberType || range[1].type != NumberType || range[2].type != NumberType) {
+        throw InterpreterSemanticError("Error: 'for' range must evaluate to Numbers.");
+    }
+    if (range[2].value.num_value == 0) {
+        throw InterpreterSemanticError("Error: 'for' step must not be zero.");
+    }
+    Symbol sym = Symbol::fromId(node.sym);
+    if (context.env.isKnown(sym) || is_special_form(sym)) {
+        throw InterpreterSemanticError("Error: Invalid 'for' Symbol.");
+    }
+    LoopIndex index(context.env, sym, range[0].value.num_value);
+    return runLoop(node, context, range, &index);
+}
+
+// as a for from 0 to count, without an index
+Atom repeatFn(const ClosureNode& node, ClosureContext& context) {
+    Atom range[3] = { node.children[0](context), node.children[1](context), node.children[2](context) };
+    if (range[1].type != NumberType) {
+        throw InterpreterSemanticError("Error: 'repeat' count must evaluate to a Number.");
+    }
+    return runLoop(node, context, range, nullptr);
+}
+
+// an argument of draw, drawing the body at each element of a Range
+Atom mapFn(const ClosureNode& node, ClosureContext& context) {
+    Atom sequence = node.children[0](context);
+    if (sequence.type != RangeType) {
+        throw InterpreterSemanticError("Error: 'map' sequence must evaluate to a Range.");
+    }
+    Symbol sym = Symbol::fromId(node.sym);
+    if (context.env.isKnown(sym) || is_special_form(sym)) {
+        throw InterpreterSemanticError("Error: Invalid 'map' Symbol.");
+    }
+    const Range range = sequence.value.range_value;
+    LoopIndex index(context.env, sym, range.start);
+    for (Number iteration = 0;; iteration += 1) {
+        Number value = range.start + iteration * range.step;
+        if (!(range.step > 0 ? value < range.end : value > range.end)) {
+            return Atom();
+        }
+        index.set(value);
+        Atom graphic = node.children[1](context);
+        if (!is_graphic(graphic)) {
+            throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
+        }
+        context.graphics.push_back(graphic);
+    }
+}
+
+// Compiles one expression into a tree of ClosureNodes
+class Compiler {
+public:
+    Compiler(std::vector<Atom>& constants, std::uint32_t& frameSize, const Environment& env) :
+        constants(constants), frameSize(frameSize), env(env) {}
+
+    ClosureNode node(const Expression& exp);
+
+private:
+    ClosureNode literal(const Atom& atom);
+    ClosureNode fail(const char* message);
+    ClosureNode global(ClosureFn fn, const Symbol& sym);
+    ClosureNode call(const Symbol& name, Procedure proc, const Expression& exp, std::size_t first);
+    ClosureNode list(const Expression& exp);
+    ClosureNode map(const Expression& exp);
+    ClosureNode body(const Expression& exp, std::size_t first);
+    ClosureNode let(const Expression& exp);
+    ClosureNode cond(const Expression& exp);
+    void children(ClosureNode& node, const Expression& exp, std::size_t first);
+    void slot(std::uint32_t index);
+
+    std::vector<Atom>& constants;
+    std::uint32_t& frameSize;
+    const Environment& env;
+};
+
+ClosureNode Compiler::literal(const Atom& atom) {
+    ClosureNode node;
+    if (atom.type == NumberType) {
+        node.fn = numberFn;
+        node.number = atom.value.num_value;
+    }
+    else if (atom.type == BooleanType) {
+        node.fn = booleanFn;
+        node.boolean = atom.value.bool_value;
+    }
+    else {
+        node.fn = constantFn;
+        node.constant = constants.size();
+        constants.push_back(atom);
+    }
+    return node;
+}
+
+ClosureNode Compiler::fail(const char* message) {
+    ClosureNode node;
+    node.fn = failFn;
+    node.message = message;
+    return node;
+}
+
+// a symbol that is not a builtin
+ClosureNode Compiler::global(ClosureFn fn, const Symbol& sym) {
+    ClosureNode node;
+    node.fn = fn;
+    node.sym = sym.id();
+    return node;
+}
+
+// compile exp.tail[first..] as the children of node
+void Compiler::children(ClosureNode& node, const Expression& exp, std::size_t first) {
+    node.children.reserve(exp.tail.size() - first);
+    for (std::size_t i = first; i < exp.tail.size(); ++i) {
+        node.children.push_back(this->node(exp.tail[i]));
+    }
+}
+
+// a slot the frame must hold
+void Compiler::slot(std::uint32_t index) {
+    if (index + 1 > frameSize) {
+        frameSize = index + 1;
+    }
+}
+
+// exp.tail[first..] run in order, as a begin
+ClosureNode Compiler::body(const Expression& exp, std::size_t first) {
+    if (exp.tail.size() == first + 1) {
+        return node(exp.tail[first]);
+    }
+    ClosureNode node;
+    node.fn = beginFn;
+    children(node, exp, first);
+    // a define whose value is unused may be lazy
+    for (std::size_t i = first; i + 1 < exp.tail.size(); ++i) {
+        if (is_valid_define(exp.tail[i])) {
+            ClosureNode deferred;
+            deferred.fn = deferFn;
+            deferred.form = &exp.tail[i];
+            deferred.children.push_back(std::move(node.children[i - first]));
+            node.children[i - first] = std::move(deferred);
+        }
+    }
+    return node;
+}
+
+ClosureNode Compiler::let(const Expression& exp) {
+    if (!is_valid_let(exp)) {
+        return fail("Error: Invalid 'let' syntax.");
+    }
+    if (!is_resolved_let(exp)) {
+        return fail("Error: Invalid 'let' Symbol.");
+    }
+    ClosureNode node;
+    node.fn = letFn;
+    node.form = &exp;
+    const Expression& bindings = exp.tail[1];
+    node.children.reserve(bindings.tail.size() + 1);
+    for (const Expression& binding : bindings.tail) {
+        slot(binding.tail[0].head.value.slot_value);
+        node.children.push_back(this->node(binding.tail[1]));
+    }
+    node.children.push_back(body(exp, 2));
+    return node;
+}
+
+ClosureNode Compiler::cond(const Expression& exp) {
+    if (!is_valid_cond(exp)) {
+        return fail("Error: Invalid 'cond' syntax.");
+    }
+    ClosureNode node;
+    node.fn = condFn;
+    node.children.reserve(2 * (exp.tail.size() - 1));
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        const Expression& clause = exp.tail[i];
+        node.children.push_back(is_else_clause(clause) ? literal(boolean_atom(true)) : this->node(clause.tail[0]));
+        node.children.push_back(body(clause, 1));
+    }
+    return node;
+}
+
+// a call to builtin name on exp.tail[first..]
+ClosureNode Compiler::call(const Symbol& name, Procedure proc, const Expression& exp, std::size_t first) {
+    ClosureNode node;
+    node.fn = callFn;
+    node.proc = proc;
+    children(node, exp, first);
+
+    if (node.children.size() == 2) {
+        for (const BinaryBuiltin& builtin : BINARY_BUILTINS) {
+            if (name == builtin.name) {
+                node.fn = builtin.fn;
+            }
+        }
+    }
+    else if (node.children.size() == 1 && name == "-") {
+        node.fn = negateFn;
+    }
+    return node;
+}
+
+ClosureNode Compiler::list(const Expression& exp) {
+    if (exp.tail.empty()) {
+        return literal(exp.head);
+    }
+
+    const Expression& first = exp.tail[0];
+
+    if (first.head.type == BooleanType || first.head.type == NumberType) {
+        // the rest of the list is never evaluated
+        return literal(first.head);
+    }
+    ClosureNode node;
+    if (exp.head.value.list_info.numeric_op != NotNumeric) {
+        node.fn = unboxedFn;
+        node.form = &exp;
+        return node;
+    }
+    if (first.head.type == SlotType || first.head.type == LambdaType || first.head.type == ListType) {
+        // only a list at the head must be a user procedure
+        node.fn = calleeFn;
+        node.boolean = first.head.type == ListType;
+        children(node, exp, 0);
+        return node;
+    }
+    if (first.head.type != SymbolType) {
+        return fail(INVALID_FORM);
+    }
+
+    const Symbol& name = first.head.value.sym_value;
+    switch (name.id()) {
+    case DefineId:
+        if (exp.tail.size() != 3 || exp.tail[1].head.type != SymbolType) {
+            return fail("Error: Invalid 'define' syntax.");
+        }
+        node.fn = defineFn;
+        node.sym = exp.tail[1].head.value.sym_value.id();
+        children(node, exp, 2);
+        return node;
+    case BeginId:
+        if (exp.tail.size() == 1) {
+            node.fn = noneFn;
+            return node;
+        }
+        return body(exp, 1);
+    case IfId:
+        if (exp.tail.size() != 4) {
+            return fail("Error: Invalid 'if' syntax.");
+        }
+        node.fn = ifFn;
+        children(node, exp, 1);
+        return node;
+    case DrawId:
+        if (exp.tail.size() < 2) {
+            return fail("Error: Invalid 'draw' syntax.");
+        }
+        node.fn = drawFn;
+        node.children.reserve(exp.tail.size() - 1);
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            const Expression& arg = exp.tail[i];
+            if (is_map(arg)) {
+                node.children.push_back(map(arg));
+            }
+            else {
+                node.children.push_back(this->node(arg));
+            }
+        }
+        return node;
+    case ForId: {
+        if (!is_valid_for(exp)) {
+            return fail("Error: Invalid 'for' syntax.");
+        }
+        // start, end and step, then the body
+        const Expression& range = exp.tail[1];
+        node.fn = forFn;
+        node.sym = range.tail[0].head.value.sym_value.id();
+        node.children.reserve(exp.tail.size() + 1);
+        for (std::size_t i = 1; i < range.tail.size(); ++i) {
+            node.children.push_back(this->node(range.tail[i]));
+        }
+        if (range.tail.size() == 3) {
+            node.children.push_back(literal(number_atom(1)));
+        }
+        for (std::size_t i = 2; i < exp.tail.size(); ++i) {
+            node.children.push_back(this->node(exp.tail[i]));
+        }
+        return node;
+    }
+    case RepeatId:
+        if (exp.tail.size() < 3) {
+            return fail("Error: Invalid 'repeat' syntax.");
+        }
+        // laid out as a for from 0 to count
+        node.fn = repeatFn;
+        node.children.reserve(exp.tail.size() + 1);
+        node.children.push_back(literal(number_atom(0)));
+        node.children.push_back(this->node(exp.tail[1]));
+        node.children.push_back(literal(number_atom(1)));
+        for (std::size_t i = 2; i < exp.tail.size(); ++i) {
+            node.children.push_back(this->node(exp.tail[i]));
+        }
+        return node;
+    case MapId:
+        // draw compiles the maps that are its arguments
+        return fail("Error: 'map' is only valid as an argument of 'draw'.");
+    case LambdaId:
+        node.fn = lambdaFn;
+        node.form = &exp;
+        return node;
+    case AndId:
+    case OrId:
+        if (exp.tail.size() < 2) {
+            return fail(name.id() == AndId ? "Error: Invalid 'and' syntax." : "Error: Invalid 'or' syntax.");
+        }
+        node.fn = logicFn;
+        node.boolean = name.id() == OrId;
+        children(node, exp, 1);
+        return node;
+    case LetId:
+        return let(exp);
+    case CondId:
+        return cond(exp);
+    default: {
+        // builtins cannot be redefined, so a procedure now is one forever
+        const Environment::EnvResult* binding = env.lookup(name);
+        if (binding != nullptr && binding->type == Environment::ProcedureType) {
+            return call(name, binding->proc, exp, 1);
+        }
+        // a defined symbol at the head ignores the rest of the list,
+        // unless it is a user procedure
+        node = global(headFn, name);
+        children(node, exp, 1);
+        return node;
+    }
+    }
+}
+
+// a map that is an argument of draw
+ClosureNode Compiler::map(const Expression& exp) {
+    if (!is_valid_map(exp)) {
+        return fail("Error: Invalid 'map' syntax.");
+    }
+    ClosureNode node;
+    node.fn = mapFn;
+    node.sym = exp.tail[1].tail[0].head.value.sym_value.id();
+    node.children.reserve(2);
+    node.children.push_back(this->node(exp.tail[1].tail[1]));
+    node.children.push_back(this->node(exp.tail[2]));
+    return node;
+}
+
+ClosureNode Compiler::node(const Expression& exp) {
+    switch (exp.head.type) {
+    case ListType:
+        return list(exp);
+    case SymbolType: {
+        const Symbol& sym = exp.head.value.sym_value;
+        const Environment::EnvResult* binding = env.lookup(sym);
+        if (binding != nullptr && binding->type == Environment::ProcedureType) {
+            return call(sym, binding->proc, exp, 0);
+        }
+        return global(globalFn, sym);
+    }
+    case BooleanType:
+    case NumberType:
+    case PointType:
+    case LineType:
+    case ArcType:
+    case RangeType:
+    case LambdaType:
+        return literal(exp.head);
+    case SlotType: {
+        ClosureNode node;
+        node.fn = slotFn;
+        node.slot = exp.head.value.slot_value;
+        slot(node.slot);
+        return node;
+    }
+    case SharedType:
+        return this->node(*exp.head.value.shared_value);
+    default:
+        return fail(INVALID_FORM);
+    }
+}
+
+} // namespace
+
+Closure Closure::compile(const Expression& exp, const Environment& env) {
+    Closure closure;
+    closure.frameSize = 0;
+    Compiler compiler(closure.constants, closure.frameSize, env);
+    closure.root = compiler.node(exp);
+    return closure;
+}
+
+Expression Closure::run(Environment& env, std::vector<Atom>& graphics) const {
+    // the locals of the lets outside any user procedure
+    std::vector<Atom> frame(frameSize);
+    ClosureContext context = { env, graphics, constants.data(), frame.data() };
+    return Expression(root(context));
+}
+
+Atom Closure::call(Environment& env, std::vector<Atom>& graphics, Atom* frame) const {
+    ClosureContext context = { env, graphics, constants.data(), frame };
+    return root(context);
+}
@@ -0,0 +1,75 @@
+#ifndef CLOSURE_HPP
+#define CLOSURE_HPP
+
+// system includes
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// What a compiled node runs against
+struct ClosureContext {
+    Environment& env;
+    std::vector<Atom>& graphics;
+    // literals other than numbers and booleans
+    const Atom* constants;
+    // the slots of the frame running: the arguments of the user
+    // procedure, then the locals of its lets
+    Atom* frame;
+};
+
+struct ClosureNode;
+
+// the children of a node, allocated from the current Arena if any
+typedef std::vector<ClosureNode, ArenaAllocator<ClosureNode>> ClosureList;
+
+// The code of a node, chosen when the node is compiled
+typedef Atom (*ClosureFn)(const ClosureNode& node, ClosureContext& context);
+
+// A ClosureNode is one expression with its special form, builtin
+// procedure or literal already resolved
+struct ClosureNode {
+    ClosureFn fn;
+    // what fn needs besides the children
+    union {
+        Number number;
+        Boolean boolean;
+        std::size_t constant;
+        Symbol::Id sym;
+        Procedure proc;
+        const char* message;
+        std::uint32_t slot;
+        const Expression* form;
+    };
+    ClosureList children;
+
+    ClosureNode() : fn(nullptr), number(0) {}
+
+    Atom operator()(ClosureContext& context) const { return fn(*this, context); }
+};
+
+// A Closure is an expression compiled once into a tree of ClosureNodes,
+// allocated like the expression itself,
+// so that running it does no dispatch on types or symbol names and no
+// lookups of builtins. It gives the same results, side effects and
+// errors as Interpreter::eval: syntax errors become nodes that raise
+// them when reached.
+class Closure {
+public:
+    // Builtins are resolved against env, which must be the environment
+    // the closure is run in. Other symbols are looked up when run.
+    static Closure compile(const Expression& exp, const Environment& env);
+
+    Expression run(Environment& env, std::vector<Atom>& graphics) const;
+    // run the body of a user procedure on its frame, which holds the
+    // arguments followed by room for the locals
+    Atom call(Environment& env, std::vector<Atom>& graphics, Atom* frame) const;
+
+private:
+    ClosureNode root;
+    std::vector<Atom> constants;
+    // the slots the frame run needs
+    std::uint32_t frameSize;
+};
+
+#endif
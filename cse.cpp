@@ -0,0 +1,533 @@
+#include "cse.hpp"
+
+// system includes
+#include <algorithm>
+#include <cstring>
+
+// module includes
+#include "typecheck.hpp"
+
+namespace {
+
+// an index of no occurrence, group or temporary
+const std::size_t NO_INDEX = static_cast<std::size_t>(-1);
+
+// the hash h continued with the word w, a whole word at a time
+std::uint64_t mix(std::uint64_t h, std::uint64_t w) {
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 32);
+}
+
+// the bits of the value of a leaf: numbers are compared by their bits,
+// and shared lists by identity, as each is kept once
+std::uint64_t leaf_bits(const Atom& atom) {
+    std::uint64_t bits = 0;
+    switch (atom.type) {
+    case NumberType:
+        std::memcpy(&bits, &atom.value.num_value, sizeof(Number));
+        break;
+    case BooleanType:
+        bits = atom.value.bool_value ? 1 : 0;
+        break;
+    case SymbolType:
+        bits = atom.value.sym_value.id();
+        break;
+    case SlotType:
+        bits = atom.value.slot_value;
+        break;
+    case SharedType:
+        bits = reinterpret_cast<std::uintptr_t>(atom.value.shared_value);
+        break;
+    default:
+        break;
+    }
+    return bits;
+}
+
+// the id of the special form heading exp, NoSymbolId if none
+SpecialFormId special_form(const Expression& exp) {
+    if (exp.tail.empty() || exp.tail[0].head.type != SymbolType) {
+        return NoSymbolId;
+    }
+    const Symbol::Id id = exp.tail[0].head.value.sym_value.id();
+    return id < SpecialFormCount ? static_cast<SpecialFormId>(id) : NoSymbolId;
+}
+
+} // namespace
+
+SubexpressionEliminator::SubexpressionEliminator(const Environment& env) : env(env), numbered(0) {
+}
+
+const CseStats& SubexpressionEliminator::stats() const {
+    return counts;
+}
+
+std::uint32_t SubexpressionEliminator::eliminate(Expression& exp, std::uint32_t frame) {
+    counts = CseStats();
+    scopes.clear();
+    running.clear();
+    indices.clear();
+    locals.clear();
+    defined.clear();
+    keys.clear();
+    table.assign(64, NO_INDEX);
+    groups.clear();
+    occurrences.clear();
+    numbered = 0;
+    temporaries.clear();
+
+    // the forms of a program after its defines, or else the whole form
+    scopes.push_back({ nullptr, 0, 0 });
+    running.push_back(0);
+    if (exp.head.type == ListType && special_form(exp) == BeginId) {
+        scopes[0].owner = &exp;
+        scopes[0].body = 1;
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            Expression& form = exp.tail[i];
+            if (form.head.type != ListType || form.tail.size() != 3 || special_form(form) != DefineId ||
+                form.tail[1].head.type != SymbolType || is_special_form(form.tail[1].head.value.sym_value) ||
+                env.lookup(form.tail[1].head.value.sym_value) != nullptr) {
+                visit(form);
+                continue;
+            }
+            const Info value = visit(form.tail[2]);
+            const Symbol::Id id = form.tail[1].head.value.sym_value.id();
+            if (id >= defined.size()) {
+                defined.resize(id + 1, Info{ NoneType, 0, 0, NO_INDEX });
+            }
+            // a second define of the symbol raises an error, so no form
+            // after it runs to find the symbol bound to its value
+            defined[id] = Info{ value.type, 0, std::max(value.site, i + 1), NO_INDEX };
+        }
+    }
+    else {
+        visit(exp);
+    }
+
+    select(frame);
+    if (temporaries.empty()) {
+        return frame;
+    }
+    rewrite();
+
+    // innermost scopes first, so that the forms of an outer one are
+    // moved with the lets already bound in them, and the last forms of
+    // the program first, so that its forms keep their positions
+    std::vector<std::size_t> order(temporaries.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+        const Temporary& x = temporaries[a];
+        const Temporary& y = temporaries[b];
+        if (x.scope != y.scope) {
+            return x.scope > y.scope;
+        }
+        if (x.site != y.site) {
+            return x.site > y.site;
+        }
+        return x.level < y.level;
+    });
+    std::vector<std::size_t> temps;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        temps.push_back(order[i]);
+        if (i + 1 == order.size() || temporaries[order[i + 1]].scope != temporaries[order[i]].scope ||
+            temporaries[order[i + 1]].site != temporaries[order[i]].site) {
+            bind(exp, temps);
+            temps.clear();
+        }
+    }
+
+    const std::uint32_t size = frame + static_cast<std::uint32_t>(temporaries.size());
+    temporaries.clear();
+    occurrences.clear();
+    return size;
+}
+
+// what is known of exp, recording each subexpression that could be hoisted
+SubexpressionEliminator::Info SubexpressionEliminator::visit(Expression& exp) {
+    switch (exp.head.type) {
+    case NumberType:
+    case BooleanType:
+        return Info{ exp.head.type, 0, 0, NO_INDEX };
+    case SymbolType:
+        return symbol(exp.head.value.sym_value);
+    case SlotType: {
+        const std::uint32_t slot = exp.head.value.slot_value;
+        return slot < locals.size() ? locals[slot] : Info{ NoneType, 0, 0, NO_INDEX };
+    }
+    case SharedType: {
+        // its symbols are all bound in env
+        Info info = { shared(*exp.head.value.shared_value), 0, scopes[0].body, NO_INDEX };
+        if (info.type != NoneType) {
+            key.assign(1, Element{ SharedType, leaf_bits(exp.head) });
+            info.group = record(exp, info, numbered);
+        }
+        ++numbered;
+        return info;
+    }
+    case ListType:
+        return visitList(exp);
+    default:
+        return Info{ NoneType, 0, 0, NO_INDEX };
+    }
+}
+
+SubexpressionEliminator::Info SubexpressionEliminator::visitList(Expression& exp) {
+    const std::size_t first = numbered;
+    const Info none = { NoneType, 0, 0, NO_INDEX };
+    switch (special_form(exp)) {
+    case DefineId:
+        if (exp.tail.size() == 3) {
+            visit(exp.tail[2]);
+        }
+        return none;
+    case LambdaId:
+        return none;
+    case ForId:
+    case MapId: {
+        if (!(special_form(exp) == ForId ? is_valid_for(exp) : is_valid_map(exp))) {
+            return none;
+        }
+        Expression& header = exp.tail[1];
+        for (std::size_t i = 1; i < header.tail.size(); ++i) {
+            visit(header.tail[i]);
+        }
+        const std::size_t scope = open(&exp, 2);
+        indices.push_back(std::make_pair(header.tail[0].head.value.sym_value.id(), scope));
+        visitBody(exp, 2);
+        indices.pop_back();
+        running.pop_back();
+        return none;
+    }
+    case LetId: {
+        if (!is_resolved_let(exp)) {
+            return none;
+        }
+        Expression& bindings = exp.tail[1];
+        std::vector<Info> values;
+        values.reserve(bindings.tail.size());
+        for (Expression& binding : bindings.tail) {
+            values.push_back(visit(binding.tail[1]));
+        }
+        const std::size_t scope = open(&exp, 2);
+        std::vector<std::pair<std::uint32_t, Info>> saved;
+        saved.reserve(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const std::uint32_t slot = bindings.tail[i].tail[0].head.value.slot_value;
+            if (slot >= locals.size()) {
+                locals.resize(slot + 1, none);
+            }
+            saved.push_back(std::make_pair(slot, locals[slot]));
+            locals[slot] = Info{ values[i].type, scope, 0, NO_INDEX };
+        }
+        visitBody(exp, 2);
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            locals[it->first] = it->second;
+        }
+        running.pop_back();
+        return none;
+    }
+    case CondId:
+        // a clause is not evaluated itself, only its elements
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            if (exp.tail[i].head.type == ListType) {
+                visitBody(exp.tail[i], 0);
+            }
+            else {
+                visit(exp.tail[i]);
+            }
+        }
+        return none;
+    case NoSymbolId:
+        break;
+    default:
+        visitBody(exp, 1);
+        return none;
+    }
+
+    // every element is visited, for the calls within those that cannot
+    // be hoisted
+    const Signature* sig = infallible_call(exp, env);
+    const std::size_t base = elements.size();
+    Info info = { NoneType, 0, scopes[0].body, NO_INDEX };
+    for (std::size_t i = 0; i < exp.tail.size(); ++i) {
+        const Info element = visit(exp.tail[i]);
+        if (sig != nullptr && i > 0 && element.type != sig->args[i - 1 < 2 ? i - 1 : 2]) {
+            sig = nullptr;
+        }
+        if (i > 0 && scopes[element.scope].depth > scopes[info.scope].depth) {
+            info.scope = element.scope;
+        }
+        info.site = std::max(info.site, element.site);
+        elements.push_back(element);
+    }
+    if (sig != nullptr) {
+        info.type = sig->result;
+        if (info.scope != 0) {
+            info.site = scopes[info.scope].body;
+        }
+        key.clear();
+        for (std::size_t i = 0; i < exp.tail.size(); ++i) {
+            const Atom& element = exp.tail[i].head;
+            key.push_back(element.type == ListType ? Element{ ListType, elements[base + i].group } :
+                Element{ element.type, leaf_bits(element) });
+        }
+        info.group = record(exp, info, first);
+    }
+    elements.resize(base);
+    ++numbered;
+    return info;
+}
+
+// visit the elements of exp from first on
+void SubexpressionEliminator::visitBody(Expression& exp, std::size_t first) {
+    for (std::size_t i = first; i < exp.tail.size(); ++i) {
+        visit(exp.tail[i]);
+    }
+}
+
+// what is known of the value of sym
+SubexpressionEliminator::Info SubexpressionEliminator::symbol(const Symbol& sym) const {
+    for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+        if (it->first == sym.id()) {
+            return Info{ NumberType, it->second, 0, NO_INDEX };
+        }
+    }
+    const Atom* value = env.global(sym);
+    if (value != nullptr) {
+        return Info{ value->type, 0, 0, NO_INDEX };
+    }
+    if (sym.id() < defined.size()) {
+        return defined[sym.id()];
+    }
+    return Info{ NoneType, 0, 0, NO_INDEX };
+}
+
+// the type of the value of the shared list exp if it cannot raise an
+// error, NoneType otherwise
+Type SubexpressionEliminator::shared(const Expression& exp) const {
+    const Signature* sig = infallible_call(exp, env);
+    if (sig == nullptr) {
+        return NoneType;
+    }
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        const Atom& element = exp.tail[i].head;
+        Type type = element.type;
+        if (type == SymbolType) {
+            const Atom* value = env.global(element.value.sym_value);
+            type = value != nullptr ? value->type : NoneType;
+        }
+        else if (type == SharedType) {
+            type = shared(*element.value.shared_value);
+        }
+        if (type != sig->args[i - 1 < 2 ? i - 1 : 2]) {
+            return NoneType;
+        }
+    }
+    return sig->result;
+}
+
+// open a scope of the forms of owner from body on, within the innermost
+// scope running
+std::size_t SubexpressionEliminator::open(Expression* owner, std::size_t body) {
+    scopes.push_back({ owner, body, scopes[running.back()].depth + 1 });
+    running.push_back(scopes.size() - 1);
+    return scopes.size() - 1;
+}
+
+// record exp, whose elements are in key, as an occurrence of the group
+// of those equal to it in its scope and site, and return the group.
+// As the elements of a list are grouped before it, comparing them never
+// needs to look further down
+std::size_t SubexpressionEliminator::record(Expression& exp, const Info& info, std::size_t first) {
+    std::uint64_t hash = mix(info.scope, info.site);
+    for (const Element& element : key) {
+        hash = mix(mix(hash, element.type), element.bits);
+    }
+
+    std::size_t pos = hash & (table.size() - 1);
+    for (; table[pos] != NO_INDEX; pos = (pos + 1) & (table.size() - 1)) {
+        Group& group = groups[table[pos]];
+        if (group.hash != hash || group.scope != info.scope || group.site != info.site || group.size != key.size()) {
+            continue;
+        }
+        std::size_t i = 0;
+        while (i < key.size() && keys[group.key + i].type == key[i].type && keys[group.key + i].bits == key[i].bits) {
+            ++i;
+        }
+        if (i == key.size()) {
+            ++group.count;
+            occurrences.push_back({ &exp, table[pos], first, numbered });
+            return table[pos];
+        }
+    }
+
+    table[pos] = groups.size();
+    groups.push_back({ hash, info.scope, info.site, keys.size(), key.size(), occurrences.size(), 1 });
+    keys.insert(keys.end(), key.begin(), key.end());
+    occurrences.push_back({ &exp, groups.size() - 1, first, numbered });
+    if (2 * groups.size() > table.size()) {
+        grow();
+    }
+    return groups.size() - 1;
+}
+
+// double the table of groups
+void SubexpressionEliminator::grow() {
+    table.assign(2 * table.size(), NO_INDEX);
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        std::size_t pos = groups[g].hash & (table.size() - 1);
+        while (table[pos] != NO_INDEX) {
+            pos = (pos + 1) & (table.size() - 1);
+        }
+        table[pos] = g;
+    }
+}
+
+// choose the temporaries, slots from frame on: the largest subexpressions
+// first, each found at least twice outside those already chosen
+void SubexpressionEliminator::select(std::uint32_t frame) {
+    // the occurrences of each group found more than once, in the order
+    // they were numbered
+    std::vector<std::size_t> start(groups.size() + 1, 0);
+    std::vector<std::size_t> repeated;
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        if (groups[g].count > 1) {
+            repeated.push_back(g);
+        }
+        start[g + 1] = start[g] + groups[g].count;
+    }
+    if (repeated.empty()) {
+        return;
+    }
+    std::vector<std::size_t> members(occurrences.size());
+    std::vector<std::size_t> filled(start.begin(), start.end() - 1);
+    for (std::size_t i = 0; i < occurrences.size(); ++i) {
+        members[filled[occurrences[i].group]++] = i;
+    }
+    std::stable_sort(repeated.begin(), repeated.end(), [this](std::size_t a, std::size_t b) {
+        const Occurrence& x = occurrences[groups[a].first];
+        const Occurrence& y = occurrences[groups[b].first];
+        return x.last - x.first > y.last - y.first;
+    });
+
+    // the subexpressions, by their number, within one replaced by a
+    // read of a temporary, and the temporary each chosen occurrence is
+    // replaced by. Those within the value of a temporary are still
+    // computed, so may be hoisted again
+    std::vector<bool> covered(numbered, false);
+    std::vector<std::size_t> replaced(numbered, NO_INDEX);
+    std::vector<std::size_t> uses;
+    for (std::size_t g : repeated) {
+        uses.clear();
+        for (std::size_t k = start[g]; k < start[g + 1]; ++k) {
+            if (!covered[occurrences[members[k]].last]) {
+                uses.push_back(members[k]);
+            }
+        }
+        if (uses.size() < 2) {
+            continue;
+        }
+        Temporary temporary;
+        temporary.scope = groups[g].scope;
+        temporary.site = groups[g].site;
+        temporary.slot = frame + static_cast<std::uint32_t>(temporaries.size());
+        temporary.level = 1;
+        temporary.value = uses[0];
+        temporary.uses.assign(uses.begin() + 1, uses.end());
+        for (std::size_t i : uses) {
+            const Occurrence& occurrence = occurrences[i];
+            if (i != uses[0]) {
+                std::fill(covered.begin() + occurrence.first, covered.begin() + occurrence.last + 1, true);
+            }
+            replaced[occurrence.last] = temporaries.size();
+        }
+        counts.replaced += uses.size();
+        temporaries.push_back(std::move(temporary));
+    }
+    counts.temporaries = temporaries.size();
+
+    // a temporary whose value reads others is bound after them, in a
+    // let of a higher level; the smallest were chosen last
+    for (std::size_t t = temporaries.size(); t-- > 0;) {
+        Temporary& temporary = temporaries[t];
+        const Occurrence& value = occurrences[temporary.value];
+        for (std::size_t i = value.first; i < value.last; ++i) {
+            if (replaced[i] != NO_INDEX && replaced[i] != t) {
+                temporary.level = std::max(temporary.level, temporaries[replaced[i]].level + 1);
+            }
+        }
+    }
+}
+// replace the occurrences of each temporary by reads of its slot, the
+// smallest first, so that the values of the larger read them too
+void SubexpressionEliminator::rewrite() {
+    for (std::size_t t = temporaries.size(); t-- > 0;) {
+        Temporary& temporary = temporaries[t];
+        const Expression read = Expression(slot_atom(temporary.slot));
+        for (std::size_t i : temporary.uses) {
+            *occurrences[i].exp = read;
+        }
+        Expression& value = *occurrences[temporary.value].exp;
+        temporary.binding.head.type = ListType;
+        temporary.binding.tail.reserve(2);
+        temporary.binding.tail.push_back(read);
+        temporary.binding.tail.push_back(std::move(value));
+        value = read;
+    }
+}
+
+// bind the temporaries temps, of one scope and site and by ascending
+// level, in nested lets around the forms of the scope from the site on
+void SubexpressionEliminator::bind(Expression& root, const std::vector<std::size_t>& temps) {
+    const Temporary& any = temporaries[temps[0]];
+    Expression* owner = scopes[any.scope].owner;
+    std::vector<Expression> body;
+    if (owner == nullptr) {
+        body.push_back(std::move(root));
+    }
+    else {
+        for (std::size_t i = any.site; i < owner->tail.size(); ++i) {
+            body.push_back(std::move(owner->tail[i]));
+        }
+        owner->tail.erase(owner->tail.begin() + any.site, owner->tail.end());
+    }
+
+    // the highest level innermost
+    std::size_t end = temps.size();
+    while (end > 0) {
+        const std::size_t level = temporaries[temps[end - 1]].level;
+        std::size_t begin = end;
+        while (begin > 0 && temporaries[temps[begin - 1]].level == level) {
+            --begin;
+        }
+        Expression let;
+        let.head.type = ListType;
+        let.tail.reserve(2 + body.size());
+        Atom name;
+        name.type = SymbolType;
+        name.value.sym_value = Symbol::fromId(LetId);
+        let.tail.push_back(Expression(name));
+        Expression bindings;
+        bindings.head.type = ListType;
+        bindings.tail.reserve(end - begin);
+        for (std::size_t i = begin; i < end; ++i) {
+            bindings.tail.push_back(std::move(temporaries[temps[i]].binding));
+        }
+        let.tail.push_back(std::move(bindings));
+        for (Expression& form : body) {
+            let.tail.push_back(std::move(form));
+        }
+        body.clear();
+        body.push_back(std::move(let));
+        end = begin;
+    }
+
+    if (owner == nullptr) {
+        root = std::move(body[0]);
+    }
+    else {
+        owner->tail.push_back(std::move(body[0]));
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef CSE_HPP
+#define CSE_HPP
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of what a SubexpressionEliminator hoisted
+struct CseStats {
+    // hidden temporaries bound
+    std::size_t temporaries;
+    // the subexpressions they replaced
+    std::size_t replaced;
+
+    CseStats() : temporaries(0), replaced(0) {}
+};
+
+// The SubexpressionEliminator finds the calls of builtins that appear
+// more than once in a resolved top-level form and computes each once,
+// into a hidden temporary: a slot past the form's frame, bound by a let
+// around the body the call is evaluated in, whose occurrences become
+// reads of the slot. Only a pure call that cannot raise an error is
+// hoisted, as it is then computed before the forms that used it, even
+// if none of them would have: its arguments are literals, globals bound
+// in env or by a define of the program run before, loop indices, the
+// locals of lets and such calls, of the types the builtin takes, and
+// it is not a division by anything but a nonzero literal, a log10 of
+// anything but a positive literal or a range with a step that may be
+// zero. A call is bound in the innermost body that binds something it
+// uses, once per iteration of a loop that does, and once for all the
+// iterations of one that does not. In a whole program, a (begin ...)
+// form, a call using defines is bound around the forms after the last
+// of them. The bodies of lambdas are left alone, as their parameters
+// may be anything.
+class SubexpressionEliminator {
+public:
+    explicit SubexpressionEliminator(const Environment& env);
+
+    // hoist the common subexpressions of exp, evaluated in a frame of
+    // frame slots, and return the size of the frame it needs then
+    std::uint32_t eliminate(Expression& exp, std::uint32_t frame);
+
+    const CseStats& stats() const;
+
+private:
+    // What is known of a subexpression: the type of its value if it is
+    // pure and cannot raise an error, NoneType otherwise, the innermost
+    // scope binding anything it uses, in the outermost scope the first
+    // form it can be computed before and, if it could be hoisted, the
+    // group of those equal to it
+    struct Info {
+        Type type;
+        std::size_t scope;
+        std::size_t site;
+        std::size_t group;
+    };
+
+    // An element of a subexpression that could be hoisted: a leaf, by
+    // its type and the bits of its value, or a list, by its group
+    struct Element {
+        Type type;
+        std::uint64_t bits;
+    };
+
+    // The subexpressions of one scope and site whose elements are the
+    // size kept in keys from key on, the first numbered first, found
+    // count times
+    struct Group {
+        std::uint64_t hash;
+        std::size_t scope;
+        std::size_t site;
+        std::size_t key;
+        std::size_t size;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    // The forms of owner from body on, which temporaries can be bound
+    // around, or the whole form if owner is nullptr
+    struct Scope {
+        Expression* owner;
+        std::size_t body;
+        std::size_t depth;
+    };
+
+    // A call that could be hoisted, numbered last in a walk of the form,
+    // after its subexpressions numbered from first
+    struct Occurrence {
+        Expression* exp;
+        std::size_t group;
+        std::size_t first;
+        std::size_t last;
+    };
+
+    // A hidden temporary, bound to the value of occurrence value in the
+    // let of its level around the forms of its scope from site on, and
+    // read at its other uses
+    struct Temporary {
+        std::size_t scope;
+        std::size_t site;
+        std::uint32_t slot;
+        std::size_t level;
+        std::size_t value;
+        std::vector<std::size_t> uses;
+        Expression binding;
+    };
+
+    Info visit(Expression& exp);
+    Info visitList(Expression& exp);
+    void visitBody(Expression& exp, std::size_t first);
+    Info symbol(const Symbol& sym) const;
+    Type shared(const Expression& exp) const;
+    std::size_t open(Expression* owner, std::size_t body);
+    std::size_t record(Expression& exp, const Info& info, std::size_t first);
+    void grow();
+    void select(std::uint32_t frame);
+    void rewrite();
+    void bind(Expression& root, const std::vector<std::size_t>& temps);
+
+    const Environment& env;
+    std::vector<Scope> scopes;
+    // the scopes being walked, innermost last
+    std::vector<std::size_t> running;
+    // the indices of the loops being walked and the scopes of their bodies
+    std::vector<std::pair<Symbol::Id, std::size_t>> indices;
+    // what is known of the locals of the lets being walked, by slot
+    std::vector<Info> locals;
+    // what is known of the globals bound by the defines of a program,
+    // by symbol id
+    std::vector<Info> defined;
+    // what is known of the elements of the lists being walked
+    std::vector<Info> elements;
+    // the elements of the subexpression being recorded
+    std::vector<Element> key;
+    // the elements of each group, an open-addressed table of the groups
+    // by hash, and the groups
+    std::vector<Element> keys;
+    std::vector<std::size_t> table;
+    std::vector<Group> groups;
+    std::vector<Occurrence> occurrences;
+    // the subexpressions numbered so far
+    std::size_t numbered;
+    std::vector<Temporary> temporaries;
+    CseStats counts;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "deadcode.hpp"
+
+// module includes
+#include "typecheck.hpp"
+
+namespace {
+
+// true if form is (define sym value)
+bool is_define(const Expression& form) {
+    return form.head.type == ListType && form.tail.size() == 3 && form.tail[0].head.type == SymbolType &&
+        form.tail[0].head.value.sym_value.id() == DefineId && form.tail[1].head.type == SymbolType;
+}
+
+} // namespace
+
+DeadCodeEliminator::DeadCodeEliminator(const Environment& env) : env(env) {
+}
+
+const DeadCodeStats& DeadCodeEliminator::stats() const {
+    return counts;
+}
+
+void DeadCodeEliminator::eliminate(Expression& program, Expression& removed) {
+    if (program.head.type != ListType || program.tail.size() < 3 || program.tail[0].head.type != SymbolType ||
+        program.tail[0].head.value.sym_value.id() != BeginId) {
+        return;
+    }
+    ExpressionList& forms = program.tail;
+
+    // one walk of the program finds the uses of each symbol and the
+    // defines that could be removed, whose values can only use the
+    // defines run before them
+    uses.clear();
+    defined.clear();
+    candidates.clear();
+    valueUses.clear();
+    for (std::size_t i = 1; i < forms.size(); ++i) {
+        const Expression& form = forms[i];
+        if (i + 1 == forms.size() || !is_define(form) || is_special_form(form.tail[1].head.value.sym_value) ||
+            env.lookup(form.tail[1].head.value.sym_value) != nullptr) {
+            count(form);
+            continue;
+        }
+        const Symbol& sym = form.tail[1].head.value.sym_value;
+        use(sym);
+        Candidate define = { i, sym.id(), 3, valueUses.size(), 0 };
+        const Type type = scan(form.tail[2], &define);
+        define.endUse = valueUses.size();
+        if (sym.id() >= defined.size()) {
+            defined.resize(sym.id() + 1, NoneType);
+        }
+        // a second define of sym raises an error, so no form after it
+        // runs to find sym bound to its value
+        defined[sym.id()] = type;
+        if (type != NoneType) {
+            candidates.push_back(define);
+        }
+        else {
+            valueUses.resize(define.firstUse);
+        }
+    }
+
+    // last to first, so that the defines used only by removed ones are
+    // unused by the time they are reached
+    std::vector<bool> dead(forms.size(), false);
+    bool any = false;
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+        if (uses[it->id] != 1) {
+            continue;
+        }
+        --uses[it->id];
+        for (std::size_t i = it->firstUse; i < it->endUse; ++i) {
+            --uses[valueUses[i]];
+        }
+        ++counts.defines;
+        counts.nodes += it->nodes;
+        dead[it->form] = true;
+        any = true;
+    }
+    if (!any) {
+        return;
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < forms.size(); ++i) {
+        if (dead[i]) {
+            removed.tail.push_back(std::move(forms[i]));
+        }
+        else {
+            if (kept != i) {
+                forms[kept] = std::move(forms[i]);
+            }
+            ++kept;
+        }
+    }
+    forms.erase(forms.begin() + kept, forms.end());
+}
+
+// the type of the value of exp if it is pure and cannot raise an
+// error, NoneType otherwise. Within the value of define, the
+// expressions and the uses of symbols are counted
+Type DeadCodeEliminator::scan(const Expression& exp, Candidate* define) {
+    if (define != nullptr) {
+        ++define->nodes;
+    }
+    switch (exp.head.type) {
+    case NumberType:
+    case BooleanType:
+        return exp.head.type;
+    case SymbolType: {
+        const Symbol& sym = exp.head.value.sym_value;
+        const Atom* value = env.global(sym);
+        if (value != nullptr) {
+            return value->type;
+        }
+        // the symbols bound in env are never defined, so need no count
+        if (define != nullptr && !env.isProc(sym)) {
+            use(sym);
+            valueUses.push_back(sym.id());
+        }
+        return sym.id() < defined.size() ? defined[sym.id()] : NoneType;
+    }
+    case SharedType:
+        // counted as one, as its symbols are all bound in env
+        return scan(*exp.head.value.shared_value, nullptr);
+    case ListType:
+        break;
+    default:
+        return NoneType;
+    }
+
+    const Signature* sig = infallible_call(exp, env);
+    // every element is scanned, to count all the uses in a value
+    for (std::size_t i = 0; i < exp.tail.size(); ++i) {
+        const Type type = scan(exp.tail[i], define);
+        if (sig != nullptr && i > 0 && type != sig->args[i - 1 < 2 ? i - 1 : 2]) {
+            sig = nullptr;
+        }
+    }
+    return sig != nullptr ? sig->result : NoneType;
+}
+
+void DeadCodeEliminator::use(const Symbol& sym) {
+    if (sym.id() >= uses.size()) {
+        uses.resize(sym.id() + 1, 0);
+    }
+    ++uses[sym.id()];
+}
+
+// count the uses of the symbols in exp, but those in shared lists,
+// which are all bound in env
+void DeadCodeEliminator::count(const Expression& exp) {
+    std::vector<const Expression*> pending(1, &exp);
+    while (!pending.empty()) {
+        const Expression* next = pending.back();
+        pending.pop_back();
+        if (next->head.type == SymbolType) {
+            use(next->head.value.sym_value);
+        }
+        for (const Expression& child : next->tail) {
+            pending.push_back(&child);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef DEADCODE_HPP
+#define DEADCODE_HPP
+
+// system includes
+#include <cstddef>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of what a DeadCodeEliminator removed
+struct DeadCodeStats {
+    // defines removed from programs
+    std::size_t defines;
+    // the expressions in them, a shared list counting as one
+    std::size_t nodes;
+
+    DeadCodeStats() : defines(0), nodes(0) {}
+};
+
+// The DeadCodeEliminator removes the defines of a whole program, a
+// resolved (begin ...) form, that nothing can observe. A define is
+// removed if it is a form of the begin other than its last, so its
+// value is not the program's, its symbol is unbound in env, not a
+// special form and appears nowhere else in the program, and its value
+// is pure and cannot raise an error: a literal, a global bound in env
+// or by an earlier define of such a value, or a call of a builtin on
+// such values of the types it takes, other than a division by anything
+// but a nonzero literal, a log10 of anything but a positive literal or
+// a range with a step that may be zero. Lambdas are kept, as making
+// one numbers it. Removing a define may leave the defines its value
+// used unused in turn, so they are considered last to first.
+class DeadCodeEliminator {
+public:
+    explicit DeadCodeEliminator(const Environment& env);
+
+    // move the defines removed from program to the tail of removed,
+    // to be released with program rather than while it runs
+    void eliminate(Expression& program, Expression& removed);
+
+    const DeadCodeStats& stats() const;
+
+private:
+    // A define that can be removed once its symbol is unused
+    struct Candidate {
+        std::size_t form;
+        Symbol::Id id;
+        // the expressions in it
+        std::size_t nodes;
+        // where the symbols its value uses are in valueUses
+        std::size_t firstUse;
+        std::size_t endUse;
+    };
+
+    Type scan(const Expression& exp, Candidate* define);
+    void use(const Symbol& sym);
+    void count(const Expression& exp);
+
+    const Environment& env;
+    // how often each symbol the program could define appears in it,
+    // by symbol id
+    std::vector<std::size_t> uses;
+    // the types of the values of the defines that cannot raise an
+    // error, by symbol id, NoneType for the rest
+    std::vector<Type> defined;
+    std::vector<Candidate> candidates;
+    // the symbols the value of each candidate uses, one after another,
+    // so that removing it needs no second walk of its value
+    std::vector<Symbol::Id> valueUses;
+    DeadCodeStats counts;
+};
+
+#endif
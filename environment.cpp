@@ -1,18 +1,22 @@
 #include "environment.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <utility>
 
 #include "interpreter_semantic_error.hpp"
+#include "resolver.hpp"
+#include "typecheck.hpp"
 
 using namespace std;
 const double PI = atan2(0, -1);
 
-Environment::Environment() {
+Environment::Environment() : defines(EagerDefine), thunksPending(0) {
 	init();
 }
 
-Expression add(const std::vector<Atom>& args) {
+Atom add(const ArgList& args) {
 	if (args.empty()) {
 		throw InterpreterSemanticError("Wrong number of args for +");
 	}
@@ -26,10 +30,10 @@ Expression add(const std::vector<Atom>& args) {
 		}
 	}
 
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression mul(const std::vector<Atom>& args) {
+Atom mul(const ArgList& args) {
 	if (args.empty()) {
 		throw InterpreterSemanticError("mul failed, expected at least one argument");
 	}
@@ -44,10 +48,10 @@ Expression mul(const std::vector<Atom>& args) {
 		result *= arg.value.num_value;
 	}
 
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression div(const std::vector<Atom>& args) {
+Atom div(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("div failed, expected exactly two arguments");
 	}
@@ -61,16 +65,16 @@ Expression div(const std::vector<Atom>& args) {
 	}
 
 	Number result = args[0].value.num_value / args[1].value.num_value;
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression subneg(const std::vector<Atom>& args) {
+Atom subneg(const ArgList& args) {
 	if (args.size() == 1) {
 		if (args[0].type != NumberType) {
 			throw InterpreterSemanticError("subneg failed, expected a single number argument");
 		}
 		Number result = -args[0].value.num_value;
-		return Expression(result);
+		return number_atom(result);
 	}
 
 	if (args.size() == 2) {
@@ -78,13 +82,13 @@ Expression subneg(const std::vector<Atom>& args) {
 			throw InterpreterSemanticError("subneg failed, expected two number arguments");
 		}
 		Number result = args[0].value.num_value - args[1].value.num_value;
-		return Expression(result);
+		return number_atom(result);
 	}
 
 	throw InterpreterSemanticError("subneg failed, invalid number of arguments");
 }
 
-Expression gt(const std::vector<Atom>& args) {
+Atom gt(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("gt failed, expected exactly two arguments");
 	}
@@ -94,10 +98,10 @@ Expression gt(const std::vector<Atom>& args) {
 	}
 
 	bool result = args[0].value.num_value > args[1].value.num_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression lt(const std::vector<Atom>& args) {
+Atom lt(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("lt failed, expected exactly two arguments");
 	}
@@ -107,10 +111,10 @@ Expression lt(const std::vector<Atom>& args) {
 	}
 
 	bool result = args[0].value.num_value < args[1].value.num_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression gteq(const std::vector<Atom>& args) {
+Atom gteq(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("gteq failed, expected exactly two arguments");
 	}
@@ -120,10 +124,10 @@ Expression gteq(const std::vector<Atom>& args) {
 	}
 
 	bool result = args[0].value.num_value >= args[1].value.num_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression eq(const std::vector<Atom>& args) {
+Atom eq(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("eq failed, expected exactly two arguments");
 	}
@@ -133,10 +137,10 @@ Expression eq(const std::vector<Atom>& args) {
 	}
 
 	bool result = args[0].value.num_value == args[1].value.num_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression lteq(const std::vector<Atom>& args) {
+Atom lteq(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("lteq failed, expected exactly two arguments");
 	}
@@ -146,10 +150,10 @@ Expression lteq(const std::vector<Atom>& args) {
 	}
 
 	bool result = args[0].value.num_value <= args[1].value.num_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression log10(const std::vector<Atom>& args) {
+Atom log10(const ArgList& args) {
 	if (args.size() != 1) {
 		throw InterpreterSemanticError("log10 failed, expected exactly one argument");
 	}
@@ -163,10 +167,10 @@ Expression log10(const std::vector<Atom>& args) {
 	}
 
 	Number result = float(log10(args[0].value.num_value));
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression pow(const std::vector<Atom>& args) {
+Atom pow(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("pow failed, expected exactly two arguments");
 	}
@@ -179,10 +183,10 @@ Expression pow(const std::vector<Atom>& args) {
 	Number exponent = args[1].value.num_value;
 
 	Number result = pow(base, exponent);
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression Not(const std::vector<Atom>& args) {
+Atom Not(const ArgList& args) {
 	if (args.size() != 1) {
 		throw InterpreterSemanticError("not failed, expected exactly one argument");
 	}
@@ -192,46 +196,10 @@ Expression Not(const std::vector<Atom>& args) {
 	}
 
 	bool result = !args[0].value.bool_value;
-	return Expression(result);
+	return boolean_atom(result);
 }
 
-Expression Or(const std::vector<Atom>& args) {
-	if (args.empty()) {
-		throw InterpreterSemanticError("or failed, expected at least one argument");
-	}
-
-	for (const Atom& arg : args) {
-		if (arg.type != BooleanType) {
-			throw InterpreterSemanticError("or failed, argument not a boolean");
-		}
-
-		if (arg.value.bool_value) {
-			return Expression(true);
-		}
-	}
-
-	return Expression(false);
-}
-
-Expression And(const std::vector<Atom>& args) {
-	if (args.empty()) {
-		throw InterpreterSemanticError("and failed, expected at least one argument");
-	}
-
-	for (const Atom& arg : args) {
-		if (arg.type != BooleanType) {
-			throw InterpreterSemanticError("and failed, argument not a boolean");
-		}
-
-		if (!arg.value.bool_value) {
-			return Expression(false);
-		}
-	}
-
-	return Expression(true);
-}
-
-Expression makePoint(const std::vector<Atom>& args) {
+Atom makePoint(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("point failed, expected exactly two arguments");
 	}
@@ -240,14 +208,10 @@ Expression makePoint(const std::vector<Atom>& args) {
 		throw InterpreterSemanticError("point failed, arguments not numbers");
 	}
 
-	Expression point(
-		std::make_tuple(args[0].value.num_value, args[1].value.num_value)
-	);
-
-	return point;
+	return point_atom(args[0].value.num_value, args[1].value.num_value);
 }
 
-Expression makeLine(const std::vector<Atom>& args) {
+Atom makeLine(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("line failed, expected exactly two arguments");
 	}
@@ -256,21 +220,10 @@ Expression makeLine(const std::vector<Atom>& args) {
 		throw InterpreterSemanticError("line failed, arguments not points");
 	}
 
-	Expression line(
-		std::make_tuple(
-			args[0].value.point_value.x,
-			args[0].value.point_value.y
-		),
-		std::make_tuple(
-			args[1].value.point_value.x,
-			args[1].value.point_value.y
-		)
-	);
-
-	return line;
+	return line_atom(args[0].value.point_value, args[1].value.point_value);
 }
 
-Expression makeArc(const std::vector<Atom>& args) {
+Atom makeArc(const ArgList& args) {
 	if (args.size() != 3) {
 		throw InterpreterSemanticError("arc failed, expected exactly three arguments");
 	}
@@ -279,22 +232,31 @@ Expression makeArc(const std::vector<Atom>& args) {
 		throw InterpreterSemanticError("arc failed, invalid argument types");
 	}
 
-	Expression arc(
-		std::make_tuple(
-			args[0].value.point_value.x,
-			args[0].value.point_value.y
-		),
-		std::make_tuple(
-			args[1].value.point_value.x,
-			args[1].value.point_value.y
-		),
-		args[2].value.num_value
-	);
+	return arc_atom(args[0].value.point_value, args[1].value.point_value, args[2].value.num_value);
+}
+
+// (range end), (range start end) or (range start end step)
+Atom makeRange(const ArgList& args) {
+	if (args.empty() || args.size() > 3) {
+		throw InterpreterSemanticError("range failed, expected one to three arguments");
+	}
+
+	for (const Atom& arg : args) {
+		if (arg.type != NumberType) {
+			throw InterpreterSemanticError("range failed, arguments not numbers");
+		}
+	}
 
-	return arc;
+	Number start = args.size() == 1 ? 0 : args[0].value.num_value;
+	Number end = args.size() == 1 ? args[0].value.num_value : args[1].value.num_value;
+	Number step = args.size() == 3 ? args[2].value.num_value : 1;
+	if (step == 0) {
+		throw InterpreterSemanticError("range failed, step is zero");
+	}
+	return range_atom(start, end, step);
 }
 
-Expression sinFunc(const std::vector<Atom>& args) {
+Atom sinFunc(const ArgList& args) {
 	if (args.size() != 1) {
 		throw InterpreterSemanticError("sin failed, expected exactly one argument");
 	}
@@ -304,10 +266,10 @@ Expression sinFunc(const std::vector<Atom>& args) {
 	}
 
 	Number result = sin(args[0].value.num_value);
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression cosFunc(const std::vector<Atom>& args) {
+Atom cosFunc(const ArgList& args) {
 	if (args.size() != 1) {
 		throw InterpreterSemanticError("cos failed, expected exactly one argument");
 	}
@@ -317,10 +279,10 @@ Expression cosFunc(const std::vector<Atom>& args) {
 	}
 
 	Number result = cos(args[0].value.num_value);
-	return Expression(result);
+	return number_atom(result);
 }
 
-Expression arctanFunc(const std::vector<Atom>& args) {
+Atom arctanFunc(const ArgList& args) {
 	if (args.size() != 2) {
 		throw InterpreterSemanticError("arctan failed, expected exactly two arguments");
 	}
@@ -330,7 +292,7 @@ Expression arctanFunc(const std::vector<Atom>& args) {
 	}
 
 	Number result = atan2(args[0].value.num_value, args[1].value.num_value);
-	return Expression(result);
+	return number_atom(result);
 }
 
 Expression LiteralBool(bool x) {
@@ -347,135 +309,367 @@ Expression LiteralNumber(Number num) {
 	return result;
 }
 
+// The builtin procedures, bound by init()
+struct Builtin {
+	const char* name;
+	Procedure proc;
+};
+
+constexpr Builtin BUILTINS[] = {
+	{ "<", lt },
+	{ ">=", gteq },
+	{ "+", add },
+	{ "<=", lteq },
+	{ "not", Not },
+	{ "=", eq },
+	{ ">", gt },
+	{ "*", mul },
+	{ "-", subneg },
+	{ "log10", log10 },
+	{ "/", div },
+	{ "pow", pow },
+	{ "point", makePoint },
+	{ "line", makeLine },
+	{ "arc", makeArc },
+	{ "range", makeRange },
+	{ "sin", sinFunc },
+	{ "cos", cosFunc },
+	{ "arctan", arctanFunc },
+};
+
+const Environment::EnvResult* Environment::lookup(const Symbol& sym) const {
+	if (sym.id() < bindings.size() && bindings[sym.id()].type != UnboundType) {
+		return &bindings[sym.id()];
+	}
+	return nullptr;
+}
+
 bool Environment::isKnown(const Symbol& sym) {
-	return envmap.find(sym) != envmap.end();
+	return lookup(sym) != nullptr;
 }
 
 bool Environment::isExp(const Symbol& sym) {
-	auto found = envmap.find(sym);
-	return found != envmap.end() && found->second.type == ExpressionType;
+	const EnvResult* found = lookup(sym);
+	return found != nullptr && found->type == ExpressionType;
 }
 
 // Get an expression associated with a symbol
-Expression Environment::getExp(const Symbol& sym) const {
-	auto it = envmap.find(sym);
-	if (it != envmap.end() && it->second.type == ExpressionType) {
-		return it->second.exp;
+const Expression& Environment::getExp(const Symbol& sym) const {
+	const EnvResult* found = lookup(sym);
+	if (found != nullptr && found->type == ExpressionType) {
+		return found->exp;
 	}
 	throw InterpreterSemanticError("Symbol not found or does not contain an expression.");
 }
 
 void Environment::addExp(const Symbol& sym, const Expression& exp) {
-	EnvResult result;
+	EnvResult& result = bind(sym);
+	if (result.type != UnboundType) {
+		throw InterpreterSemanticError("Symbol redefinition is not allowed.");
+	}
+
 	result.type = ExpressionType;
 	result.exp = exp;
+	globals[sym.id()] = Global(result.exp.head);
+}
 
-	auto it = envmap.find(sym);
-	if (it != envmap.end()) {
+void Environment::addExp(const Symbol& sym, Expression&& exp) {
+	EnvResult& result = bind(sym);
+	if (result.type != UnboundType) {
 		throw InterpreterSemanticError("Symbol redefinition is not allowed.");
 	}
 
-	envmap[sym] = result;
-}
-
-bool Environment::isProc(const Symbol& sym) const {
-	auto it = envmap.find(sym);
-	return (it != envmap.end() && it->second.type == ProcedureType);
+	result.type = ExpressionType;
+	result.exp = std::move(exp);
+	globals[sym.id()] = Global(result.exp.head);
 }
 
-Procedure Environment::getProc(const Symbol& sym) const {
-	auto it = envmap.find(sym);
-	if (it != envmap.end() && it->second.type == ProcedureType) {
-		return it->second.proc;
+bool Environment::defer(const Symbol& sym, const Expression& value) {
+	if (defines == EagerDefine || (value.head.type != ListType && value.head.type != SharedType)) {
+		return false;
+	}
+	const std::size_t first = thunkSteps.size();
+	const std::size_t captured = thunkValues.size();
+	Type type;
+	const bool deferred = compile(value, type) && (defines == LazyDefineDeferErrors || type != NoneType);
+	if (!deferred || isKnown(sym) || is_special_form(sym)) {
+		thunkSteps.resize(first);
+		thunkValues.resize(captured);
+		if (deferred) {
+			throw InterpreterSemanticError("Error: Invalid define Symbol.");
+		}
+		return false;
 	}
-	throw std::runtime_error("Symbol not found or does not contain a procedure.");
-}
 
-void Environment::init() {
-	envmap.clear();
-
-	envmap["<"];
-	envmap["<"].type = ProcedureType;
-	envmap["<"].proc = lt;
-
-	envmap[">="];
-	envmap[">="].type = ProcedureType;
-	envmap[">="].proc = gteq;
-
-	envmap["+"];
-	envmap["+"].type = ProcedureType;
-	envmap["+"].proc = add;
-
-	envmap["<="];
-	envmap["<="].type = ProcedureType;
-	envmap["<="].proc = lteq;
-
-	envmap["and"];
-	envmap["and"].type = ProcedureType;
-	envmap["and"].proc = And;
-
-	envmap["not"];
-	envmap["not"].type = ProcedureType;
-	envmap["not"].proc = Not;
+	EnvResult& result = bind(sym);
+	result.type = ThunkType;
+	result.result = type;
+	result.first = static_cast<std::uint32_t>(first);
+	result.count = static_cast<std::uint32_t>(thunkSteps.size() - first);
+	++thunksPending;
+	return true;
+}
 
-	envmap["or"];
-	envmap["or"].type = ProcedureType;
-	envmap["or"].proc = Or;
+// Append the steps computing exp to thunkSteps, if it is a literal, a
+// global bound to a value or a thunk, or a call of a builtin on such
+// expressions, setting type to the type of its value if it cannot raise
+// an error. A global bound to a value is read now, as a loop index may
+// be rebound before the thunk is forced.
+bool Environment::compile(const Expression& exp, Type& type) {
+	type = exp.head.type;
+	ThunkStep step;
+	switch (exp.head.type) {
+	case NumberType:
+		step.kind = ThunkStep::NumberStep;
+		step.number = exp.head.value.num_value;
+		thunkSteps.push_back(step);
+		return exp.tail.empty();
+	case BooleanType:
+		step.kind = ThunkStep::BooleanStep;
+		step.number = exp.head.value.bool_value ? 1 : 0;
+		thunkSteps.push_back(step);
+		return exp.tail.empty();
+	case SymbolType: {
+		const EnvResult* found = lookup(exp.head.value.sym_value);
+		if (found == nullptr || found->type == ProcedureType) {
+			return false;
+		}
+		if (found->type == ThunkType) {
+			step.kind = ThunkStep::ReadStep;
+			step.index = exp.head.value.sym_value.id();
+			type = found->result;
+		}
+		else {
+			step.kind = ThunkStep::CapturedStep;
+			step.index = static_cast<std::uint32_t>(thunkValues.size());
+			thunkValues.push_back(globals[exp.head.value.sym_value.id()].value);
+			type = thunkValues.back().type;
+		}
+		thunkSteps.push_back(step);
+		return true;
+	}
+	case SharedType:
+		return compile(*exp.head.value.shared_value, type);
+	case ListType:
+		break;
+	default:
+		return false;
+	}
+
+	const EnvResult* head = exp.tail.empty() || exp.tail[0].head.type != SymbolType ? nullptr :
+		lookup(exp.tail[0].head.value.sym_value);
+	if (head == nullptr || head->type != ProcedureType) {
+		return false;
+	}
+	const Signature* sig = infallible_call(exp, *this);
+	bool infallible = sig != nullptr;
+	for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+		Type arg;
+		if (!compile(exp.tail[i], arg)) {
+			return false;
+		}
+		infallible = infallible && arg == sig->args[std::min<std::size_t>(i - 1, 2)];
+	}
+	step.kind = ThunkStep::CallStep;
+	step.index = static_cast<std::uint32_t>(exp.tail.size() - 1);
+	step.proc = head->proc;
+	thunkSteps.push_back(step);
+	type = infallible ? sig->result : NoneType;
+	return true;
+}
 
-	envmap["="];
-	envmap["="].type = ProcedureType;
-	envmap["="].proc = eq;
+const Atom* Environment::force(const Symbol& sym) {
+	if (sym.id() >= bindings.size() || bindings[sym.id()].type != ThunkType) {
+		return nullptr;
+	}
+
+	// the thunks it reads are forced first, innermost first, so that a
+	// long chain of them does not recurse. A thunk whose value raises an
+	// error stays a thunk, to raise it again when next read.
+	std::vector<Symbol::Id> thunks(1, sym.id());
+	while (!thunks.empty()) {
+		const EnvResult& thunk = bindings[thunks.back()];
+		const std::size_t waiting = thunks.size();
+		if (thunk.type == ThunkType) {
+			for (std::uint32_t i = thunk.first; i < thunk.first + thunk.count; ++i) {
+				const ThunkStep& step = thunkSteps[i];
+				if (step.kind == ThunkStep::ReadStep && bindings[step.index].type == ThunkType) {
+					thunks.push_back(step.index);
+				}
+			}
+		}
+		if (thunks.size() > waiting) {
+			continue;
+		}
+		const Symbol::Id id = thunks.back();
+		if (thunk.type == ThunkType) {
+			const Atom value = evaluate(thunk);
+			ArenaScope heap(nullptr);
+			bindings[id].type = ExpressionType;
+			bindings[id].exp = Expression(value);
+			globals[id] = Global(value);
+			if (--thunksPending == 0) {
+				thunkSteps.clear();
+				thunkValues.clear();
+			}
+		}
+		thunks.pop_back();
+	}
+	return &globals[sym.id()].value;
+}
 
-	envmap[">"];
-	envmap[">"].type = ProcedureType;
-	envmap[">"].proc = gt;
+// the value of thunk, every thunk it reads already forced
+Atom Environment::evaluate(const EnvResult& thunk) {
+	ArenaScope heap(nullptr);
+	thunkStack.clear();
+	for (std::uint32_t i = thunk.first; i < thunk.first + thunk.count; ++i) {
+		const ThunkStep& step = thunkSteps[i];
+		switch (step.kind) {
+		case ThunkStep::NumberStep:
+			thunkStack.push_back(number_atom(step.number));
+			break;
+		case ThunkStep::BooleanStep:
+			thunkStack.push_back(boolean_atom(step.number != 0));
+			break;
+		case ThunkStep::CapturedStep:
+			thunkStack.push_back(thunkValues[step.index]);
+			break;
+		case ThunkStep::ReadStep:
+			thunkStack.push_back(globals[step.index].value);
+			break;
+		case ThunkStep::CallStep:
+			thunkArgs.assign(thunkStack.end() - step.index, thunkStack.end());
+			thunkStack.resize(thunkStack.size() - step.index);
+			thunkStack.push_back(step.proc(thunkArgs));
+			break;
+		}
+	}
+	return thunkStack.back();
+}
 
-	envmap["*"];
-	envmap["*"].type = ProcedureType;
-	envmap["*"].proc = mul;
+void Environment::setDefineMode(DefineMode mode) {
+	defines = mode;
+}
 
-	envmap["-"];
-	envmap["-"].type = ProcedureType;
-	envmap["-"].proc = subneg;
+void Environment::setExp(const Symbol& sym, const Expression& exp) {
+	EnvResult& result = bind(sym);
+	assert(result.type == ExpressionType);
+	if (result.exp.head.type == LambdaType) {
+		invalidate();
+	}
+	result.exp = exp;
+	globals[sym.id()] = Global(result.exp.head);
+}
 
-	envmap["log10"];
-	envmap["log10"].type = ProcedureType;
-	envmap["log10"].proc = log10;
+void Environment::removeExp(const Symbol& sym) {
+	EnvResult& result = bind(sym);
+	assert(result.type == ExpressionType);
+	if (result.exp.head.type == LambdaType) {
+		invalidate();
+	}
+	result.type = UnboundType;
+	result.exp = Expression();
+	globals[sym.id()] = Global();
+}
 
-	envmap["/"];
-	envmap["/"].type = ProcedureType;
-	envmap["/"].proc = div;
+void Environment::undefine(const Symbol& sym) {
+	removeExp(sym);
+	invalidate();
+}
 
-	envmap["pi"];
-	envmap["pi"].type = ExpressionType;
-	envmap["pi"].exp = LiteralNumber(PI);
+bool Environment::isProc(const Symbol& sym) const {
+	const EnvResult* found = lookup(sym);
+	return found != nullptr && found->type == ProcedureType;
+}
 
-	envmap["pow"];
-	envmap["pow"].type = ProcedureType;
-	envmap["pow"].proc = pow;
+Procedure Environment::getProc(const Symbol& sym) const {
+	const EnvResult* found = lookup(sym);
+	if (found != nullptr && found->type == ProcedureType) {
+		return found->proc;
+	}
+	throw std::runtime_error("Symbol not found or does not contain a procedure.");
+}
 
-	envmap["point"];
-	envmap["point"].type = ProcedureType;
-	envmap["point"].proc = makePoint;
+Atom Environment::addLambda(const Expression& form, const Atom* frame) {
+	if (form.tail.size() < 3 || form.tail[1].head.type != ListType) {
+		throw InterpreterSemanticError("Error: Invalid 'lambda' syntax.");
+	}
+	std::vector<Symbol> params;
+	for (const Expression& param : form.tail[1].tail) {
+		if (param.head.type != SymbolType) {
+			throw InterpreterSemanticError("Error: Invalid 'lambda' syntax.");
+		}
+		// builtins are resolved before parameters, so cannot be hidden
+		const Symbol& sym = param.head.value.sym_value;
+		if (is_special_form(sym) || isProc(sym) || std::find(params.begin(), params.end(), sym) != params.end()) {
+			throw InterpreterSemanticError("Error: Invalid 'lambda' Symbol.");
+		}
+		params.push_back(sym);
+	}
+
+	ArenaScope heap(nullptr);
+	Lambda lambda;
+	lambda.arity = static_cast<std::uint32_t>(params.size());
+	if (form.tail.size() == 3) {
+		lambda.body = form.tail[2];
+	}
+	else {
+		// several body forms run as a begin
+		Atom begin;
+		begin.type = SymbolType;
+		begin.value.sym_value = Symbol::fromId(BeginId);
+		lambda.body.head.type = ListType;
+		lambda.body.tail.reserve(form.tail.size() - 1);
+		lambda.body.tail.push_back(Expression(begin));
+		for (std::size_t i = 2; i < form.tail.size(); ++i) {
+			lambda.body.tail.push_back(form.tail[i]);
+		}
+	}
+	lambda.frameSize = resolve_lambda(lambda.body, params, frame, *this);
+	lambdas.push_back(std::move(lambda));
+	return lambda_atom(static_cast<std::uint32_t>(lambdas.size() - 1));
+}
 
-	envmap["line"];
-	envmap["line"].type = ProcedureType;
-	envmap["line"].proc = makeLine;
+const Lambda& Environment::getLambda(std::uint32_t id) const {
+	assert(id < lambdas.size());
+	return lambdas[id];
+}
 
-	envmap["arc"];
-	envmap["arc"].type = ProcedureType;
-	envmap["arc"].proc = makeArc;
+// Get the slot for sym, growing the array to cover every interned symbol
+Environment::EnvResult& Environment::bind(const Symbol& sym) {
+	if (sym.id() >= bindings.size()) {
+		EnvResult unbound;
+		unbound.type = UnboundType;
+		unbound.proc = nullptr;
+		unbound.result = NoneType;
+		unbound.first = 0;
+		unbound.count = 0;
+		bindings.resize(SymbolTable::global().size(), unbound);
+		globals.resize(bindings.size());
+	}
+	return bindings[sym.id()];
+}
 
-	envmap["sin"];
-	envmap["sin"].type = ProcedureType;
-	envmap["sin"].proc = sinFunc;
+// Generations are numbered across all Environments, from 1
+void Environment::invalidate() {
+	static std::uint32_t generations = 0;
+	current = ++generations;
+}
 
-	envmap["cos"];
-	envmap["cos"].type = ProcedureType;
-	envmap["cos"].proc = cosFunc;
+void Environment::init() {
+	bindings.clear();
+	globals.clear();
+	lambdas.clear();
+	thunkSteps.clear();
+	thunkValues.clear();
+	thunksPending = 0;
+	invalidate();
 
-	envmap["arctan"];
-	envmap["arctan"].type = ProcedureType;
-	envmap["arctan"].proc = arctanFunc;
+	for (const Builtin& builtin : BUILTINS) {
+		EnvResult& result = bind(builtin.name);
+		result.type = ProcedureType;
+		result.proc = builtin.proc;
+	}
 
+	addExp("pi", LiteralNumber(PI));
 }
@@ -2,32 +2,153 @@
 #define ENVIRONMENT_HPP
 
 // system includes
-#include <map>
+#include <deque>
+#include <memory>
+#include <vector>
 
 // module includes
 #include "expression.hpp"
 
+struct Chunk;
+class Closure;
+
+// A Lambda is a user procedure. Its body is resolved when the lambda
+// form is evaluated: each parameter and let local becomes a SlotType
+// index into the frame of a call, and each slot of an enclosing frame
+// is replaced by its value.
+struct Lambda {
+    std::uint32_t arity;
+    // the parameters followed by the locals of the body's lets
+    std::uint32_t frameSize;
+    // allocated on the heap, to outlive the program that made it
+    Expression body;
+    // the body compiled by each backend when first called
+    mutable std::shared_ptr<const Chunk> chunk;
+    mutable std::shared_ptr<const Closure> closure;
+};
+
 class Environment {
 public:
+    // A symbol is bound to either an expression or a procedure, or by a
+    // lazy define to a thunk, a call of builtins evaluated when first read
+    enum EnvResultType { UnboundType, ExpressionType, ProcedureType, ThunkType };
+    struct EnvResult {
+        EnvResultType type;
+        Expression exp;
+        Procedure proc;
+        // for a ThunkType, the type of its value if it is proven never to
+        // raise an error, NoneType otherwise, and its steps
+        Type result;
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    // How a define whose value is unused, one before the last form of a
+    // begin, a let or a clause of a cond, binds its symbol when its value
+    // is a call of builtins on literals, globals and such calls.
+    // EagerDefine evaluates it then, as every other define is. LazyDefine
+    // binds a thunk instead if the call can never raise an error, so that
+    // nothing but the time it is evaluated changes. LazyDefineDeferErrors
+    // binds a thunk whatever the call, raising its error at every read
+    // of the symbol, or never if it is never read.
+    enum DefineMode { EagerDefine, LazyDefine, LazyDefineDeferErrors };
+
     Environment();
+    // find the binding of sym with a single probe, nullptr if unbound
+    const EnvResult* lookup(const Symbol& sym) const;
+    // the value sym is bound to, nullptr unless it is bound to an
+    // expression, whose value may be None: one indexed load, however
+    // many globals there are
+    const Atom* global(const Symbol& sym) const {
+        return sym.id() < globals.size() && globals[sym.id()].bound ? &globals[sym.id()].value : nullptr;
+    }
     bool isKnown(const Symbol& sym);
     bool isExp(const Symbol& sym);
-    Expression getExp(const Symbol& sym) const;
+    const Expression& getExp(const Symbol& sym) const;
     void addExp(const Symbol& sym, const Expression& exp);
+    // bind sym to exp without copying it
+    void addExp(const Symbol& sym, Expression&& exp);
+    // bind sym to a thunk of value, if the DefineMode allows it, raising
+    // the error define would if sym is already bound. False if value is
+    // to be evaluated, as it cannot be deferred.
+    bool defer(const Symbol& sym, const Expression& value);
+    // as global, forcing sym first if it is bound to a thunk: its value,
+    // once evaluated without error, is kept as an expression is
+    const Atom* value(const Symbol& sym) {
+        const Atom* found = global(sym);
+        return found != nullptr ? found : force(sym);
+    }
+    // evaluate the thunk sym is bound to, nullptr if it is bound to none
+    const Atom* force(const Symbol& sym);
+    void setDefineMode(DefineMode mode);
+    DefineMode defineMode() const { return defines; }
+    // rebind sym, which must be bound to an expression, to exp
+    void setExp(const Symbol& sym, const Expression& exp);
+    // unbind sym, so that it can be bound again
+    void removeExp(const Symbol& sym);
+    // unbind sym, bound by a define, so that a redefinition can bind it
+    // to another value, starting a new generation
+    void undefine(const Symbol& sym);
     bool isProc(const Symbol& sym) const;
     Procedure getProc(const Symbol& sym) const;
+    // make a Lambda from the form (lambda (params...) body...),
+    // evaluated where frame holds the slots of the enclosing frame
+    Atom addLambda(const Expression& form, const Atom* frame);
+    const Lambda& getLambda(std::uint32_t id) const;
     void init();
 
+    // changes whenever a builtin or user procedure may stop being bound
+    // to the symbol it was found at, or a define is undone, and is never
+    // the same in two Environments, so that a call can cache what its
+    // head resolved to, and a pure list its value
+    std::uint32_t generation() const { return current; }
+
 private:
-    // Environment is a mapping from symbols to expressions or procedures
-    enum EnvResultType { ExpressionType, ProcedureType };
-    struct EnvResult {
-        EnvResultType type;
-        Expression exp;
-        Procedure proc;
+    EnvResult& bind(const Symbol& sym);
+    bool compile(const Expression& exp, Type& type);
+    Atom evaluate(const EnvResult& thunk);
+    // start a new generation
+    void invalidate();
+
+    // Environment is an array of bindings indexed by symbol id
+    std::vector<EnvResult> bindings;
+    // The head of the expression a symbol is bound to, and whether it
+    // is bound to one at all, as None is a value like any other
+    struct Global {
+        Atom value;
+        bool bound;
+
+        Global() : bound(false) {}
+        explicit Global(const Atom& value) : value(value), bound(true) {}
     };
+    // the globals, by symbol id, packed apart from the bindings so that
+    // reading a global touches only its value
+    std::vector<Global> globals;
+    // a deque so that a body stays put while it is running
+    std::deque<Lambda> lambdas;
+    std::uint32_t current;
+    DefineMode defines;
 
-    std::map<Symbol, EnvResult> envmap;
+    // A step of a thunk, which are run in order on a stack: push a
+    // literal, the global value captured at index, or the value of the
+    // thunk symbol index, or call proc on the top index values
+    struct ThunkStep {
+        enum Kind : std::uint32_t { NumberStep, BooleanStep, CapturedStep, ReadStep, CallStep };
+        Kind kind;
+        std::uint32_t index;
+        union {
+            Number number;
+            Procedure proc;
+        };
+    };
+    // the steps of every thunk and the values of globals they read, kept
+    // until no thunk is left to force
+    std::vector<ThunkStep> thunkSteps;
+    std::vector<Atom> thunkValues;
+    std::size_t thunksPending;
+    // the stack and arguments of the thunk being evaluated
+    ArgList thunkStack;
+    ArgList thunkArgs;
 };
 
 #endif
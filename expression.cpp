@@ -5,6 +5,13 @@
 #include <cmath>
 #include <cctype>
 #include <tuple>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef SLISP_COUNT_COPIES
+std::size_t Expression::copies = 0;
+#endif
 
 // Constructor for a Boolean Expression
 Expression::Expression(bool tf) {
@@ -51,6 +58,13 @@ Expression::Expression(std::tuple<double, double> center, std::tuple<double, dou
 }
 
 bool Expression::operator==(const Expression& exp) const noexcept {
+    // a shared list is equal to any copy of it
+    if (head.type == SharedType) {
+        return *head.value.shared_value == exp;
+    }
+    if (exp.head.type == SharedType) {
+        return *this == *exp.head.value.shared_value;
+    }
     // Compare the head
     if (head.type != exp.head.type) {
         return false;
@@ -71,6 +85,14 @@ bool Expression::operator==(const Expression& exp) const noexcept {
         return (head.value.arc_value.center == exp.head.value.arc_value.center &&
             head.value.arc_value.start == exp.head.value.arc_value.start &&
             head.value.arc_value.span == exp.head.value.arc_value.span);
+    case RangeType:
+        return (head.value.range_value.start == exp.head.value.range_value.start &&
+            head.value.range_value.end == exp.head.value.range_value.end &&
+            head.value.range_value.step == exp.head.value.range_value.step);
+    case LambdaType:
+        return head.value.lambda_value == exp.head.value.lambda_value;
+    case SlotType:
+        return head.value.slot_value == exp.head.value.slot_value;
     default:
         return true; // NoneType, should always be equal
     }
@@ -99,6 +121,19 @@ std::ostream& operator<<(std::ostream& out, const Expression& exp) {
             << exp.head.value.arc_value.start.x << "," << exp.head.value.arc_value.start.y << ") "
             << exp.head.value.arc_value.span << ")";
         break;
+    case RangeType:
+        out << "(range " << exp.head.value.range_value.start << " " << exp.head.value.range_value.end << " "
+            << exp.head.value.range_value.step << ")";
+        break;
+    case LambdaType:
+        out << "<lambda " << exp.head.value.lambda_value << ">";
+        break;
+    case SlotType:
+        out << "$" << exp.head.value.slot_value;
+        break;
+    case SharedType:
+        out << *exp.head.value.shared_value;
+        break;
     default:
         out << "None";
     }
@@ -111,12 +146,34 @@ std::ostream& operator<<(std::ostream& out, const Expression& exp) {
     return out;
 }
 
+void write_sexp(std::ostream& out, const Expression& exp) {
+    if (exp.head.type == SharedType) {
+        write_sexp(out, *exp.head.value.shared_value);
+        return;
+    }
+    if (exp.head.type != ListType) {
+        out << exp;
+        return;
+    }
+    out << "(";
+    for (std::size_t i = 0; i < exp.tail.size(); ++i) {
+        if (i > 0) {
+            out << " ";
+        }
+        write_sexp(out, exp.tail[i]);
+    }
+    out << ")";
+}
+
 bool is_valid_number(const std::string& token) {
-    if (token == "+" || token == "-" || token == "*" || token == "/") {
+    return is_valid_number(token.data(), token.size());
+}
+
+bool is_valid_number(const char* token, std::size_t len) {
+    if (len == 1 && (token[0] == '+' || token[0] == '-' || token[0] == '*' || token[0] == '/')) {
         return false;
     }
     // Check if the token is a valid number (integer, floating-point, or scientific notation)
-    size_t len = token.length();
     size_t dot_count = 0;
     bool has_e = false;
 
@@ -126,7 +183,7 @@ bool is_valid_number(const std::string& token) {
         if (i == 0 && (c == '+' || c == '-')) {
             // Skip leading plus or minus sign
         }
-        else if (std::isdigit(c) != 0) {  // Compare result to 0
+        else if (std::isdigit(static_cast<unsigned char>(c)) != 0) {  // Compare result to 0
             // Digit, continue
         }
         else if (c == '.' && dot_count == 0 && !has_e) {
@@ -150,31 +207,64 @@ bool is_valid_number(const std::string& token) {
     return true;
 }
 
+bool parse_number(const char* token, std::size_t len, Number& num) {
+    // strtod needs a terminated string, short tokens are copied to the stack
+    char local[64];
+    std::string heap;
+    const char* text = local;
+    if (len < sizeof(local)) {
+        std::memcpy(local, token, len);
+        local[len] = '\0';
+    }
+    else {
+        heap.assign(token, len);
+        text = heap.c_str();
+    }
+
+    // same acceptance as std::stod: a leading prefix must convert, in range
+    char* end = nullptr;
+    errno = 0;
+    double value = std::strtod(text, &end);
+    if (end == text || errno == ERANGE) {
+        return false;
+    }
+    num = value;
+    return true;
+}
+
 bool is_valid_bool(const std::string& token) {
     return token == "True" || token == "False";
 }
 
+bool is_valid_symbol(const char* token, std::size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    // The symbol starts with an alphabet character or is one of the allowed operators
+    if (std::isalpha(static_cast<unsigned char>(token[0])) != 0) {
+        return true;
+    }
+    if (len == 1) {
+        return token[0] == '+' || token[0] == '-' || token[0] == '*' || token[0] == '/' ||
+            token[0] == '<' || token[0] == '>' || token[0] == '=';
+    }
+    return len == 2 && (token[0] == '>' || token[0] == '<') && token[1] == '=';
+}
+
 bool token_to_atom(const std::string& token, Atom& atom) {
     if (token.empty()) {
         return false;
     }
 
     if (is_valid_number(token)) {
-
-        try {
-            double num = std::stod(token);
-            atom.type = NumberType;
-            atom.value.num_value = num;
-            return true;
-        }
-        catch (const std::invalid_argument& e) {
-            std::cerr << "Error: Invalid argument while parsing number: " << e.what() << std::endl;
-            return false;
-        }
-        catch (const std::out_of_range& e) {
-            std::cerr << "Error: Number out of range: " << e.what() << std::endl;
+        Number num;
+        if (!parse_number(token.data(), token.size(), num)) {
+            std::cerr << "Error: Number out of range: " << token << std::endl;
             return false;
         }
+        atom.type = NumberType;
+        atom.value.num_value = num;
+        return true;
     }
 
     if (is_valid_bool(token)) {
@@ -183,9 +273,7 @@ bool token_to_atom(const std::string& token, Atom& atom) {
         return true;
     }
 
-    if (std::isalpha(token[0]) != 0 || token == "+" || token == "-" || token == "*" || token == "/" || token == "<" || token == ">" ||
-        token == ">=" || token == "<=" || token == "=") {
-        // The symbol starts with an alphabet character or allowed special characters, so it's a valid symbol
+    if (is_valid_symbol(token.data(), token.size())) {
         atom.type = SymbolType;
         atom.value.sym_value = token;
         return true;
@@ -194,3 +282,74 @@ bool token_to_atom(const std::string& token, Atom& atom) {
     return false; // Token is not a valid number, boolean, or symbol
 }
 
+bool is_valid_for(const Expression& exp) {
+    if (exp.tail.size() < 3 || exp.tail[1].head.type != ListType) {
+        return false;
+    }
+    const Expression& range = exp.tail[1];
+    return (range.tail.size() == 3 || range.tail.size() == 4) && range.tail[0].head.type == SymbolType;
+}
+
+bool is_valid_define(const Expression& exp) {
+    return exp.head.type == ListType && exp.tail.size() == 3 && exp.tail[0].head.type == SymbolType &&
+        exp.tail[0].head.value.sym_value.id() == DefineId && exp.tail[1].head.type == SymbolType;
+}
+
+bool is_map(const Expression& exp) {
+    return exp.head.type == ListType && !exp.tail.empty() && exp.tail[0].head.type == SymbolType &&
+        exp.tail[0].head.value.sym_value.id() == MapId;
+}
+
+bool is_valid_map(const Expression& exp) {
+    return exp.tail.size() == 3 && exp.tail[1].head.type == ListType && exp.tail[1].tail.size() == 2 &&
+        exp.tail[1].tail[0].head.type == SymbolType;
+}
+
+bool is_lambda(const Expression& exp) {
+    return exp.head.type == ListType && !exp.tail.empty() && exp.tail[0].head.type == SymbolType &&
+        exp.tail[0].head.value.sym_value.id() == LambdaId;
+}
+
+bool is_valid_let(const Expression& exp) {
+    if (exp.tail.size() < 3 || exp.tail[1].head.type != ListType) {
+        return false;
+    }
+    for (const Expression& binding : exp.tail[1].tail) {
+        if (binding.head.type != ListType || binding.tail.size() != 2 ||
+            (binding.tail[0].head.type != SymbolType && binding.tail[0].head.type != SlotType)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_resolved_let(const Expression& exp) {
+    if (!is_valid_let(exp)) {
+        return false;
+    }
+    for (const Expression& binding : exp.tail[1].tail) {
+        if (binding.tail[0].head.type != SlotType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_valid_cond(const Expression& exp) {
+    if (exp.tail.size() < 2) {
+        return false;
+    }
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        const Expression& clause = exp.tail[i];
+        if (clause.head.type != ListType || clause.tail.size() < 2 ||
+            (is_else_clause(clause) && i + 1 != exp.tail.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_else_clause(const Expression& clause) {
+    static const Symbol ELSE("else");
+    return clause.tail[0].head.type == SymbolType && clause.tail[0].head.value.sym_value == ELSE;
+}
@@ -9,9 +9,16 @@
 #include <cmath>
 #include <limits>
 
-// A Type is a literal boolean, literal number, or symbol
+// module includes
+#include "arena.hpp"
+#include "symbol.hpp"
+
+// A Type tags what an Atom holds: nothing, a boolean, number, symbol,
+// point, line, arc, range, lambda, slot or shared list, or, for
+// ListType, the ListInfo of the list whose head it is
 enum Type {NoneType, BooleanType, NumberType, ListType, SymbolType,
-	   PointType, LineType, ArcType};
+	   PointType, LineType, ArcType, RangeType, LambdaType, SlotType,
+	   SharedType};
 
 // A Boolean is a C++ bool
 typedef bool Boolean;
@@ -19,9 +26,6 @@ typedef bool Boolean;
 // A Number is a C++ double
 typedef double Number;
 
-// A Symbol is a string
-typedef std::string Symbol;
-
 // A Point is two Numbers
 struct Point {
   Number x;
@@ -47,31 +51,163 @@ struct Arc{
   Point start;
   Number span;
 };
+
+// A Range is the lazy sequence of Numbers start + i * step, for
+// i = 0, 1, ..., while before end
+struct Range{
+  Number start;
+  Number end;
+  Number step;
+};
   
-// A Value is a boolean, number, or symbol
-// cannot use a union because symbol is non-POD
-// this wastes space but is simple 
-struct Value {
+struct Atom;
+struct Expression;
+
+// The evaluated arguments of a procedure call,
+// allocated from the current Arena if any
+typedef std::vector<Atom, ArenaAllocator<Atom>> ArgList;
+
+// A Procedure is a C++ function pointer taking
+// a vector of Atoms as arguments and returning
+// the resulting Atom, which is never a list
+typedef Atom (*Procedure)(const ArgList & args);
+
+// What the head of a list records about evaluating the list
+struct ListInfo {
+  // the NumericOp of a list proven to evaluate to a Number,
+  // see typecheck.hpp
+  std::uint32_t numeric_op;
+  // the inline cache of a call: the Environment generation its head
+  // symbol was resolved in, 0 if never, and the builtin it was bound
+  // to, or nullptr for the user procedure lambda. Kept by eval,
+  // which only has const access to the expression. It lasts as long
+  // as the list: a list parsed again, as each REPL line is, starts
+  // cold, unless it is a call of builtins on constants shared by
+  // hash-consing, which is kept across programs
+  mutable std::uint32_t generation;
+  mutable Procedure proc;
+  mutable std::uint32_t lambda;
+  // for a list kept by a HashConser, its structural hash and whether
+  // it reads a global, see hashcons.hpp
+  std::uint32_t hash;
+  bool reads_global;
+};
+
+// A Value is a boolean, number, symbol, point, line, arc, range,
+// lambda, slot or shared list, or the ListInfo of a list
+// only the member selected by the owning Atom's type is meaningful
+union Value {
   Boolean bool_value;
   Number num_value;
   Symbol sym_value;
   Point point_value;
   Line line_value;
   Arc arc_value;
+  Range range_value;
+  // the id of a user procedure in the Environment
+  std::uint32_t lambda_value;
+  // the index of a parameter in the arguments of the current call,
+  // only found in the body of a user procedure
+  std::uint32_t slot_value;
+  // the one copy of a list shared by hash-consing, in place of the list
+  Expression* shared_value;
+  ListInfo list_info;
+
+  Value(): num_value(0) {}
 };
-  
+
 // An Atom has a type and value
 struct Atom{
   Type type;
   Value value;
+
+  Atom(): type(NoneType) {}
 };
 
+// make an Atom holding each kind of value
+inline Atom boolean_atom(Boolean b) {
+  Atom atom;
+  atom.type = BooleanType;
+  atom.value.bool_value = b;
+  return atom;
+}
+
+inline Atom number_atom(Number num) {
+  Atom atom;
+  atom.type = NumberType;
+  atom.value.num_value = num;
+  return atom;
+}
+
+inline Atom point_atom(Number x, Number y) {
+  Atom atom;
+  atom.type = PointType;
+  atom.value.point_value.x = x;
+  atom.value.point_value.y = y;
+  return atom;
+}
+
+inline Atom line_atom(const Point & first, const Point & second) {
+  Atom atom;
+  atom.type = LineType;
+  atom.value.line_value.first = first;
+  atom.value.line_value.second = second;
+  return atom;
+}
+
+inline Atom arc_atom(const Point & center, const Point & start, Number span) {
+  Atom atom;
+  atom.type = ArcType;
+  atom.value.arc_value.center = center;
+  atom.value.arc_value.start = start;
+  atom.value.arc_value.span = span;
+  return atom;
+}
+
+inline Atom range_atom(Number start, Number end, Number step) {
+  Atom atom;
+  atom.type = RangeType;
+  atom.value.range_value.start = start;
+  atom.value.range_value.end = end;
+  atom.value.range_value.step = step;
+  return atom;
+}
+
+inline Atom lambda_atom(std::uint32_t id) {
+  Atom atom;
+  atom.type = LambdaType;
+  atom.value.lambda_value = id;
+  return atom;
+}
+
+inline Atom slot_atom(std::uint32_t index) {
+  Atom atom;
+  atom.type = SlotType;
+  atom.value.slot_value = index;
+  return atom;
+}
+
+inline Atom shared_atom(Expression * list) {
+  Atom atom;
+  atom.type = SharedType;
+  atom.value.shared_value = list;
+  return atom;
+}
+
+// true if atom is a Point, Line or Arc, which draw accepts
+inline bool is_graphic(const Atom & atom) {
+  return atom.type == PointType || atom.type == LineType || atom.type == ArcType;
+}
+
+// A list of expressions, allocated from the current Arena if any
+typedef std::vector<Expression, ArenaAllocator<Expression>> ExpressionList;
+
 // An expression is an atom called the head
 // followed by a (possibly empty) list of expressions
 // called the tail
 struct Expression{
   Atom head;
-  std::vector<Expression> tail;
+  ExpressionList tail;
 
   Expression() {
     head.type = NoneType;
@@ -79,6 +215,21 @@ struct Expression{
   
   Expression(const Atom & atom): head(atom){};
 
+#ifdef SLISP_COUNT_COPIES
+  // copies made so far, counted in benchmark builds only
+  static std::size_t copies;
+
+  Expression(const Expression & exp): head(exp.head), tail(exp.tail) { ++copies; }
+  Expression(Expression && exp) = default;
+  Expression & operator=(const Expression & exp) {
+    head = exp.head;
+    tail = exp.tail;
+    ++copies;
+    return *this;
+  }
+  Expression & operator=(Expression && exp) = default;
+#endif
+
   Expression(bool tf);
   Expression(double num);
   Expression(const std::string & sym);
@@ -101,16 +252,40 @@ struct Expression{
 };
 
 
-// A Procedure is a C++ function pointer taking
-// a vector of Atoms as arguments
-typedef Expression (*Procedure)(const std::vector<Atom> & args);
-
 // format an expression for output
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
+// write exp as an s-expression on one line
+void write_sexp(std::ostream & out, const Expression & exp);
 
 // map a token to an Atom
 bool is_valid_number(const std::string& token);
+bool is_valid_number(const char * token, std::size_t len);
 bool is_valid_bool(const std::string& token);
+bool is_valid_symbol(const char * token, std::size_t len);
 bool token_to_atom(const std::string & token, Atom & atom);
 
+// convert a valid number token with the same rules as std::stod,
+// false if no prefix converts or the value is out of range
+bool parse_number(const char * token, std::size_t len, Number & num);
+
+// true if exp is (define sym value)
+bool is_valid_define(const Expression & exp);
+// true if exp is (for (sym start end [step]) body...)
+bool is_valid_for(const Expression & exp);
+// true if exp is a list headed by map, which may only be an argument
+// of draw, and is_valid_map if it is (map (sym sequence) body)
+bool is_map(const Expression & exp);
+bool is_valid_map(const Expression & exp);
+// true if exp is a list headed by lambda
+bool is_lambda(const Expression & exp);
+// true if exp is (let ((name value)...) body...), where each name is a
+// symbol or the slot it was resolved to, and is_resolved_let if every
+// name is a slot
+bool is_valid_let(const Expression & exp);
+bool is_resolved_let(const Expression & exp);
+// true if exp is (cond (test body...)...), where only the last test
+// may be else, which is_else_clause is true for
+bool is_valid_cond(const Expression & exp);
+bool is_else_clause(const Expression & clause);
+
 #endif
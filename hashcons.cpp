@@ -0,0 +1,155 @@
+#include "hashcons.hpp"
+
+// system includes
+#include <cstring>
+
+HashConser::HashConser(const Environment& env) : env(env) {
+}
+
+const HashConsStats& HashConser::stats() const {
+    return counts;
+}
+
+bool HashConser::share(const Expression& callee, std::size_t position, Expression* children, std::size_t count,
+    Atom& ref) {
+    if (!shared(callee, position) || !shareable(children, count)) {
+        return false;
+    }
+
+    const std::uint32_t key = hash(children, count);
+    auto found = table.equal_range(key);
+    for (auto it = found.first; it != found.second; ++it) {
+        if (same(*it->second, children, count)) {
+            ref = shared_atom(it->second);
+            ++counts.shared;
+            counts.bytesSaved += ARENA_HEADER + count * sizeof(Expression);
+            return true;
+        }
+    }
+
+    // kept for as long as any program refers to it
+    ArenaScope heap(nullptr);
+    lists.push_back(Expression());
+    Expression& list = lists.back();
+    list.head.type = ListType;
+    ListInfo& info = list.head.value.list_info;
+    info.hash = key;
+    info.reads_global = false;
+    list.tail.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const Atom& child = children[i].head;
+        info.reads_global = info.reads_global || (i > 0 && child.type == SymbolType) ||
+            (child.type == SharedType && child.value.shared_value->head.value.list_info.reads_global);
+        list.tail.push_back(std::move(children[i]));
+    }
+    table.emplace(key, &list);
+    ++counts.lists;
+    ref = shared_atom(&list);
+    return true;
+}
+
+// true if element position of a list headed by callee is evaluated
+// wherever it is, and never inspected
+bool HashConser::shared(const Expression& callee, std::size_t position) const {
+    if (callee.head.type != SymbolType || position == 0) {
+        return false;
+    }
+    const Symbol& name = callee.head.value.sym_value;
+    return name.id() == DrawId || (name.id() == DefineId && position == 2) || env.isProc(name);
+}
+
+// true if the list of children is a call of a builtin on literals,
+// globals bound now, which stay bound, and shared lists
+bool HashConser::shareable(const Expression* children, std::size_t count) const {
+    if (children[0].head.type != SymbolType || !env.isProc(children[0].head.value.sym_value)) {
+        return false;
+    }
+    for (std::size_t i = 1; i < count; ++i) {
+        const Atom& child = children[i].head;
+        switch (child.type) {
+        case NumberType:
+        case BooleanType:
+        case SharedType:
+            break;
+        case SymbolType:
+            if (env.global(child.value.sym_value) == nullptr) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// FNV-1a over the children, each a leaf or a shared list whose own
+// hash is cached
+std::uint32_t HashConser::hash(const Expression* children, std::size_t count) {
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Atom& child = children[i].head;
+        unsigned char bytes[1 + sizeof(Number)] = { static_cast<unsigned char>(child.type) };
+        std::size_t size = 1;
+        switch (child.type) {
+        case NumberType:
+            std::memcpy(bytes + 1, &child.value.num_value, sizeof(Number));
+            size += sizeof(Number);
+            break;
+        case BooleanType:
+            bytes[1] = child.value.bool_value ? 1 : 0;
+            size += 1;
+            break;
+        case SymbolType: {
+            const Symbol::Id id = child.value.sym_value.id();
+            std::memcpy(bytes + 1, &id, sizeof(id));
+            size += sizeof(id);
+            break;
+        }
+        default: {
+            const std::uint32_t shared = child.value.shared_value->head.value.list_info.hash;
+            std::memcpy(bytes + 1, &shared, sizeof(shared));
+            size += sizeof(shared);
+            break;
+        }
+        }
+        for (std::size_t j = 0; j < size; ++j) {
+            h = (h ^ bytes[j]) * 16777619u;
+        }
+    }
+    return h;
+}
+
+// true if list has exactly the children given: numbers are compared by
+// their bits, and shared lists by identity, as each is kept once
+bool HashConser::same(const Expression& list, const Expression* children, std::size_t count) {
+    if (list.tail.size() != count) {
+        return false;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        const Atom& a = list.tail[i].head;
+        const Atom& b = children[i].head;
+        if (a.type != b.type) {
+            return false;
+        }
+        bool equal;
+        switch (a.type) {
+        case NumberType:
+            equal = std::memcmp(&a.value.num_value, &b.value.num_value, sizeof(Number)) == 0;
+            break;
+        case BooleanType:
+            equal = a.value.bool_value == b.value.bool_value;
+            break;
+        case SymbolType:
+            equal = a.value.sym_value == b.value.sym_value;
+            break;
+        default:
+            equal = a.value.shared_value == b.value.shared_value;
+            break;
+        }
+        if (!equal) {
+            return false;
+        }
+    }
+    return true;
+}
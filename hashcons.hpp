@@ -0,0 +1,58 @@
+#ifndef HASHCONS_HPP
+#define HASHCONS_HPP
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of what a HashConser shared
+struct HashConsStats {
+    // distinct lists kept, one copy of each
+    std::size_t lists;
+    // lists parsed as a reference to a copy kept before
+    std::size_t shared;
+    // the bytes the tails of those lists would have taken
+    std::size_t bytesSaved;
+
+    HashConsStats() : lists(0), shared(0), bytesSaved(0) {}
+};
+
+// A HashConser lets structurally identical lists share one copy as they
+// are parsed. Only an argument of a call of a builtin or of draw, or the
+// value of a define, that is itself a call of a builtin on literals,
+// globals bound in env and shared lists is shared: it evaluates the
+// same wherever it appears, no special form inspects its structure, and
+// the TypeChecker proves the same of it everywhere. It is parsed as a SharedType atom pointing to the copy
+// kept, whose head caches its structural hash. A pass that rewrites
+// lists in place copies a shared list first where it could rewrite it
+// differently.
+class HashConser {
+public:
+    explicit HashConser(const Environment& env);
+
+    // If the list of the count children, element position of a list
+    // headed by callee, can be shared, set ref to the copy kept of it,
+    // keeping the children if it is the first, and return true
+    bool share(const Expression& callee, std::size_t position, Expression* children, std::size_t count, Atom& ref);
+
+    const HashConsStats& stats() const;
+
+private:
+    bool shared(const Expression& callee, std::size_t position) const;
+    bool shareable(const Expression* children, std::size_t count) const;
+    static std::uint32_t hash(const Expression* children, std::size_t count);
+    static bool same(const Expression& list, const Expression* children, std::size_t count);
+
+    const Environment& env;
+    // the copies kept, on the heap, which never move
+    std::deque<Expression> lists;
+    std::unordered_multimap<std::uint32_t, Expression*> table;
+    HashConsStats counts;
+};
+
+#endif
@@ -8,7 +8,9 @@
 #include "interpreter_semantic_error.hpp"
 
 
-Interpreter::Interpreter() {
+Interpreter::Interpreter() : arenaEnabled(true), mode(TreeEval), optimizeEnabled(false), astDump(nullptr),
+    deadCodeEnabled(false), cseEnabled(false), typeCheckEnabled(false), typeErrorReport(nullptr), hashCons(env), hashConsEnabled(false), resultCache(0),
+    maxNesting(DEFAULT_MAX_NESTING), reactiveEnabled(false), reactive(env) {
     env.init();
 }
 
@@ -22,48 +24,213 @@ Expression Interpreter::atom(const std::string& token) {
         return Expression(atom);
     }
 
+    if (is_valid_number(token)) {
+        throw InterpreterSemanticError("Error: Number out of range: " + token);
+    }
     throw InterpreterSemanticError("Error: Invalid token:" + token);
 }
 
-Expression Interpreter::read_from_tokens(TokenSequenceType& tokens) {
-    if (tokens.empty()) {
-        throw InterpreterSemanticError("Error: Unexpected end of input.");
+namespace {
+
+const char* const NESTING_ERROR = "Error: Lists nested too deeply.";
+
+// The state of the iterative reader, the children read so far of every
+// open list and where the children of each open list start. Each tail
+// is allocated once at its final size instead of growing (and leaving
+// garbage in an arena). After an error it must be discarded.
+struct ParseStack {
+    std::vector<Expression> children;
+    std::vector<std::size_t> open;
+    // the most lists a form may be nested in
+    std::size_t maxDepth;
+    // shares the arguments of calls of builtins, if not nullptr
+    HashConser* hashCons;
+
+    ParseStack(std::size_t maxDepth, HashConser* hashCons) : maxDepth(maxDepth), hashCons(hashCons) {
+        children.reserve(64);
+        open.reserve(64);
     }
+};
 
-    std::string token(tokens.front());
-    tokens.pop_front();
+// Presents a sequence of token strings as lexed Tokens
+class TokenSequenceReader {
+public:
+    explicit TokenSequenceReader(TokenSequenceType& tokens) : tokens(tokens) { classify(); }
 
-    if (token == "(") {
-        Expression exp;
-        exp.head.type = ListType;
+    bool empty() const { return tokens.empty(); }
+    const Token& front() const { return current; }
+    void pop_front() {
+        tokens.pop_front();
+        classify();
+    }
+
+    const char* text(const Token&) const { return tokens.front().data(); }
+
+private:
+    void classify();
+
+    TokenSequenceType& tokens;
+    Token current;
+};
+
+void TokenSequenceReader::classify() {
+    if (tokens.empty()) {
+        return;
+    }
+    const std::string& text = tokens.front();
+    current.offset = 0;
+    current.length = static_cast<std::uint32_t>(text.size());
+
+    Atom atom;
+    if (text == "(") {
+        current.kind = OpenToken;
+    }
+    else if (text == ")") {
+        current.kind = CloseToken;
+    }
+    else if (!token_to_atom(text, atom)) {
+        current.kind = InvalidToken;
+    }
+    else if (atom.type == NumberType) {
+        current.kind = NumberToken;
+        current.number = atom.value.num_value;
+    }
+    else if (atom.type == BooleanType) {
+        current.kind = BooleanToken;
+        current.boolean = atom.value.bool_value;
+    }
+    else {
+        current.kind = SymbolToken;
+    }
+}
 
-        while (!tokens.empty() && tokens.front() != ")") {
-            exp.tail.push_back(read_from_tokens(tokens));
+// Read one form, or with opened the rest of a list whose opening
+// parenthesis was consumed, inside outer lists that are already open.
+// Lists are kept on stack rather than the native stack, so any nesting
+// up to stack.maxDepth can be read. Token text is only used before the
+// token is popped, as a StreamLexer may reuse its buffer afterwards.
+template <typename Tokens>
+Expression read_forms(Tokens& tokens, ParseStack& stack, std::size_t outer, bool opened) {
+    const std::size_t bottom = stack.open.size();
+    if (opened) {
+        if (outer + 1 > stack.maxDepth) {
+            throw InterpreterSemanticError(NESTING_ERROR);
         }
+        stack.open.push_back(stack.children.size());
+    }
 
-        if (tokens.empty() || tokens.front() != ")") {
-            throw InterpreterSemanticError("Error: Unmatched parentheses.");
+    while (true) {
+        if (tokens.empty()) {
+            throw InterpreterSemanticError(stack.open.size() == bottom ?
+                "Error: Unexpected end of input." : "Error: Unmatched parentheses.");
         }
 
-        tokens.pop_front(); // Pop the closing parenthesis
+        const Token& token = tokens.front();
+        Expression exp;
 
-        if (exp.tail.empty()) {
-            throw InterpreterSemanticError("Error: Empty list.");
+        switch (token.kind) {
+        case OpenToken:
+            if (outer + stack.open.size() - bottom + 1 > stack.maxDepth) {
+                throw InterpreterSemanticError(NESTING_ERROR);
+            }
+            tokens.pop_front();
+            stack.open.push_back(stack.children.size());
+            continue;
+        case CloseToken: {
+            if (stack.open.size() == bottom) {
+                throw InterpreterSemanticError("Error: Empty parentheses.");
+            }
+            tokens.pop_front(); // Pop the closing parenthesis
+
+            std::size_t base = stack.open.back();
+            stack.open.pop_back();
+            if (stack.children.size() == base) {
+                throw InterpreterSemanticError("Error: Empty list.");
+            }
+            // an argument is shared before a tail is allocated for it
+            if (stack.hashCons != nullptr && !stack.open.empty() && base > stack.open.back() &&
+                stack.hashCons->share(stack.children[stack.open.back()], base - stack.open.back(),
+                    &stack.children[base], stack.children.size() - base, exp.head)) {
+                stack.children.resize(base);
+                break;
+            }
+            exp.head.type = ListType;
+            exp.tail.reserve(stack.children.size() - base);
+            for (std::size_t i = base; i < stack.children.size(); ++i) {
+                exp.tail.push_back(std::move(stack.children[i]));
+            }
+            stack.children.resize(base);
+            break;
+        }
+        case NumberToken:
+            exp = Expression(token.number);
+            tokens.pop_front();
+            break;
+        case BooleanToken:
+            exp = Expression(token.boolean);
+            tokens.pop_front();
+            break;
+        case SymbolToken:
+            exp.head.type = SymbolType;
+            exp.head.value.sym_value = Symbol(tokens.text(token), token.length);
+            tokens.pop_front();
+            break;
+        default:
+            // a token shaped like a number only fails to convert if it is out of range
+            if (is_valid_number(tokens.text(token), token.length)) {
+                throw InterpreterSemanticError("Error: Number out of range: " +
+                    std::string(tokens.text(token), token.length));
+            }
+            throw InterpreterSemanticError("Error: Invalid token:" + std::string(tokens.text(token), token.length));
         }
 
-        return exp;
+        if (stack.open.size() == bottom) {
+            return exp;
+        }
+        stack.children.push_back(std::move(exp));
     }
+}
 
-    if (token == ")") {
-        throw InterpreterSemanticError("Error: Empty parentheses.");
-    }
+// Read one form inside outer open lists
+template <typename Tokens>
+Expression read_form(Tokens& tokens, ParseStack& stack, std::size_t outer = 0) {
+    return read_forms(tokens, stack, outer, false);
+}
 
-    return atom(token);
+// Read the rest of a list whose opening parenthesis was consumed
+template <typename Tokens>
+Expression read_list(Tokens& tokens, ParseStack& stack, std::size_t outer = 0) {
+    return read_forms(tokens, stack, outer, true);
+}
+
+// the test of a cond clause, where else is always taken
+const Expression& cond_test(const Expression& clause) {
+    static const Expression ALWAYS(true);
+    return is_else_clause(clause) ? ALWAYS : clause.tail[0];
+}
+
+} // namespace
+
+Expression Interpreter::read_from_tokens(TokenSequenceType& tokens) {
+    TokenSequenceReader reader(tokens);
+    ParseStack stack(maxNesting, hashConsEnabled ? &hashCons : nullptr);
+    return read_form(reader, stack);
+}
+
+Expression Interpreter::read_from_tokens(TokenStream& tokens) {
+    ParseStack stack(maxNesting, hashConsEnabled ? &hashCons : nullptr);
+    return read_form(tokens, stack);
+}
+
+Expression Interpreter::read_from_tokens(StreamLexer& tokens) {
+    ParseStack stack(maxNesting, hashConsEnabled ? &hashCons : nullptr);
+    return read_form(tokens, stack);
 }
 
 bool Interpreter::parse(std::istream& expression) noexcept {
-    // Tokenize the program string and build the expression
-    TokenSequenceType tokens = tokenize(expression);
+    // Read the program into one buffer and lex it in place
+    std::string source = read_source(expression);
+    TokenStream tokens(source);
 
     // Check if the tokens are empty or the first token is not '('
     if (tokens.empty()) {
@@ -71,6 +238,12 @@ bool Interpreter::parse(std::istream& expression) noexcept {
         return false; // Parsing failed
     }
 
+    // Release the previous program, then build the new one in the arena
+    ast = Expression();
+    eliminated = Expression();
+    arena.reset();
+    ArenaScope scope(arenaEnabled ? &arena : nullptr);
+
     try {
         ast = read_from_tokens(tokens);
     }
@@ -96,135 +269,906 @@ bool Interpreter::parse(std::istream& expression) noexcept {
 }
 
 Expression Interpreter::eval(const Expression& exp) {
-    if (exp.head.type == ListType) {
+    return Expression(evalValue(exp, frame_size(exp)));
+}
+
+Atom Interpreter::evalValue(const Expression& exp, std::size_t frame) {
+    try {
+        return evalWithFrames(exp, frame);
+    }
+    catch (...) {
+        // release the index symbols of the loops that were running
+        for (const EvalFrame& frame : evalFrames) {
+            if (frame.form == EvalFrame::Loop && frame.exp->tail[0].head.value.sym_value.id() != RepeatId) {
+                env.removeExp(frame.exp->tail[1].tail[0].head.value.sym_value);
+            }
+        }
+        throw;
+    }
+}
+
+// Every value is an Atom, so evaluation passes Atoms and never copies
+// an Expression. Subexpressions and bindings are only read in place.
+// Forms waiting on a subexpression are kept on evalFrames and call
+// arguments and loop ranges on evalValues, so nesting costs no native
+// stack and loops no memory per iteration. The last form of a begin
+// and the branches of an if are evaluated in place of the form itself,
+// without a frame. A call of a user procedure keeps its arguments and
+// the locals of its lets on evalValues, where the slots of its body
+// index them from frameBase, as the slots of root index its locals.
+Atom Interpreter::evalWithFrames(const Expression& root, std::size_t frame) {
+    evalFrames.clear();
+    evalValues.assign(frame, Atom());
+
+    const Expression* exp = &root;
+    Atom result;
+    // the user procedure to apply to the rest of *exp
+    Atom callee;
+    std::size_t frameBase = 0;
+    const Expression* clause;
+
+eval:
+    // evaluate *exp into result, or push a frame and evaluate a part of it
+    if (exp->head.type == ListType) {
         // Handle a list as a special form or procedure call
-        if (exp.tail.empty()) {
+        if (exp->tail.empty()) {
             // Empty list, no further evaluation needed
-            return exp;
+            result = exp->head;
+            goto done;
+        }
+        if (exp->head.value.list_info.numeric_op != NotNumeric) {
+            // proven to be a Number by the TypeChecker
+            result = number_atom(eval_numeric(*exp, env, evalValues.data() + frameBase));
+            goto done;
         }
 
-        Expression firstExp = exp.tail[0];
+        const Expression& firstExp = exp->tail[0];
 
         if (firstExp.head.type == SymbolType) {
             const Symbol& symbolName = firstExp.head.value.sym_value;
 
-            if (symbolName == "define") {
+            switch (symbolName.id()) {
+            case DefineId:
                 // Handle the 'define' special form
-                if (exp.tail.size() != 3 || exp.tail[1].head.type != SymbolType) {
+                if (exp->tail.size() != 3 || exp->tail[1].head.type != SymbolType) {
                     throw InterpreterSemanticError("Error: Invalid 'define' syntax.");
                 }
-                const Symbol& definedSymbol = exp.tail[1].head.value.sym_value;
-                Expression definedValue = eval(exp.tail[2]);
-                if (!env.isKnown(definedSymbol) && definedSymbol != "if" && definedSymbol != "define" && definedSymbol != "begin") {
-                    env.addExp(definedSymbol, definedValue);
-                    return definedValue;
+                if (env.defineMode() != Environment::EagerDefine && !evalFrames.empty() &&
+                    evalFrames.back().form == EvalFrame::Begin &&
+                    &evalFrames.back().exp->tail[evalFrames.back().next - 1] == exp &&
+                    env.defer(exp->tail[1].head.value.sym_value, exp->tail[2])) {
+                    // a form of a body before the last, whose value is unused
+                    result = Atom();
+                    goto done;
                 }
-                throw InterpreterSemanticError("Error: Invalid define Symbol.");
-            }
-            else if (symbolName == "begin") {
+                evalFrames.push_back(EvalFrame(EvalFrame::Define, exp, 3));
+                exp = &exp->tail[2];
+                goto eval;
+            case BeginId:
                 // Handle the 'begin' special form
-                Expression result;
-                for (size_t i = 1; i < exp.tail.size(); ++i) {
-                    result = eval(exp.tail[i]);
+                if (exp->tail.size() == 1) {
+                    result = Atom();
+                    goto done;
                 }
-                return result;
-            }
-            else if (symbolName == "if") {
+                if (exp->tail.size() > 2) {
+                    evalFrames.push_back(EvalFrame(EvalFrame::Begin, exp, 2));
+                }
+                exp = &exp->tail[1];
+                goto eval;
+            case IfId:
                 // Handle the 'if' special form
-                if (exp.tail.size() != 4) {
+                if (exp->tail.size() != 4) {
                     throw InterpreterSemanticError("Error: Invalid 'if' syntax.");
                 }
-                Expression condition = eval(exp.tail[1]);
-                if (condition.head.type != BooleanType) {
-                    throw InterpreterSemanticError("Error: 'if' condition must evaluate to a Boolean.");
-                }
-                return eval(condition.head.value.bool_value ? exp.tail[2] : exp.tail[3]);
-            }
-            else if (symbolName == "draw") {
+                evalFrames.push_back(EvalFrame(EvalFrame::If, exp, 2));
+                exp = &exp->tail[1];
+                goto eval;
+            case DrawId:
                 // Handle the 'draw' special form
-                if (exp.tail.size() < 2) {
+                if (exp->tail.size() < 2) {
                     throw InterpreterSemanticError("Error: Invalid 'draw' syntax.");
                 }
-                for (size_t i = 1; i < exp.tail.size(); ++i) {
-                    Expression graphic = eval(exp.tail[i]);
-                    if (graphic.head.type == PointType || graphic.head.type == LineType || graphic.head.type == ArcType) {
-                        graphics.push_back(graphic.head);
-                    }
-                    else {
-                        throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
-                    }
+                evalFrames.push_back(EvalFrame(EvalFrame::Draw, exp, 2));
+                exp = &exp->tail[1];
+                goto eval;
+            case ForId:
+                // Handle the 'for' special form
+                if (!is_valid_for(*exp)) {
+                    throw InterpreterSemanticError("Error: Invalid 'for' syntax.");
                 }
-                return Expression(); // Return an empty expression
-            }
-            else {
-                if (env.isKnown(symbolName)) {
-                    // Symbol represents a procedure call
-                    if (env.isProc(symbolName)) {
-                        const Procedure& proc = env.getProc(symbolName);
-                        std::vector<Atom> args;
-
-                        // Evaluate the remaining expressions in the list as arguments
-                        for (size_t i = 1; i < exp.tail.size(); ++i) {
-                            Expression argExp = eval(exp.tail[i]);
-                            args.push_back(argExp.head);
-                        }
-
-                        // Call the procedure with the evaluated arguments
-                        return proc(args);
+                evalFrames.push_back(EvalFrame(EvalFrame::LoopRange, exp, 2));
+                evalFrames.back().base = evalValues.size();
+                exp = &exp->tail[1].tail[1];
+                goto eval;
+            case RepeatId:
+                // Handle the 'repeat' special form
+                if (exp->tail.size() < 3) {
+                    throw InterpreterSemanticError("Error: Invalid 'repeat' syntax.");
+                }
+                evalFrames.push_back(EvalFrame(EvalFrame::LoopRange, exp, 2));
+                evalFrames.back().base = evalValues.size();
+                exp = &exp->tail[1];
+                goto eval;
+            case MapId:
+                // Handle the 'map' generator, which only draw consumes
+                if (evalFrames.empty() || evalFrames.back().form != EvalFrame::Draw ||
+                    &evalFrames.back().exp->tail[evalFrames.back().next - 1] != exp) {
+                    throw InterpreterSemanticError("Error: 'map' is only valid as an argument of 'draw'.");
+                }
+                if (!is_valid_map(*exp)) {
+                    throw InterpreterSemanticError("Error: Invalid 'map' syntax.");
+                }
+                evalFrames.push_back(EvalFrame(EvalFrame::LoopRange, exp, 2));
+                evalFrames.back().base = evalValues.size();
+                exp = &exp->tail[1].tail[1];
+                goto eval;
+            case LambdaId:
+                // Handle the 'lambda' special form
+                result = env.addLambda(*exp, evalValues.data() + frameBase);
+                goto done;
+            case AndId:
+            case OrId:
+                // Handle the 'and' and 'or' special forms
+                if (exp->tail.size() < 2) {
+                    throw InterpreterSemanticError(symbolName.id() == AndId ? "Error: Invalid 'and' syntax." :
+                        "Error: Invalid 'or' syntax.");
+                }
+                evalFrames.push_back(EvalFrame(EvalFrame::Logic, exp, 2));
+                exp = &exp->tail[1];
+                goto eval;
+            case LetId:
+                // Handle the 'let' special form, resolved to slots
+                if (!is_valid_let(*exp)) {
+                    throw InterpreterSemanticError("Error: Invalid 'let' syntax.");
+                }
+                if (!is_resolved_let(*exp)) {
+                    throw InterpreterSemanticError("Error: Invalid 'let' Symbol.");
+                }
+                evalFrames.push_back(EvalFrame(EvalFrame::Let, exp, 1));
+                evalFrames.back().base = evalValues.size();
+                exp = &exp->tail[1].tail[0].tail[1];
+                goto eval;
+            case CondId:
+                // Handle the 'cond' special form
+                if (!is_valid_cond(*exp)) {
+                    throw InterpreterSemanticError("Error: Invalid 'cond' syntax.");
+                }
+                evalFrames.push_back(EvalFrame(EvalFrame::Cond, exp, 1));
+                exp = &cond_test(exp->tail[1]);
+                goto eval;
+            default: {
+                // the procedure the head was bound to when last evaluated,
+                // which stays bound to it for the generation
+                const ListInfo& cache = exp->head.value.list_info;
+                if (cache.generation == env.generation()) {
+                    ++callCacheStats.hits;
+                }
+                else {
+                    ++callCacheStats.misses;
+                    const Environment::EnvResult* binding = env.lookup(symbolName);
+                    if (binding == nullptr) {
+                        throw InterpreterSemanticError("Error: Unknown symbol: " + symbolName.name());
                     }
-                    else if (env.isExp(symbolName)) {
+                    if (binding->type == Environment::ThunkType) {
+                        result = *env.force(symbolName);
+                        goto done;
+                    }
+                    if (binding->type != Environment::ProcedureType && binding->exp.head.type != LambdaType) {
                         // Symbol represents a user-defined expression or "pi"
-                        return env.getExp(symbolName);
+                        result = binding->exp.head;
+                        goto done;
                     }
+                    cache.generation = env.generation();
+                    cache.proc = binding->type == Environment::ProcedureType ? binding->proc : nullptr;
+                    cache.lambda = cache.proc == nullptr ? binding->exp.head.value.lambda_value : 0;
+                }
+                if (cache.proc == nullptr) {
+                    callee = lambda_atom(cache.lambda);
+                    goto apply;
                 }
-                throw InterpreterSemanticError("Error: Unknown symbol: " + symbolName);
+                // Symbol represents a procedure call
+                if (exp->tail.size() == 1) {
+                    result = cache.proc(ArgList());
+                    goto done;
+                }
+                // Evaluate the remaining expressions in the list as arguments
+                evalFrames.push_back(EvalFrame(EvalFrame::Call, exp, 2));
+                evalFrames.back().proc = cache.proc;
+                evalFrames.back().base = evalValues.size();
+                exp = &exp->tail[1];
+                goto eval;
+            }
             }
         }
         if (firstExp.head.type == BooleanType || firstExp.head.type == NumberType) {
-            return firstExp;
+            result = firstExp.head;
+            goto done;
         }
-        else {
-            throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form: " + exp.tail[0].head.value.sym_value);
+        if (firstExp.head.type == SlotType || firstExp.head.type == LambdaType) {
+            callee = firstExp.head.type == SlotType ? evalValues[frameBase + firstExp.head.value.slot_value] :
+                firstExp.head;
+            if (callee.type == LambdaType) {
+                goto apply;
+            }
+            // like a defined symbol, a parameter ignores the rest of the list
+            result = callee;
+            goto done;
         }
+        if (firstExp.head.type == ListType) {
+            // the head may evaluate to a user procedure
+            evalFrames.push_back(EvalFrame(EvalFrame::Callee, exp, 1));
+            exp = &firstExp;
+            goto eval;
+        }
+        throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form.");
     }
-    else if (exp.head.type == SymbolType || exp.head.type == PointType || exp.head.type == ArcType || exp.head.type == LineType) {
-        // Handle symbols, graphics
-        const Symbol& symbolName = exp.head.value.sym_value;
+    else if (exp->head.type == SymbolType) {
+        // Handle symbols
+        const Symbol& symbolName = exp->head.value.sym_value;
 
-        if (env.isKnown(symbolName)) {
+        const Atom* value = env.value(symbolName);
+        if (value != nullptr) {
+            // Symbol represents a user-defined expression or "pi"
+            result = *value;
+            goto done;
+        }
+        const Environment::EnvResult* binding = env.lookup(symbolName);
+        if (binding != nullptr && binding->type == Environment::ProcedureType) {
             // Symbol represents a procedure call
-            if (env.isProc(symbolName)) {
-                const Procedure& proc = env.getProc(symbolName);
-                std::vector<Atom> args;
-
-                // Evaluate the remaining expressions in the list as arguments
-                for (size_t i = 0; i < exp.tail.size(); ++i) {
-                    Expression argExp = eval(exp.tail[i]);
-                    args.push_back(argExp.head);
-                }
-
-                // Call the procedure with the evaluated arguments
-                return proc(args);
+            if (exp->tail.empty()) {
+                result = binding->proc(ArgList());
+                goto done;
             }
-            else if (env.isExp(symbolName)) {
-                // Symbol represents a user-defined expression or "pi"
-                return env.getExp(symbolName);
+            evalFrames.push_back(EvalFrame(EvalFrame::Call, exp, 1));
+            evalFrames.back().proc = binding->proc;
+            evalFrames.back().base = evalValues.size();
+            exp = &exp->tail[0];
+            goto eval;
+        }
+        throw InterpreterSemanticError("Error: Unknown type: " + symbolName.name());
+    }
+    else if (exp->head.type == BooleanType || exp->head.type == NumberType ||
+        exp->head.type == PointType || exp->head.type == LineType || exp->head.type == ArcType ||
+        exp->head.type == RangeType || exp->head.type == LambdaType) {
+        // Literals and graphics evaluate to themselves
+        result = exp->head;
+        goto done;
+    }
+    else if (exp->head.type == SlotType) {
+        // a parameter of the user procedure being run
+        result = evalValues[frameBase + exp->head.value.slot_value];
+        goto done;
+    }
+    else if (exp->head.type == SharedType) {
+        exp = exp->head.value.shared_value;
+        if (resultCache.capacity() > 0) {
+            if (resultCache.find(exp, env.generation(), result)) {
+                goto done;
             }
+            evalFrames.push_back(EvalFrame(EvalFrame::Remember, exp, 0));
         }
-        throw InterpreterSemanticError("Error: Unknown type: " + symbolName);
+        goto eval;
     }
-    else if (exp.head.type == BooleanType || exp.head.type == NumberType) {
-        return exp;
+    else {
+        throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form.");
+    }
+
+apply:
+    // evaluate the arguments of a call of callee, every one of which
+    // has at least one parameter
+    if (exp->tail.size() == 1) {
+        throw InterpreterSemanticError("Error: Wrong number of arguments for lambda.");
+    }
+    evalFrames.push_back(EvalFrame(EvalFrame::Apply, exp, 2));
+    evalFrames.back().lambda = callee.value.lambda_value;
+    evalFrames.back().base = evalValues.size();
+    exp = &exp->tail[1];
+    goto eval;
+
+take:
+    // evaluate the body of clause, taken by the cond of the top frame
+    if (clause->tail.size() > 2) {
+        EvalFrame& frame = evalFrames.back();
+        frame.form = EvalFrame::Begin;
+        frame.exp = clause;
+        frame.next = 2;
     }
     else {
-        throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form: " + exp.tail[0].head.value.sym_value);
+        // the only form is in tail position
+        evalFrames.pop_back();
+    }
+    exp = &clause->tail[1];
+    goto eval;
+
+done:
+    // result is the value of the part the innermost frame was waiting on
+    while (!evalFrames.empty()) {
+        EvalFrame& frame = evalFrames.back();
+        const std::size_t size = frame.exp->tail.size();
+
+        switch (frame.form) {
+        case EvalFrame::Define: {
+            const Symbol& definedSymbol = frame.exp->tail[1].head.value.sym_value;
+            if (env.isKnown(definedSymbol) || is_special_form(definedSymbol)) {
+                throw InterpreterSemanticError("Error: Invalid define Symbol.");
+            }
+            env.addExp(definedSymbol, Expression(result));
+            evalFrames.pop_back();
+            continue;
+        }
+        case EvalFrame::Begin:
+            exp = &frame.exp->tail[frame.next++];
+            if (frame.next == size) {
+                // the last form is in tail position
+                evalFrames.pop_back();
+            }
+            goto eval;
+        case EvalFrame::If: {
+            if (result.type != BooleanType) {
+                throw InterpreterSemanticError("Error: 'if' condition must evaluate to a Boolean.");
+            }
+            // either branch is in tail position
+            exp = &frame.exp->tail[result.value.bool_value ? 2 : 3];
+            evalFrames.pop_back();
+            goto eval;
+        }
+        case EvalFrame::Draw:
+            if (!is_graphic(result)) {
+                throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
+            }
+            graphics.push_back(result);
+            if (frame.next < size) {
+                exp = &frame.exp->tail[frame.next++];
+                goto eval;
+            }
+            result = Atom(); // Return an empty expression
+            evalFrames.pop_back();
+            continue;
+        case EvalFrame::Call: {
+            evalValues.push_back(result);
+            if (frame.next < size) {
+                exp = &frame.exp->tail[frame.next++];
+                goto eval;
+            }
+            // Call the procedure with the evaluated arguments, which
+            // never outlive the call
+            ArenaRegion region;
+            ArgList args(evalValues.begin() + frame.base, evalValues.end());
+            Procedure proc = frame.proc;
+            evalValues.resize(frame.base);
+            evalFrames.pop_back();
+            result = proc(args);
+            continue;
+        }
+        case EvalFrame::Callee:
+            if (result.type != LambdaType) {
+                throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form.");
+            }
+            callee = result;
+            exp = frame.exp;
+            evalFrames.pop_back();
+            goto apply;
+        case EvalFrame::Apply: {
+            evalValues.push_back(result);
+            if (frame.next < size) {
+                exp = &frame.exp->tail[frame.next++];
+                goto eval;
+            }
+            const Lambda& lambda = env.getLambda(frame.lambda);
+            if (size - 1 != lambda.arity) {
+                throw InterpreterSemanticError("Error: Wrong number of arguments for lambda.");
+            }
+            // run the body on the arguments and its locals, returning to
+            // the caller's frame
+            evalValues.resize(frame.base + lambda.frameSize);
+            frame.form = EvalFrame::Return;
+            frame.next = frameBase;
+            frameBase = frame.base;
+            exp = &lambda.body;
+            goto eval;
+        }
+        case EvalFrame::Return:
+            evalValues.resize(frame.base);
+            frameBase = frame.next;
+            evalFrames.pop_back();
+            continue;
+        case EvalFrame::Remember:
+            resultCache.insert(frame.exp, env.generation(), result);
+            evalFrames.pop_back();
+            continue;
+        case EvalFrame::Logic: {
+            const bool isAnd = frame.exp->tail[0].head.value.sym_value.id() == AndId;
+            if (result.type != BooleanType) {
+                throw InterpreterSemanticError(isAnd ? "Error: 'and' arguments must evaluate to Booleans." :
+                    "Error: 'or' arguments must evaluate to Booleans.");
+            }
+            // the rest is not evaluated once the value is known
+            if (result.value.bool_value != isAnd || frame.next == size) {
+                evalFrames.pop_back();
+                continue;
+            }
+            exp = &frame.exp->tail[frame.next++];
+            goto eval;
+        }
+        case EvalFrame::Let: {
+            evalValues.push_back(result);
+            const Expression& bindings = frame.exp->tail[1];
+            if (frame.next < bindings.tail.size()) {
+                exp = &bindings.tail[frame.next++].tail[1];
+                goto eval;
+            }
+            // every value is evaluated before any local is set
+            for (std::size_t i = 0; i < bindings.tail.size(); ++i) {
+                evalValues[frameBase + bindings.tail[i].tail[0].head.value.slot_value] = evalValues[frame.base + i];
+            }
+            evalValues.resize(frame.base);
+            exp = &frame.exp->tail[2];
+            if (size > 3) {
+                frame.form = EvalFrame::Begin;
+                frame.next = 3;
+            }
+            else {
+                evalFrames.pop_back();
+            }
+            goto eval;
+        }
+        case EvalFrame::Cond:
+            if (result.type != BooleanType) {
+                throw InterpreterSemanticError("Error: 'cond' test must evaluate to a Boolean.");
+            }
+            if (result.value.bool_value) {
+                clause = &frame.exp->tail[frame.next];
+                goto take;
+            }
+            if (++frame.next == size) {
+                // no clause was taken
+                result = Atom();
+                evalFrames.pop_back();
+                continue;
+            }
+            exp = &cond_test(frame.exp->tail[frame.next]);
+            goto eval;
+        case EvalFrame::LoopRange: {
+            // collect start, end and step on evalValues
+            evalValues.push_back(result);
+            const Expression& form = *frame.exp;
+            const Symbol::Id id = form.tail[0].head.value.sym_value.id();
+            if (id == ForId && frame.next < form.tail[1].tail.size()) {
+                exp = &form.tail[1].tail[frame.next++];
+                goto eval;
+            }
+            if (id == ForId) {
+                if (form.tail[1].tail.size() == 3) {
+                    evalValues.push_back(number_atom(1));
+                }
+                const Atom* range = &evalValues[frame.base];
+                if (range[0].type != NumberType || range[1].type != NumberType || range[2].type != NumberType) {
+                    throw InterpreterSemanticError("Error: 'for' range must evaluate to Numbers.");
+                }
+                if (range[2].value.num_value == 0) {
+                    throw InterpreterSemanticError("Error: 'for' step must not be zero.");
+                }
+                const Symbol& index = form.tail[1].tail[0].head.value.sym_value;
+                if (env.isKnown(index) || is_special_form(index)) {
+                    throw InterpreterSemanticError("Error: Invalid 'for' Symbol.");
+                }
+                env.addExp(index, Expression(range[0]));
+            }
+            else if (id == MapId) {
+                if (result.type != RangeType) {
+                    throw InterpreterSemanticError("Error: 'map' sequence must evaluate to a Range.");
+                }
+                const Symbol& index = form.tail[1].tail[0].head.value.sym_value;
+                if (env.isKnown(index) || is_special_form(index)) {
+                    throw InterpreterSemanticError("Error: Invalid 'map' Symbol.");
+                }
+                const Range sequence = result.value.range_value;
+                evalValues.back() = number_atom(sequence.start);
+                evalValues.push_back(number_atom(sequence.end));
+                evalValues.push_back(number_atom(sequence.step));
+                env.addExp(index, Expression(sequence.start));
+            }
+            else {
+                if (result.type != NumberType) {
+                    throw InterpreterSemanticError("Error: 'repeat' count must evaluate to a Number.");
+                }
+                // the same as a for from 0 to count
+                evalValues.back() = number_atom(0);
+                evalValues.push_back(result);
+                evalValues.push_back(number_atom(1));
+            }
+            // a loop that never runs its body has no value
+            result = Atom();
+            frame.form = EvalFrame::Loop;
+            frame.next = size;
+        }
+        // fall through
+        case EvalFrame::Loop: {
+            if (frame.next < size) {
+                exp = &frame.exp->tail[frame.next++];
+                goto eval;
+            }
+            // start the next iteration, if any, with the index at
+            // start + iteration * step
+            const Symbol::Id id = frame.exp->tail[0].head.value.sym_value.id();
+            if (id == MapId && frame.iteration > 0) {
+                // each element goes straight to the graphics
+                if (!is_graphic(result)) {
+                    throw InterpreterSemanticError("Error: Invalid(non-graphic) atoms after 'draw'.");
+                }
+                graphics.push_back(result);
+            }
+            const Atom* range = &evalValues[frame.base];
+            const Number step = range[2].value.num_value;
+            const Number index = range[0].value.num_value + frame.iteration * step;
+            if (step > 0 ? index < range[1].value.num_value : index > range[1].value.num_value) {
+                if (id != RepeatId) {
+                    env.setExp(frame.exp->tail[1].tail[0].head.value.sym_value, Expression(index));
+                }
+                frame.iteration += 1;
+                frame.next = 3;
+                exp = &frame.exp->tail[2];
+                goto eval;
+            }
+            if (id != RepeatId) {
+                env.removeExp(frame.exp->tail[1].tail[0].head.value.sym_value);
+            }
+            evalValues.resize(frame.base);
+            evalFrames.pop_back();
+            if (id == MapId) {
+                // continue the draw the map is an argument of
+                EvalFrame& draw = evalFrames.back();
+                if (draw.next < draw.exp->tail.size()) {
+                    exp = &draw.exp->tail[draw.next++];
+                    goto eval;
+                }
+                result = Atom(); // Return an empty expression
+                evalFrames.pop_back();
+            }
+            continue;
+        }
+        }
     }
+    return result;
 }
 
 Expression Interpreter::eval() {
     // Ensure that the AST is not empty.
     if (ast.head.type != NoneType) {
-        return eval(ast);
+        ArenaScope scope(arenaEnabled ? &arena : nullptr);
+        if (!reactiveEnabled) {
+            return evalForm(ast, true);
+        }
+        // each child of a top-level begin is recorded on its own
+        if (ast.tail.empty() || ast.tail[0].head.type != SymbolType ||
+            ast.tail[0].head.value.sym_value.id() != BeginId) {
+            return evalTopLevel(ast);
+        }
+        Expression result;
+        for (std::size_t i = 1; i < ast.tail.size(); ++i) {
+            result = evalTopLevel(ast.tail[i]);
+        }
+        return result;
     }
     throw InterpreterSemanticError("Error: No expression to evaluate.");
 }
+
+Expression Interpreter::evalForm(Expression& exp, bool program) {
+    // locals are slots before anything else sees the form
+    std::uint32_t frame = resolve_locals(exp, env);
+
+    Optimizer optimizer(env);
+    if (optimizeEnabled) {
+        optimizer.optimize(exp);
+        optimizerStats.folded += optimizer.stats().folded;
+        optimizerStats.propagated += optimizer.stats().propagated;
+    }
+
+    DeadCodeEliminator eliminator(env);
+    if (deadCodeEnabled && program) {
+        eliminator.eliminate(exp, eliminated);
+        deadCodeStats.defines += eliminator.stats().defines;
+        deadCodeStats.nodes += eliminator.stats().nodes;
+    }
+
+    // the temporaries are slots past those of the form's lets
+    SubexpressionEliminator cse(env);
+    if (cseEnabled) {
+        frame = cse.eliminate(exp, frame);
+        cseStats.temporaries += cse.stats().temporaries;
+        cseStats.replaced += cse.stats().replaced;
+    }
+
+    if (astDump != nullptr) {
+        dump_ast(*astDump, exp);
+        if (optimizeEnabled) {
+            *astDump << "; folded " << optimizer.stats().folded << ", propagated "
+                     << optimizer.stats().propagated << std::endl;
+        }
+        if (deadCodeEnabled && program) {
+            *astDump << "; eliminated " << eliminator.stats().defines << " defines, "
+                     << eliminator.stats().nodes << " nodes" << std::endl;
+        }
+        if (cseEnabled) {
+            *astDump << "; hoisted " << cse.stats().replaced << " subexpressions into "
+                     << cse.stats().temporaries << " temporaries" << std::endl;
+        }
+    }
+
+    if (typeCheckEnabled) {
+        TypeChecker checker(env, typeErrorReport);
+        checker.check(exp);
+        typeCheckStats.errors += checker.stats().errors;
+        typeCheckStats.numeric += checker.stats().numeric;
+    }
+
+    switch (mode) {
+    case BytecodeEval: {
+        Chunk chunk = VM::compile(exp, env);
+        return vm.run(chunk, env, graphics);
+    }
+    case ClosureEval:
+        return Closure::compile(exp, env).run(env, graphics);
+    default:
+        return Expression(evalValue(exp, frame));
+    }
+}
+
+Expression Interpreter::evalStream(std::istream& input, const FormCallback& formDone) {
+    StreamLexer tokens(input);
+    ParseStack stack(maxNesting, hashConsEnabled ? &hashCons : nullptr);
+
+    if (tokens.empty()) {
+        throw InterpreterSemanticError("Error: Empty tokens.");
+    }
+
+    // Each form lives in the arena only until it has been evaluated
+    ast = Expression();
+    eliminated = Expression();
+    arena.reset();
+    ArenaScope scope(arenaEnabled ? &arena : nullptr);
+
+    Expression result;
+    while (!tokens.empty()) {
+        if (tokens.front().kind != OpenToken) {
+            throw InterpreterSemanticError(tokens.front().kind == CloseToken ?
+                "Error: Extra tokens found after parsing." : "Error: Not a list.");
+        }
+        tokens.pop_front();
+
+        // Evaluate the children of a top-level begin one at a time
+        if (!tokens.empty() && tokens.front().kind == SymbolToken &&
+            Symbol(tokens.text(tokens.front()), tokens.front().length).id() == BeginId) {
+            tokens.pop_front();
+            result = Expression();
+            while (!tokens.empty() && tokens.front().kind != CloseToken) {
+                {
+                    Expression form = read_form(tokens, stack, 1);
+                    result = evalTopLevel(form);
+                }
+                arena.reset();
+                if (formDone) {
+                    formDone(result);
+                }
+            }
+            if (tokens.empty()) {
+                throw InterpreterSemanticError("Error: Unmatched parentheses.");
+            }
+            tokens.pop_front();
+        }
+        else {
+            {
+                Expression form = read_list(tokens, stack, 0);
+                result = evalTopLevel(form);
+            }
+            arena.reset();
+            if (formDone) {
+                formDone(result);
+            }
+        }
+    }
+    return result;
+}
+
+Expression Interpreter::evalTopLevel(Expression& exp) {
+    if (!reactiveEnabled) {
+        return evalForm(exp, false);
+    }
+    std::size_t previous;
+    if (reactive.redefines(exp, previous)) {
+        return redefine(exp, previous);
+    }
+
+    // recorded as parsed, as evaluating it rewrites it
+    const bool recordable = reactive.recordable(exp);
+    Expression parsed;
+    if (recordable) {
+        ArenaScope heap(nullptr);
+        parsed = exp;
+    }
+    const std::size_t drawn = graphics.size();
+    Expression result;
+    try {
+        result = evalForm(exp, false);
+    }
+    catch (...) {
+        graphicForms.resize(graphics.size(), ReactiveGraph::NoForm);
+        throw;
+    }
+    std::size_t id = ReactiveGraph::NoForm;
+    if (recordable && (is_valid_define(parsed) || graphics.size() > drawn)) {
+        id = reactive.record(std::move(parsed));
+    }
+    graphicForms.resize(graphics.size(), id);
+    return result;
+}
+
+// The redefinition and each dependent draw into graphics, kept empty
+// for them, and their graphics become updates only once all have been
+// evaluated without an error
+Expression Interpreter::redefine(Expression& exp, std::size_t previous) {
+    std::vector<std::size_t> dependents;
+    reactive.dependents(previous, dependents);
+    Expression parsed;
+    {
+        ArenaScope heap(nullptr);
+        parsed = exp;
+    }
+
+    // the values of the symbols unbound so far, to restore on an error
+    std::vector<std::pair<Symbol, Atom> > rebound;
+    std::vector<Atom> drawn;
+    graphics.swap(drawn);
+    std::vector<GraphicsUpdate> updates(1);
+    Expression result;
+    try {
+        const Symbol& sym = exp.tail[1].head.value.sym_value;
+        rebound.emplace_back(sym, env.getExp(sym).head);
+        env.undefine(sym);
+        result = evalForm(exp, false);
+        updates[0].graphics.swap(graphics);
+        for (std::size_t id : dependents) {
+            Expression form = reactive.form(id);
+            if (reactive.isDefine(id)) {
+                const Symbol& defined = form.tail[1].head.value.sym_value;
+                rebound.emplace_back(defined, env.getExp(defined).head);
+                env.undefine(defined);
+            }
+            evalForm(form, false);
+            updates.push_back(GraphicsUpdate{ id, std::vector<Atom>() });
+            updates.back().graphics.swap(graphics);
+        }
+    }
+    catch (...) {
+        for (auto it = rebound.rbegin(); it != rebound.rend(); ++it) {
+            if (env.lookup(it->first) != nullptr) {
+                env.undefine(it->first);
+            }
+            env.addExp(it->first, Expression(it->second));
+        }
+        graphics.swap(drawn);
+        throw;
+    }
+    graphics.swap(drawn);
+
+    graphicsUpdates.push_back(GraphicsUpdate{ previous, std::vector<Atom>() });
+    updates[0].form = reactive.replace(previous, std::move(parsed));
+    for (GraphicsUpdate& update : updates) {
+        graphicsUpdates.push_back(std::move(update));
+    }
+    reactive.recomputed(dependents.size());
+    return result;
+}
+
+void Interpreter::clearGraphics() {
+    graphics.clear();
+    graphicForms.clear();
+    graphicsUpdates.clear();
+}
+
+void Interpreter::setArenaEnabled(bool enabled) {
+    // the current program may live in the arena
+    ast = Expression();
+    eliminated = Expression();
+    arena.reset();
+    arenaEnabled = enabled;
+}
+
+void Interpreter::setEvalMode(EvalMode evalMode) {
+    mode = evalMode;
+}
+
+Interpreter::EvalMode Interpreter::getEvalMode() const {
+    return mode;
+}
+
+void Interpreter::setOptimizeEnabled(bool enabled) {
+    optimizeEnabled = enabled;
+}
+
+const OptimizerStats& Interpreter::getOptimizerStats() const {
+    return optimizerStats;
+}
+
+void Interpreter::setDeadCodeEnabled(bool enabled) {
+    deadCodeEnabled = enabled;
+}
+
+const DeadCodeStats& Interpreter::getDeadCodeStats() const {
+    return deadCodeStats;
+}
+
+void Interpreter::setCseEnabled(bool enabled) {
+    cseEnabled = enabled;
+}
+
+const CseStats& Interpreter::getCseStats() const {
+    return cseStats;
+}
+
+void Interpreter::setTypeCheckEnabled(bool enabled) {
+    typeCheckEnabled = enabled;
+}
+
+const TypeCheckStats& Interpreter::getTypeCheckStats() const {
+    return typeCheckStats;
+}
+
+const CallCacheStats& Interpreter::getCallCacheStats() const {
+    return callCacheStats;
+}
+
+void Interpreter::setHashConsEnabled(bool enabled) {
+    hashConsEnabled = enabled;
+}
+
+const HashConsStats& Interpreter::getHashConsStats() const {
+    return hashCons.stats();
+}
+
+void Interpreter::setResultCacheCapacity(std::size_t capacity) {
+    resultCache.setCapacity(capacity);
+}
+
+const ResultCacheStats& Interpreter::getResultCacheStats() const {
+    return resultCache.stats();
+}
+
+void Interpreter::setTypeErrorReport(std::ostream* out) {
+    typeErrorReport = out;
+}
+
+void Interpreter::setAstDump(std::ostream* out) {
+    astDump = out;
+}
+
+void Interpreter::setDefineMode(Environment::DefineMode mode) {
+    env.setDefineMode(mode);
+}
+
+Environment::DefineMode Interpreter::getDefineMode() const {
+    return env.defineMode();
+}
+
+void Interpreter::setReactiveEnabled(bool enabled) {
+    reactiveEnabled = enabled;
+    reactive.clear();
+    graphicForms.assign(enabled ? graphics.size() : 0, ReactiveGraph::NoForm);
+    graphicsUpdates.clear();
+}
+
+const std::vector<std::size_t>& Interpreter::getGraphicForms() const {
+    return graphicForms;
+}
+
+const std::vector<GraphicsUpdate>& Interpreter::getGraphicsUpdates() const {
+    return graphicsUpdates;
+}
+
+const ReactiveStats& Interpreter::getReactiveStats() const {
+    return reactive.stats();
+}
+
+void Interpreter::setMaxNesting(std::size_t depth) {
+    maxNesting = depth;
+}
@@ -5,10 +5,30 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <functional>
 
 // module includes
+#include "bytecode.hpp"
+#include "closure.hpp"
+#include "cse.hpp"
+#include "deadcode.hpp"
 #include "environment.hpp"
+#include "hashcons.hpp"
+#include "optimizer.hpp"
+#include "reactive.hpp"
+#include "resolver.hpp"
+#include "resultcache.hpp"
 #include "tokenize.hpp"
+#include "typecheck.hpp"
+
+// How often the tree walker found the procedure called at the head of
+// a list in the inline cache of the list, rather than looking it up
+struct CallCacheStats {
+    std::size_t hits;
+    std::size_t misses;
+
+    CallCacheStats() : hits(0), misses(0) {}
+};
 
 // Interpreter has
 // Environment, which starts at a default
@@ -19,17 +39,203 @@ public:
     Interpreter();
     bool parse(std::istream& expression) noexcept;
     Expression read_from_tokens(TokenSequenceType& tokens);
+    Expression read_from_tokens(TokenStream& tokens);
+    Expression read_from_tokens(StreamLexer& tokens);
     Expression atom(const std::string& token);
     Expression eval(const Expression& exp);
     Expression eval();
     const std::vector<Atom>& getGraphicsVector() const;
+    // forget the graphics drawn so far, and in reactive mode which forms
+    // drew them and the updates made by redefinitions
+    void clearGraphics();
+
+    // called with the value of each form evaluated by evalStream
+    typedef std::function<void(const Expression&)> FormCallback;
+
+    // parse and evaluate input through a fixed-size buffer, one top-level
+    // form, or one child of a top-level begin, at a time so that memory
+    // stays bounded by the largest such form. Returns the last value.
+    // Forms before a parse or evaluation error have already taken effect.
+    Expression evalStream(std::istream& input, const FormCallback& formDone = FormCallback());
+
+    // allocate parse trees and evaluation temporaries from an arena that
+    // is reset per program or streamed form (the default), or from the heap.
+    // Discards the current program.
+    void setArenaEnabled(bool enabled);
+
+    // how eval() and evalStream() run a program, the tree-walking
+    // eval(const Expression&), the bytecode VM or a compiled Closure
+    enum EvalMode { TreeEval, BytecodeEval, ClosureEval };
+    void setEvalMode(EvalMode mode);
+    EvalMode getEvalMode() const;
+
+    // run the Optimizer on each form eval() and evalStream() evaluate,
+    // off by default
+    void setOptimizeEnabled(bool enabled);
+    // the rewrites made by the Optimizer so far
+    const OptimizerStats& getOptimizerStats() const;
+    // write each form to out, as optimized, before it is evaluated,
+    // nullptr to stop
+    void setAstDump(std::ostream* out);
+
+    // run the DeadCodeEliminator on each program eval() evaluates, after
+    // the Optimizer, which may leave more defines unused. Its defines
+    // are then gone for later programs, so it suits running a file
+    // rather than a REPL. Streamed forms are never seen whole, so are
+    // left alone. Off by default
+    void setDeadCodeEnabled(bool enabled);
+    // the defines removed and the expressions in them so far
+    const DeadCodeStats& getDeadCodeStats() const;
+
+    // run the SubexpressionEliminator on each form eval() and evalStream()
+    // evaluate, after the DeadCodeEliminator, so that the pure calls a
+    // form repeats are computed once into hidden temporaries. Off by
+    // default
+    void setCseEnabled(bool enabled);
+    // the temporaries bound and the subexpressions they replaced so far
+    const CseStats& getCseStats() const;
 
+    // run the TypeChecker on each form eval() and evalStream() evaluate,
+    // after the Optimizer, so that arithmetic proven to be on Numbers is
+    // evaluated unboxed. Off by default
+    void setTypeCheckEnabled(bool enabled);
+    // the type errors found and lists marked numeric so far
+    const TypeCheckStats& getTypeCheckStats() const;
+    // write each type error found to out, before the form containing it
+    // is evaluated, nullptr to stop
+    void setTypeErrorReport(std::ostream* out);
+
+    // the calls of builtins and user procedures by symbol that the tree
+    // walker resolved from the inline cache in the list, so far. Only a
+    // list evaluated again, in a loop, a body or a program run twice, or
+    // shared by hash-consing across programs, can hit
+    const CallCacheStats& getCallCacheStats() const;
+
+    // parse structurally identical calls of builtins on constants, as
+    // arguments of builtins, into references to one copy of each, kept
+    // for the life of the interpreter, even across programs and
+    // streamed forms. Off by default
+    void setHashConsEnabled(bool enabled);
+    // the lists shared and the memory saved so far
+    const HashConsStats& getHashConsStats() const;
+
+    // remember the values the tree walker computes for lists shared by
+    // hash-consing, which are pure, across programs and REPL lines, up
+    // to capacity values. 0, the default, turns it off
+    static const std::size_t DEFAULT_RESULT_CACHE = 4096;
+    void setResultCacheCapacity(std::size_t capacity);
+    // how often the value of a shared list was found in the cache so far
+    const ResultCacheStats& getResultCacheStats() const;
+
+    // how a define whose value is unused binds its symbol, evaluating
+    // its value at once (the default) or when the symbol is first read,
+    // as described by Environment::DefineMode. The defines of forms
+    // evalStream evaluates one at a time always evaluate their values
+    void setDefineMode(Environment::DefineMode mode);
+    Environment::DefineMode getDefineMode() const;
+
+    // record the top-level defines and drawing forms eval() and
+    // evalStream() evaluate, as a ReactiveGraph, so that a top-level
+    // define of a symbol bound by a recorded define rebinds it and
+    // evaluates its dependents again, rather than raising an error. If
+    // any of them raises an error, every binding it changed is restored
+    // and the error raised. The children of a top-level begin are
+    // evaluated one at a time, as by evalStream(), and the
+    // DeadCodeEliminator is not run, as a later redefinition may need
+    // any define. Turning it off forgets the forms recorded. Off by
+    // default
+    void setReactiveEnabled(bool enabled);
+    // in reactive mode, the id of the recorded form that drew each of
+    // the graphics, ReactiveGraph::NoForm for those of a form not recorded
+    const std::vector<std::size_t>& getGraphicForms() const;
+    // the graphics of the forms redefinitions evaluated again, in order,
+    // each replacing all the form drew before, rather than added to the
+    // graphics. A redefinition is recorded anew, so the define it
+    // replaces is updated to draw nothing
+    const std::vector<GraphicsUpdate>& getGraphicsUpdates() const;
+    // the forms recorded and evaluated again so far
+    const ReactiveStats& getReactiveStats() const;
+
+    // the deepest lists may be nested in a program before parsing fails
+    // with an error, rather than evaluation overflowing the native stack
+    static const std::size_t DEFAULT_MAX_NESTING = 10000;
+    void setMaxNesting(std::size_t depth);
 
 protected:
     Environment env;
+    // declared before ast, which may live in it
+    Arena arena;
+    bool arenaEnabled;
     Expression ast;
+    // the defines removed from ast by the DeadCodeEliminator
+    Expression eliminated;
     std::vector<Atom> graphics;
+    EvalMode mode;
+    VM vm;
+    bool optimizeEnabled;
+    OptimizerStats optimizerStats;
+    std::ostream* astDump;
+    bool deadCodeEnabled;
+    DeadCodeStats deadCodeStats;
+    bool cseEnabled;
+    CseStats cseStats;
+    bool typeCheckEnabled;
+    TypeCheckStats typeCheckStats;
+    std::ostream* typeErrorReport;
+    CallCacheStats callCacheStats;
+    HashConser hashCons;
+    bool hashConsEnabled;
+    ResultCache resultCache;
+    std::size_t maxNesting;
+    bool reactiveEnabled;
+    ReactiveGraph reactive;
+    std::vector<std::size_t> graphicForms;
+    std::vector<GraphicsUpdate> graphicsUpdates;
+
+private:
+    // A form whose evaluation is waiting on the value of exp->tail[next - 1],
+    // or for a LoopRange on the next part of the range
+    struct EvalFrame {
+        enum Form { Define, Begin, If, Draw, Call, LoopRange, Loop, Callee, Apply, Return, Logic, Cond, Let,
+            Remember };
+
+        Form form;
+        const Expression* exp;
+        std::size_t next;
+        // for a Call, the builtin and where its arguments start on evalValues
+        Procedure proc;
+        // for a loop, where start, end and step are on evalValues,
+        // for an Apply or Return, where the arguments are, and for a
+        // Let, where its values are
+        std::size_t base;
+        // the loop iterations started so far
+        Number iteration;
+        // for an Apply, the user procedure called
+        std::uint32_t lambda;
+
+        EvalFrame(Form form, const Expression* exp, std::size_t next)
+            : form(form), exp(exp), next(next), proc(nullptr), base(0), iteration(0), lambda(0) {}
+    };
+
+    // the continuation and argument stacks of evalValue, kept between
+    // calls so they are only allocated as they grow
+    std::vector<EvalFrame> evalFrames;
+    std::vector<Atom> evalValues;
 
+    // optimize and evaluate a top-level form with the current EvalMode,
+    // removing its unused defines if it is a whole program and hoisting
+    // its common subexpressions
+    Expression evalForm(Expression& exp, bool program);
+    // evaluate a top-level form that is not a whole program with
+    // evalForm(), recording it in reactive mode
+    Expression evalTopLevel(Expression& exp);
+    // rebind the symbol of the recorded define previous to the value of
+    // exp, a top-level define, and evaluate its dependents again
+    Expression redefine(Expression& exp, std::size_t previous);
+    // the tree walker behind eval(const Expression&), evaluating exp
+    // in a frame of frame slots
+    Atom evalValue(const Expression& exp, std::size_t frame);
+    Atom evalWithFrames(const Expression& exp, std::size_t frame);
 };
 
 #endif
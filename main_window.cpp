@@ -1,4 +1,5 @@
 #include "main_window.hpp"
+
 #include "message_widget.hpp"
 #include "canvas_widget.hpp"
 #include "repl_widget.hpp"
@@ -7,7 +8,18 @@ MainWindow::MainWindow(QWidget* parent) : MainWindow("", parent) {
     // This constructor serves as a default call to the parameterized constructor with an empty filename
 }
 
-MainWindow::MainWindow(std::string filename, QWidget* parent) : QWidget(parent) {
+MainWindow::MainWindow(std::string filename, QWidget* parent) : MainWindow(filename, MainWindowOptions(), parent) {
+}
+
+MainWindow::MainWindow(std::string filename, const MainWindowOptions& options, QWidget* parent) : QWidget(parent) {
+    qtinterp.setEvalMode(options.mode);
+    if (options.cache) {
+        // entries are often entered again with small changes
+        qtinterp.setHashConsEnabled(true);
+        qtinterp.setResultCacheCapacity(QtInterpreter::DEFAULT_RESULT_CACHE);
+    }
+    qtinterp.setReactiveEnabled(options.reactive);
+
     layout = new QVBoxLayout(this);
 
     messageWidget = new MessageWidget();
@@ -20,16 +32,32 @@ MainWindow::MainWindow(std::string filename, QWidget* parent) : QWidget(parent)
 
     setLayout(layout);
 
+    // connected once, as an item removed twice would be deleted twice
+    QObject::connect(&qtinterp, &QtInterpreter::removeGraphic, canvasWidget, &CanvasWidget::removeGraphic);
+
     // Open and read the file content if filename is not empty
     if (!filename.empty()) {
         std::ifstream file(filename);
         if (file.is_open()) {
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            std::string fileContent = buffer.str();
             QObject::connect(&qtinterp, &QtInterpreter::drawGraphic, canvasWidget, &CanvasWidget::addGraphic);
             QObject::connect(&qtinterp, &QtInterpreter::clear, canvasWidget, &CanvasWidget::clear);
-            qtinterp.parseAndEvaluate(fileContent.c_str());
+            if (options.eliminate) {
+                // Only a whole program shows which defines nothing uses, and
+                // REPL entries may use any define, so only the file is pruned
+                qtinterp.setDeadCodeEnabled(true);
+                qtinterp.evaluateProgram(file);
+                qtinterp.setDeadCodeEnabled(false);
+                const DeadCodeStats& stats = qtinterp.getDeadCodeStats();
+                if (stats.defines != 0) {
+                    std::ostringstream message;
+                    message << "Eliminated " << stats.defines << " unused defines, " << stats.nodes << " nodes";
+                    messageWidget->info(QString::fromStdString(message.str()));
+                }
+            }
+            else {
+                // Stream the file so large generated scenes load in bounded memory
+                qtinterp.streamAndEvaluate(file);
+            }
             file.close();
         }
         else {
@@ -13,12 +13,29 @@ class MessageWidget;
 class CanvasWidget;
 class REPLWidget;
 
+// How a MainWindow evaluates its file and REPL entries
+struct MainWindowOptions {
+    // the backend
+    Interpreter::EvalMode mode;
+    // share repeated pure calls, remembering their values across entries
+    bool cache;
+    // skip the defines of the file that nothing in it uses, reading it
+    // whole rather than streaming it
+    bool eliminate;
+    // let REPL entries redefine the symbols the file defines, redrawing
+    // only what depends on them
+    bool reactive;
+
+    MainWindowOptions() : mode(Interpreter::TreeEval), cache(false), eliminate(false), reactive(false) {}
+};
+
 class MainWindow : public QWidget {
     Q_OBJECT
 
 public:
     MainWindow(QWidget* parent = nullptr);
     MainWindow(std::string filename, QWidget* parent = nullptr);
+    MainWindow(std::string filename, const MainWindowOptions& options, QWidget* parent = nullptr);
 
 private:
     QtInterpreter qtinterp;
@@ -0,0 +1,283 @@
+#include "optimizer.hpp"
+
+// module includes
+#include "interpreter_semantic_error.hpp"
+
+namespace {
+
+// true if exp is a literal, which evaluates to itself
+bool is_literal(const Expression& exp) {
+    if (!exp.tail.empty()) {
+        return false;
+    }
+    switch (exp.head.type) {
+    case BooleanType:
+    case NumberType:
+    case PointType:
+    case LineType:
+    case ArcType:
+    case RangeType:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+Optimizer::Optimizer(const Environment& env) : env(env) {
+}
+
+void Optimizer::optimize(Expression& exp) {
+    defined.clear();
+    visit(exp, false);
+}
+
+const OptimizerStats& Optimizer::stats() const {
+    return counts;
+}
+
+// the literal sym is bound to, if any
+bool Optimizer::constant(const Symbol& sym, Atom& value) const {
+    // nothing can be redefined, so a binding made earlier is final
+    const Environment::EnvResult* binding = env.lookup(sym);
+    if (binding != nullptr) {
+        if (binding->type == Environment::ExpressionType && is_literal(binding->exp)) {
+            value = binding->exp.head;
+            return true;
+        }
+        return false;
+    }
+    if (sym.id() < defined.size() && defined[sym.id()].type != NoneType) {
+        value = defined[sym.id()];
+        return true;
+    }
+    return false;
+}
+
+void Optimizer::fold(Expression& exp, const Atom& value) {
+    // value may live in exp's tail
+    Expression literal(value);
+    exp = std::move(literal);
+    ++counts.folded;
+}
+
+// conditional is true inside a branch that may not be taken, where
+// a define does not make its symbol a constant for later forms
+void Optimizer::visit(Expression& exp, bool conditional) {
+    if (exp.head.type == SharedType) {
+        // folded in place, so copied out of the one shared
+        Expression list(*exp.head.value.shared_value);
+        exp = std::move(list);
+        visitList(exp, conditional);
+    }
+    else if (exp.head.type == ListType) {
+        visitList(exp, conditional);
+    }
+    else if (exp.head.type == SymbolType) {
+        Atom value;
+        if (constant(exp.head.value.sym_value, value)) {
+            exp = Expression(value);
+            ++counts.propagated;
+        }
+    }
+}
+
+// Only parts that eval would evaluate are visited, in the same order
+void Optimizer::visitList(Expression& exp, bool conditional) {
+    if (exp.tail.empty()) {
+        return;
+    }
+
+    const Expression& first = exp.tail[0];
+
+    if (first.head.type == BooleanType || first.head.type == NumberType) {
+        // the rest of the list is never evaluated
+        fold(exp, first.head);
+        return;
+    }
+    if (first.head.type != SymbolType) {
+        return;
+    }
+
+    const Symbol name = first.head.value.sym_value;
+    switch (name.id()) {
+    case DefineId: {
+        if (exp.tail.size() != 3 || exp.tail[1].head.type != SymbolType) {
+            return;
+        }
+        visit(exp.tail[2], conditional);
+        const Symbol& sym = exp.tail[1].head.value.sym_value;
+        Atom value;
+        // a define that will fail binds nothing
+        if (!conditional && is_literal(exp.tail[2]) && !is_special_form(sym) && !constant(sym, value) &&
+            env.lookup(sym) == nullptr) {
+            if (defined.size() <= sym.id()) {
+                defined.resize(sym.id() + 1);
+            }
+            defined[sym.id()] = exp.tail[2].head;
+        }
+        return;
+    }
+    case BeginId:
+    case DrawId:
+        if (name.id() == DrawId && exp.tail.size() < 2) {
+            return;
+        }
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            visit(exp.tail[i], conditional);
+        }
+        return;
+    case IfId: {
+        if (exp.tail.size() != 4) {
+            return;
+        }
+        visit(exp.tail[1], conditional);
+        const Expression& condition = exp.tail[1];
+        // a map may only be an argument of draw, so one cannot become one
+        if (condition.head.type == BooleanType && condition.tail.empty() &&
+            !is_map(exp.tail[condition.head.value.bool_value ? 2 : 3])) {
+            // only the branch taken remains
+            Expression branch = std::move(exp.tail[condition.head.value.bool_value ? 2 : 3]);
+            exp = std::move(branch);
+            ++counts.folded;
+            visit(exp, conditional);
+            return;
+        }
+        visit(exp.tail[2], true);
+        visit(exp.tail[3], true);
+        return;
+    }
+    case ForId:
+    case RepeatId:
+    case MapId: {
+        bool valid = name.id() == ForId ? is_valid_for(exp) :
+            name.id() == MapId ? is_valid_map(exp) : exp.tail.size() >= 3;
+        if (!valid) {
+            return;
+        }
+        if (name.id() != RepeatId) {
+            Expression& range = exp.tail[1];
+            for (std::size_t i = 1; i < range.tail.size(); ++i) {
+                visit(range.tail[i], conditional);
+            }
+        }
+        else {
+            visit(exp.tail[1], conditional);
+        }
+        // the body may run any number of times, including none
+        for (std::size_t i = 2; i < exp.tail.size(); ++i) {
+            visit(exp.tail[i], true);
+        }
+        return;
+    }
+    case LambdaId:
+        // a parameter may hide any symbol in the body, which is left
+        // to be resolved when the lambda is made
+        return;
+    case AndId:
+    case OrId: {
+        if (exp.tail.size() < 2) {
+            return;
+        }
+        // the value that stops the evaluation of the rest
+        const bool stop = name.id() == OrId;
+        bool literals = true;
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            // only the first argument is certain to be evaluated
+            visit(exp.tail[i], conditional || i > 1);
+            const Expression& arg = exp.tail[i];
+            if (arg.head.type != BooleanType || !arg.tail.empty()) {
+                literals = false;
+                continue;
+            }
+            if (literals && arg.head.value.bool_value == stop) {
+                fold(exp, boolean_atom(stop));
+                return;
+            }
+        }
+        if (literals) {
+            fold(exp, boolean_atom(!stop));
+        }
+        return;
+    }
+    case LetId:
+        if (!is_valid_let(exp)) {
+            return;
+        }
+        for (Expression& binding : exp.tail[1].tail) {
+            visit(binding.tail[1], conditional);
+        }
+        for (std::size_t i = 2; i < exp.tail.size(); ++i) {
+            visit(exp.tail[i], conditional);
+        }
+        return;
+    case CondId:
+        if (!is_valid_cond(exp)) {
+            return;
+        }
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            Expression& clause = exp.tail[i];
+            // only the first test is certain to be evaluated
+            for (std::size_t j = is_else_clause(clause) ? 1 : 0; j < clause.tail.size(); ++j) {
+                visit(clause.tail[j], conditional || i > 1 || j > 0);
+            }
+        }
+        return;
+    default:
+        break;
+    }
+
+    const Environment::EnvResult* binding = env.lookup(name);
+    if (binding == nullptr || binding->type != Environment::ProcedureType) {
+        // a defined symbol at the head ignores the rest of the list
+        Atom value;
+        if (constant(name, value)) {
+            fold(exp, value);
+        }
+        return;
+    }
+
+    bool literals = true;
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        visit(exp.tail[i], conditional);
+        literals = literals && is_literal(exp.tail[i]);
+    }
+    if (!literals) {
+        return;
+    }
+
+    // every builtin is pure, so a call on literals can be made now
+    Atom result;
+    try {
+        ArenaRegion region;
+        ArgList args;
+        args.reserve(exp.tail.size() - 1);
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            args.push_back(exp.tail[i].head);
+        }
+        result = binding->proc(args);
+    }
+    catch (const InterpreterSemanticError&) {
+        // leave the error to be raised by eval
+        return;
+    }
+    fold(exp, result);
+}
+
+void dump_ast(std::ostream& out, const Expression& exp) {
+    bool begin = exp.head.type == ListType && !exp.tail.empty() &&
+        exp.tail[0].head.type == SymbolType && exp.tail[0].head.value.sym_value.id() == BeginId;
+    if (!begin) {
+        write_sexp(out, exp);
+        out << "\n";
+        return;
+    }
+    out << "(begin\n";
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        out << "  ";
+        write_sexp(out, exp.tail[i]);
+        out << "\n";
+    }
+    out << ")\n";
+}
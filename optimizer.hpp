@@ -0,0 +1,52 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+// system includes
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of the rewrites made by an Optimizer
+struct OptimizerStats {
+    // subexpressions replaced by the literal they evaluate to
+    std::size_t folded;
+    // symbol references replaced by the constant they are bound to
+    std::size_t propagated;
+
+    OptimizerStats() : folded(0), propagated(0) {}
+};
+
+// The Optimizer rewrites a parsed expression in place before it is
+// evaluated, giving the same results, side effects and errors.
+// It folds calls of builtins on literal arguments, which are all pure,
+// and if forms with a literal condition. Symbols are replaced by their
+// value once bound to a literal, by an earlier form in env or by a
+// define that is certain to have run first. A call that would raise
+// an error is left to raise it when evaluated.
+class Optimizer {
+public:
+    explicit Optimizer(const Environment& env);
+
+    void optimize(Expression& exp);
+
+    const OptimizerStats& stats() const;
+
+private:
+    void visit(Expression& exp, bool conditional);
+    void visitList(Expression& exp, bool conditional);
+    bool constant(const Symbol& sym, Atom& value) const;
+    void fold(Expression& exp, const Atom& value);
+
+    const Environment& env;
+    // literals bound by defines seen in this expression, by symbol id
+    std::vector<Atom> defined;
+    OptimizerStats counts;
+};
+
+// write exp as an s-expression, one top-level form per line
+void dump_ast(std::ostream& out, const Expression& exp);
+
+#endif
@@ -21,6 +21,139 @@ const std::vector<Atom>& QtInterpreter::getGraphicsVector() const {
     return graphics;
 }
 
+QGraphicsItem* QtInterpreter::emitGraphic(const Atom& graphic) {
+    if (graphic.type == PointType) {
+        // Handle PointType graphic
+        QGraphicsEllipseItem* point = new QGraphicsEllipseItem(
+            graphic.value.point_value.x,
+            graphic.value.point_value.y,
+            2, 2
+        );
+        point->setBrush(Qt::black);
+        emit drawGraphic(point);
+        return point;
+    }
+    else if (graphic.type == LineType) {
+        // Handle LineType graphic
+        QGraphicsLineItem* line = new QGraphicsLineItem(
+            graphic.value.line_value.first.x,
+            graphic.value.line_value.first.y,
+            graphic.value.line_value.second.x,
+            graphic.value.line_value.second.y
+        );
+
+        emit drawGraphic(line);
+        return line;
+    }
+    else if (graphic.type == ArcType) {
+        // Handle ArcType graphic
+        QGraphicsArcItem* arc = new QGraphicsArcItem(
+            graphic.value.arc_value.center.x - std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
+                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
+            graphic.value.arc_value.center.y - std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
+                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
+            2 * std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x), 
+                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
+            2 * std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
+                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
+            nullptr
+        );
+       
+        double angleInRadians = std::atan(std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y) /
+            std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x));
+
+        // Convert the angle from radians to degrees
+        double angleInDegrees = 16 * angleInRadians * (180.0 / PI);
+
+        double spanInDegrees = 16 * graphic.value.arc_value.span * (180.0 / PI);
+
+        // Set the start and span angle in degrees 
+        arc->setSpanAngle(spanInDegrees);
+        arc->setStartAngle(angleInDegrees);
+
+        emit drawGraphic(arc);
+        return arc;
+    }
+    return nullptr;
+}
+
+// draw the graphics, and in reactive mode keep the items of each
+// recorded form, replace those of the forms redefinitions updated and
+// forget the graphics once drawn
+void QtInterpreter::emitGraphics() {
+    auto keep = [this](std::size_t form, QGraphicsItem* item) {
+        if (form >= formItems.size()) {
+            formItems.resize(form + 1);
+        }
+        formItems[form].push_back(item);
+    };
+    const std::vector<std::size_t>& forms = getGraphicForms();
+    for (std::size_t i = 0; i < graphics.size(); ++i) {
+        QGraphicsItem* item = emitGraphic(graphics[i]);
+        if (i < forms.size() && forms[i] != ReactiveGraph::NoForm) {
+            keep(forms[i], item);
+        }
+    }
+    for (const GraphicsUpdate& update : getGraphicsUpdates()) {
+        if (update.form < formItems.size()) {
+            for (QGraphicsItem* item : formItems[update.form]) {
+                emit removeGraphic(item);
+            }
+            formItems[update.form].clear();
+        }
+        for (const Atom& graphic : update.graphics) {
+            keep(update.form, emitGraphic(graphic));
+        }
+    }
+    if (reactiveEnabled) {
+        clearGraphics();
+    }
+}
+
+// clear the canvas after an error, unless in reactive mode, where the
+// items drawn stay those of the forms recorded
+void QtInterpreter::emitClear() {
+    if (!reactiveEnabled) {
+        emit clear();
+    }
+}
+
+void QtInterpreter::streamAndEvaluate(std::istream& input) {
+    try {
+        // draw each form's graphics as soon as it has been evaluated
+        Expression result = evalStream(input, [this](const Expression&) {
+            emitGraphics();
+            clearGraphics();
+        });
+        std::stringstream resultStream;
+        resultStream << result;
+        emit info("(" + QString::fromStdString(resultStream.str()) + ")");
+    }
+    catch (const InterpreterSemanticError& e) {
+        emit error("Error: " + QString::fromStdString(e.what()));
+        emitClear();
+    }
+}
+
+void QtInterpreter::evaluateProgram(std::istream& input) {
+    if (!parse(input)) {
+        emit error("Error: parsing failed");
+        emitClear();
+        return;
+    }
+    try {
+        Expression result = eval();
+        emitGraphics();
+        std::stringstream resultStream;
+        resultStream << result;
+        emit info("(" + QString::fromStdString(resultStream.str()) + ")");
+    }
+    catch (const InterpreterSemanticError& e) {
+        emit error("Error: " + QString::fromStdString(e.what()));
+        emitClear();
+    }
+}
+
 void QtInterpreter::parseAndEvaluate(QString entry) {
     bool c = false;
     try {
@@ -41,59 +174,7 @@ void QtInterpreter::parseAndEvaluate(QString entry) {
                 c = true;
                 emit error(em);
             }
-            if (!graphics.empty()) {
-                for (const auto& graphic : graphics) {
-                    if (graphic.type == PointType) {
-                        // Handle PointType graphic
-                        QGraphicsEllipseItem* point = new QGraphicsEllipseItem(
-                            graphic.value.point_value.x,
-                            graphic.value.point_value.y,
-                            2, 2
-                        );
-                        point->setBrush(Qt::black);
-                        emit drawGraphic(point);
-                    }
-                    else if (graphic.type == LineType) {
-                        // Handle LineType graphic
-                        QGraphicsLineItem* line = new QGraphicsLineItem(
-                            graphic.value.line_value.first.x,
-                            graphic.value.line_value.first.y,
-                            graphic.value.line_value.second.x,
-                            graphic.value.line_value.second.y
-                        );
-
-                        emit drawGraphic(line);
-                    }
-                    else if (graphic.type == ArcType) {
-                        // Handle ArcType graphic
-                        QGraphicsArcItem* arc = new QGraphicsArcItem(
-                            graphic.value.arc_value.center.x - std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
-                                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
-                            graphic.value.arc_value.center.y - std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
-                                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
-                            2 * std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x), 
-                                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
-                            2 * std::max(std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x),
-                                std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y)),
-                            nullptr
-                        );
-                       
-                        double angleInRadians = std::atan(std::abs(graphic.value.arc_value.start.y - graphic.value.arc_value.center.y) /
-                            std::abs(graphic.value.arc_value.center.x - graphic.value.arc_value.start.x));
-
-                        // Convert the angle from radians to degrees
-                        double angleInDegrees = 16 * angleInRadians * (180.0 / PI);
-
-                        double spanInDegrees = 16 * graphic.value.arc_value.span * (180.0 / PI);
-
-                        // Set the start and span angle in degrees 
-                        arc->setSpanAngle(spanInDegrees);
-                        arc->setStartAngle(angleInDegrees);
-
-                        emit drawGraphic(arc);
-                    }
-                }
-            }
+            emitGraphics();
         }
         else {
             QString em = "Error: parsing failed";
@@ -107,7 +188,7 @@ void QtInterpreter::parseAndEvaluate(QString entry) {
         emit error(em);
     }
     if (c) {
-        emit clear();
+        emitClear();
     }
 }
 
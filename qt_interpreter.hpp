@@ -2,6 +2,8 @@
 #define QT_INTERPRETER_HPP
 
 #include <string>
+#include <istream>
+#include <vector>
 
 #include <QObject>
 #include <QLabel>
@@ -17,13 +19,52 @@ public:
 	QtInterpreter(QObject* parent = nullptr);
 	const std::vector<Atom>& getGraphicsVector() const;
 
+	// evaluate a whole program, such as a file, through a bounded buffer,
+	// drawing the graphics of each top-level form as it completes
+	void streamAndEvaluate(std::istream& input);
+	// evaluate a whole program read at once, which dead code elimination
+	// needs, drawing its graphics once it completes
+	void evaluateProgram(std::istream& input);
+
+	// select the tree walker, bytecode VM or closure backend
+	using Interpreter::EvalMode;
+	using Interpreter::setEvalMode;
+
+	// share repeated calls of builtins on constants, off by default, and
+	// remember the values of those calls across entries, up to the
+	// capacity set, DEFAULT_RESULT_CACHE being a sensible one, or none
+	// while it is 0, the default
+	using Interpreter::setHashConsEnabled;
+	using Interpreter::DEFAULT_RESULT_CACHE;
+	using Interpreter::setResultCacheCapacity;
+	using Interpreter::getResultCacheStats;
+
+	// skip the defines of a program that nothing uses, off by default
+	using Interpreter::setDeadCodeEnabled;
+	using Interpreter::getDeadCodeStats;
+
+	// let an entry redefine a symbol, replacing only the items of the
+	// forms that read it, off by default. An evaluation error then
+	// leaves the canvas as it is
+	using Interpreter::setReactiveEnabled;
+	using Interpreter::getReactiveStats;
+
 signals:
 	void drawGraphic(QGraphicsItem* item);
+	void removeGraphic(QGraphicsItem* item);
 	void info(QString message);
 	void error(QString message);
 	void clear();
 
 public slots:
 	void parseAndEvaluate(QString entry);
+
+private:
+	QGraphicsItem* emitGraphic(const Atom& graphic);
+	void emitGraphics();
+	void emitClear();
+
+	// in reactive mode, the items drawn by each recorded form, by id
+	std::vector<std::vector<QGraphicsItem*> > formItems;
 };
 #endif
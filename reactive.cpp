@@ -0,0 +1,155 @@
+#include "reactive.hpp"
+
+// system includes
+#include <algorithm>
+
+namespace {
+
+// true if a list in exp, other than a shared list, which only calls
+// builtins, is a define
+bool has_define(const Expression& exp) {
+    if (exp.head.type != ListType) {
+        return false;
+    }
+    if (!exp.tail.empty() && exp.tail[0].head.type == SymbolType &&
+        exp.tail[0].head.value.sym_value.id() == DefineId) {
+        return true;
+    }
+    for (const Expression& child : exp.tail) {
+        if (has_define(child)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+const std::size_t ReactiveGraph::NoForm;
+
+ReactiveGraph::ReactiveGraph(const Environment& env) : env(env) {
+}
+
+const ReactiveStats& ReactiveGraph::stats() const {
+    return counts;
+}
+
+void ReactiveGraph::recomputed(std::size_t forms) {
+    counts.recomputed += forms;
+}
+
+bool ReactiveGraph::recordable(const Expression& form) const {
+    return is_valid_define(form) ? !has_define(form.tail[2]) : !has_define(form);
+}
+
+bool ReactiveGraph::redefines(const Expression& form, std::size_t& previous) const {
+    if (!is_valid_define(form)) {
+        return false;
+    }
+    const Symbol::Id id = form.tail[1].head.value.sym_value.id();
+    if (id >= definers.size() || definers[id] == NoForm) {
+        return false;
+    }
+    previous = definers[id];
+    return true;
+}
+
+std::size_t ReactiveGraph::record(Expression&& form) {
+    ++counts.forms;
+    const std::size_t id = forms.size();
+    ArenaScope heap(nullptr);
+    forms.push_back(Recorded{ std::move(form), true });
+    const Expression& recorded = forms.back().form;
+    if (is_valid_define(recorded)) {
+        const Symbol::Id defined = recorded.tail[1].head.value.sym_value.id();
+        if (defined >= definers.size()) {
+            definers.resize(defined + 1, NoForm);
+        }
+        definers[defined] = id;
+        scan(recorded.tail[2], id);
+    }
+    else {
+        scan(recorded, id);
+    }
+    return id;
+}
+
+std::size_t ReactiveGraph::replace(std::size_t previous, Expression&& form) {
+    ++counts.redefinitions;
+    --counts.forms;
+    {
+        ArenaScope heap(nullptr);
+        forms[previous].form = Expression();
+        forms[previous].live = false;
+    }
+    // recorded last, as its value may read defines recorded after the
+    // one it replaces, so that they are evaluated first when it is
+    // evaluated again
+    return record(std::move(form));
+}
+
+// add id to the readers of each global exp reads
+void ReactiveGraph::scan(const Expression& exp, std::size_t id) {
+    const Atom& head = exp.head;
+    if (head.type == SymbolType) {
+        const Symbol& sym = head.value.sym_value;
+        if (is_special_form(sym) || env.isProc(sym)) {
+            return;
+        }
+        if (sym.id() >= readers.size()) {
+            readers.resize(sym.id() + 1);
+            seen.resize(sym.id() + 1, NoForm);
+        }
+        if (seen[sym.id()] != id) {
+            seen[sym.id()] = id;
+            readers[sym.id()].push_back(id);
+        }
+    }
+    else if (head.type == SharedType) {
+        scan(*head.value.shared_value, id);
+    }
+    for (const Expression& child : exp.tail) {
+        scan(child, id);
+    }
+}
+
+void ReactiveGraph::dependents(std::size_t define, std::vector<std::size_t>& ids) {
+    ids.clear();
+    listed.assign(forms.size(), false);
+    listed[define] = true;
+    dirty.assign(1, forms[define].form.tail[1].head.value.sym_value.id());
+    while (!dirty.empty()) {
+        const Symbol::Id sym = dirty.back();
+        dirty.pop_back();
+        if (sym >= readers.size()) {
+            continue;
+        }
+        for (std::size_t id : readers[sym]) {
+            if (listed[id] || !forms[id].live) {
+                continue;
+            }
+            listed[id] = true;
+            ids.push_back(id);
+            if (isDefine(id)) {
+                dirty.push_back(forms[id].form.tail[1].head.value.sym_value.id());
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+}
+
+const Expression& ReactiveGraph::form(std::size_t id) const {
+    return forms[id].form;
+}
+
+bool ReactiveGraph::isDefine(std::size_t id) const {
+    return is_valid_define(forms[id].form);
+}
+
+void ReactiveGraph::clear() {
+    ArenaScope heap(nullptr);
+    forms.clear();
+    definers.clear();
+    readers.clear();
+    seen.clear();
+}
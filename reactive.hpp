@@ -0,0 +1,101 @@
+#ifndef REACTIVE_HPP
+#define REACTIVE_HPP
+
+// system includes
+#include <cstddef>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of what a ReactiveGraph recorded and recomputed
+struct ReactiveStats {
+    // top-level defines and drawing forms recorded
+    std::size_t forms;
+    // defines that rebound a symbol bound by a recorded define
+    std::size_t redefinitions;
+    // recorded forms evaluated again as they read a symbol rebound
+    std::size_t recomputed;
+
+    ReactiveStats() : forms(0), redefinitions(0), recomputed(0) {}
+};
+
+// The graphics a recorded form, known by its id, draws now, replacing
+// all it drew before
+struct GraphicsUpdate {
+    std::size_t form;
+    std::vector<Atom> graphics;
+};
+
+// A ReactiveGraph keeps a copy of each top-level define and of each
+// top-level form that draws, as parsed, in the order they were
+// evaluated, with the globals each reads. A define of a symbol already
+// bound by a recorded define is a redefinition: the forms that read the
+// symbol, directly or through the defines that do, are its dependents,
+// to be evaluated again in the order they were recorded. Only a define
+// whose value defines nothing is recorded, so evaluating it again binds
+// only its own symbol. Reads are found in the form as parsed, the
+// parameters and locals of a form counting as reads of the globals of
+// the same names, which at worst evaluates it again needlessly.
+class ReactiveGraph {
+public:
+    // the id of no form, for a graphic drawn by a form not recorded
+    static const std::size_t NoForm = static_cast<std::size_t>(-1);
+
+    explicit ReactiveGraph(const Environment& env);
+
+    // true if form, as parsed, can be recorded once evaluated: a define
+    // whose value defines nothing, or a form that defines nothing
+    bool recordable(const Expression& form) const;
+    // true if form is a define that a recorded define bound the symbol
+    // of, set previous to the id of that define
+    bool redefines(const Expression& form, std::size_t& previous) const;
+    // record form, a copy of a recordable form as parsed, returning its
+    // id, greater than that of every form recorded before
+    std::size_t record(Expression&& form);
+    // record form, the redefinition of the define previous, in place of
+    // it, returning its id, which is that of a form recorded last
+    std::size_t replace(std::size_t previous, Expression&& form);
+
+    // set ids to the ids of the dependents of the recorded define, in order
+    void dependents(std::size_t define, std::vector<std::size_t>& ids);
+
+    // the form recorded as id, as parsed
+    const Expression& form(std::size_t id) const;
+    // true if the form recorded as id is a define
+    bool isDefine(std::size_t id) const;
+
+    // forget every form recorded
+    void clear();
+
+    const ReactiveStats& stats() const;
+    // count forms evaluated again by a redefinition
+    void recomputed(std::size_t forms);
+
+private:
+    // A form recorded, and whether a redefinition replaced it
+    struct Recorded {
+        Expression form;
+        bool live;
+    };
+
+    void scan(const Expression& exp, std::size_t id);
+
+    const Environment& env;
+    std::vector<Recorded> forms;
+    // the id of the live define of each symbol a recorded define bound,
+    // NoForm for the rest, by symbol id
+    std::vector<std::size_t> definers;
+    // the ids of the forms reading each symbol, in order, by symbol id
+    std::vector<std::vector<std::size_t> > readers;
+    // the form that last read each symbol, by symbol id, so that each
+    // reader is listed once
+    std::vector<std::size_t> seen;
+    // the forms found dependent, by id, and the symbols they rebind
+    // whose readers are yet to be found
+    std::vector<bool> listed;
+    std::vector<Symbol::Id> dirty;
+    ReactiveStats counts;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "resolver.hpp"
+
+// system includes
+#include <algorithm>
+
+namespace {
+
+// Resolves the names in scope in one expression, walking it with an
+// explicit stack of tasks as eval does, so any nesting can be resolved
+class Resolver {
+public:
+    Resolver(const Environment& env, const Atom* frame) : env(env), frame(frame), next(0), size(0) {}
+
+    void bind(const Symbol& sym);
+    void resolve(Expression& exp);
+    std::uint32_t frameSize() const { return size; }
+
+private:
+    // A name in scope: a slot of this frame, or a name bound inside a
+    // nested lambda, which hides the names outside it
+    struct Name {
+        Symbol sym;
+        std::uint32_t slot;
+        bool local;
+    };
+
+    // What is left to do, run last pushed first
+    struct Task {
+        enum Kind {
+            Visit,   // resolve exp
+            Hide,    // bring the index symbol exp into scope
+            Names,   // bring the names of the let exp into scope
+            Restore  // leave the scope opened at depth
+        };
+        Kind kind;
+        Expression* exp;
+        // inside the body of a nested lambda, where lets only hide names
+        bool inner;
+        std::size_t depth;
+        std::uint32_t next;
+    };
+
+    void push(Task::Kind kind, Expression* exp, bool inner);
+    void pushTail(Expression& exp, std::size_t first, bool inner);
+    void restoreLater();
+    void visit(Expression& exp, bool inner);
+    void visitList(Expression& exp, bool inner);
+    void visitLet(Expression& exp, bool inner);
+    void names(Expression& exp, bool inner);
+    void hide(const Symbol& sym);
+    void use(std::uint32_t slot);
+
+    const Environment& env;
+    // the values of the slots of the enclosing frame, if they are known
+    const Atom* frame;
+    std::vector<Name> scope;
+    std::vector<Task> tasks;
+    std::uint32_t next;
+    std::uint32_t size;
+};
+
+void Resolver::push(Task::Kind kind, Expression* exp, bool inner) {
+    Task task = { kind, exp, inner, 0, 0 };
+    tasks.push_back(task);
+}
+
+// visit exp.tail[first..] in order
+void Resolver::pushTail(Expression& exp, std::size_t first, bool inner) {
+    for (std::size_t i = exp.tail.size(); i > first; --i) {
+        push(Task::Visit, &exp.tail[i - 1], inner);
+    }
+}
+
+// close the scope as it is now once the tasks pushed after this are done
+void Resolver::restoreLater() {
+    Task task = { Task::Restore, nullptr, false, scope.size(), next };
+    tasks.push_back(task);
+}
+
+void Resolver::resolve(Expression& exp) {
+    push(Task::Visit, &exp, false);
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        switch (task.kind) {
+        case Task::Visit:
+            visit(*task.exp, task.inner);
+            break;
+        case Task::Hide:
+            hide(task.exp->head.value.sym_value);
+            break;
+        case Task::Names:
+            names(*task.exp, task.inner);
+            break;
+        case Task::Restore:
+            scope.resize(task.depth);
+            next = task.next;
+            break;
+        }
+    }
+}
+
+void Resolver::use(std::uint32_t slot) {
+    size = std::max(size, slot + 1);
+}
+
+void Resolver::bind(const Symbol& sym) {
+    Name name = { sym, next++, true };
+    scope.push_back(name);
+    use(name.slot);
+}
+
+void Resolver::hide(const Symbol& sym) {
+    Name name = { sym, 0, false };
+    scope.push_back(name);
+}
+
+// inner is true inside the body of a nested lambda, which has a frame
+// of its own
+void Resolver::visit(Expression& exp, bool inner) {
+    switch (exp.head.type) {
+    case SlotType:
+        if (frame != nullptr) {
+            exp = Expression(frame[exp.head.value.slot_value]);
+        }
+        else {
+            use(exp.head.value.slot_value);
+        }
+        return;
+    case SymbolType:
+        for (std::size_t i = scope.size(); i > 0; --i) {
+            const Name& name = scope[i - 1];
+            if (name.sym == exp.head.value.sym_value) {
+                if (name.local) {
+                    exp = Expression(slot_atom(name.slot));
+                }
+                return;
+            }
+        }
+        return;
+    case ListType:
+        visitList(exp, inner);
+        return;
+    case SharedType:
+        // a global it reads may be hidden here, so resolve a copy
+        if (!scope.empty() && exp.head.value.shared_value->head.value.list_info.reads_global) {
+            Expression list(*exp.head.value.shared_value);
+            exp = std::move(list);
+            visitList(exp, inner);
+        }
+        return;
+    default:
+        return;
+    }
+}
+
+void Resolver::visitList(Expression& exp, bool inner) {
+    if (exp.tail.empty()) {
+        return;
+    }
+
+    const Expression& first = exp.tail[0];
+    if (first.head.type == SymbolType) {
+        switch (first.head.value.sym_value.id()) {
+        case LambdaId:
+            // resolved against its own frame when it is made
+            if (exp.tail.size() < 2 || exp.tail[1].head.type != ListType) {
+                return;
+            }
+            restoreLater();
+            for (const Expression& param : exp.tail[1].tail) {
+                if (param.head.type == SymbolType) {
+                    hide(param.head.value.sym_value);
+                }
+            }
+            pushTail(exp, 2, true);
+            return;
+        case LetId:
+            visitLet(exp, inner);
+            return;
+        case DefineId:
+            // a define always binds a global
+            if (exp.tail.size() == 3 && exp.tail[1].head.type == SymbolType) {
+                push(Task::Visit, &exp.tail[2], inner);
+            }
+            return;
+        case ForId:
+        case MapId: {
+            // the index is a global for as long as the body runs
+            bool valid = first.head.value.sym_value.id() == ForId ? is_valid_for(exp) : is_valid_map(exp);
+            if (!valid) {
+                return;
+            }
+            Expression& range = exp.tail[1];
+            restoreLater();
+            pushTail(exp, 2, inner);
+            push(Task::Hide, &range.tail[0], inner);
+            pushTail(range, 1, inner);
+            return;
+        }
+        default:
+            break;
+        }
+    }
+
+    pushTail(exp, 0, inner);
+}
+
+void Resolver::visitLet(Expression& exp, bool inner) {
+    if (!is_valid_let(exp)) {
+        return;
+    }
+    Expression& bindings = exp.tail[1];
+
+    if (!is_resolved_let(exp)) {
+        std::vector<Symbol> names;
+        for (const Expression& binding : bindings.tail) {
+            if (binding.tail[0].head.type != SymbolType) {
+                return;
+            }
+            // builtins are resolved before locals, so cannot be hidden
+            const Symbol& sym = binding.tail[0].head.value.sym_value;
+            if (is_special_form(sym) || env.isProc(sym) || std::find(names.begin(), names.end(), sym) != names.end()) {
+                return;
+            }
+            names.push_back(sym);
+        }
+    }
+
+    // the values are evaluated before any name is in scope
+    restoreLater();
+    pushTail(exp, 2, inner);
+    push(Task::Names, &exp, inner);
+    for (std::size_t i = bindings.tail.size(); i > 0; --i) {
+        push(Task::Visit, &bindings.tail[i - 1].tail[1], inner);
+    }
+}
+
+void Resolver::names(Expression& exp, bool inner) {
+    for (Expression& binding : exp.tail[1].tail) {
+        Expression& name = binding.tail[0];
+        if (name.head.type == SlotType) {
+            // resolved before, as were the references to it
+            use(name.head.value.slot_value);
+        }
+        else if (inner) {
+            hide(name.head.value.sym_value);
+        }
+        else {
+            bind(name.head.value.sym_value);
+            name = Expression(slot_atom(scope.back().slot));
+        }
+    }
+}
+
+} // namespace
+
+std::uint32_t resolve_locals(Expression& exp, const Environment& env) {
+    Resolver resolver(env, nullptr);
+    resolver.resolve(exp);
+    return resolver.frameSize();
+}
+
+std::uint32_t resolve_lambda(Expression& body, const std::vector<Symbol>& params, const Atom* frame,
+    const Environment& env) {
+    Resolver resolver(env, frame);
+    for (const Symbol& param : params) {
+        resolver.bind(param);
+    }
+    resolver.resolve(body);
+    return resolver.frameSize();
+}
+
+std::uint32_t frame_size(const Expression& exp) {
+    std::uint32_t size = 0;
+    std::vector<const Expression*> pending(1, &exp);
+    while (!pending.empty()) {
+        const Expression* current = pending.back();
+        pending.pop_back();
+        if (current->head.type == SlotType) {
+            size = std::max(size, current->head.value.slot_value + 1);
+        }
+        for (const Expression& subexp : current->tail) {
+            pending.push_back(&subexp);
+        }
+    }
+    return size;
+}
@@ -0,0 +1,32 @@
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+// system includes
+#include <cstdint>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// The names bound by lambda and let are resolved to the slots of a flat
+// frame before they are evaluated, so evaluation never looks them up.
+// A frame holds the parameters of a call, then the locals of its lets.
+// A let that names a special form or builtin, or one name twice, is
+// left unresolved, to raise its error when evaluated.
+
+// Resolve the lets of exp, a top-level form, in place, so that their
+// names become slots of the frame exp is evaluated in. A form already
+// resolved is left as it is. Returns the size of that frame.
+std::uint32_t resolve_locals(Expression& exp, const Environment& env);
+
+// Resolve body, a copy of the body of a lambda, in place: each of
+// params and the names of its lets become slots of the frame of a call,
+// and each slot of the enclosing frame is replaced by its value there.
+// Returns the size of the frame of a call.
+std::uint32_t resolve_lambda(Expression& body, const std::vector<Symbol>& params, const Atom* frame,
+    const Environment& env);
+
+// the size of the frame a resolved exp is evaluated in
+std::uint32_t frame_size(const Expression& exp);
+
+#endif
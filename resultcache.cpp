@@ -0,0 +1,49 @@
+#include "resultcache.hpp"
+
+ResultCache::ResultCache(std::size_t capacity) : limit(capacity) {
+}
+
+void ResultCache::setCapacity(std::size_t capacity) {
+    limit = capacity;
+    while (entries.size() > limit) {
+        index.erase(entries.back().list);
+        entries.pop_back();
+    }
+}
+
+bool ResultCache::find(const Expression* list, std::uint32_t generation, Atom& value) {
+    auto found = index.find(list);
+    if (found == index.end() || found->second->generation != generation) {
+        ++counts.misses;
+        return false;
+    }
+    ++counts.hits;
+    entries.splice(entries.begin(), entries, found->second);
+    value = found->second->value;
+    return true;
+}
+
+void ResultCache::insert(const Expression* list, std::uint32_t generation, const Atom& value) {
+    if (limit == 0) {
+        return;
+    }
+    auto found = index.find(list);
+    if (found != index.end()) {
+        // left from an earlier generation
+        found->second->generation = generation;
+        found->second->value = value;
+        entries.splice(entries.begin(), entries, found->second);
+        return;
+    }
+    if (entries.size() == limit) {
+        index.erase(entries.back().list);
+        entries.pop_back();
+    }
+    Entry entry = { list, generation, value };
+    entries.push_front(entry);
+    index[list] = entries.begin();
+}
+
+const ResultCacheStats& ResultCache::stats() const {
+    return counts;
+}
@@ -0,0 +1,61 @@
+#ifndef RESULTCACHE_HPP
+#define RESULTCACHE_HPP
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// module includes
+#include "expression.hpp"
+
+// How often a ResultCache had the value of a list being evaluated
+struct ResultCacheStats {
+    std::size_t hits;
+    std::size_t misses;
+
+    ResultCacheStats() : hits(0), misses(0) {}
+};
+
+// A ResultCache remembers the values of lists kept by a HashConser,
+// which are pure: calls of builtins on literals, globals that can never
+// be bound to another value and other such lists. A value is only used
+// in the Environment generation it was computed in, so none outlives
+// an Environment::init(). Lists that raise an error are never cached.
+// At most capacity values are kept, dropping the least recently used.
+class ResultCache {
+public:
+    explicit ResultCache(std::size_t capacity);
+
+    // 0 turns the cache off, forgetting every value
+    void setCapacity(std::size_t capacity);
+    std::size_t capacity() const { return limit; }
+
+    // set value to the value of list computed in generation, if known
+    bool find(const Expression* list, std::uint32_t generation, Atom& value);
+    void insert(const Expression* list, std::uint32_t generation, const Atom& value);
+
+    const ResultCacheStats& stats() const;
+
+private:
+    struct Entry {
+        const Expression* list;
+        std::uint32_t generation;
+        Atom value;
+    };
+    typedef std::list<Entry> EntryList;
+
+    // a list kept by a HashConser is found by the structural hash it caches
+    struct ListHash {
+        std::size_t operator()(const Expression* list) const { return list->head.value.list_info.hash; }
+    };
+
+    std::size_t limit;
+    // the most recently used first
+    EntryList entries;
+    std::unordered_map<const Expression*, EntryList::iterator, ListHash> index;
+    ResultCacheStats counts;
+};
+
+#endif
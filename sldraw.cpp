@@ -6,21 +6,58 @@
 
 #include "main_window.hpp"
 
+void usage() {
+  std::cerr << "Usage: sldraw [--vm | --closure] [--cache] [--dead-code] [--reactive] [file]" << std::endl;
+  std::cerr << "  --vm        compile to bytecode and run it on the virtual machine" << std::endl;
+  std::cerr << "  --closure   compile to a tree of pre-resolved closures and run that" << std::endl;
+  std::cerr << "  --cache     share repeated calls of builtins on constants and remember their values across REPL lines" << std::endl;
+  std::cerr << "  --dead-code skip the defines of the file that nothing in it uses, reading it whole" << std::endl;
+  std::cerr << "  --reactive  let a REPL define rebind a symbol the file defines, redrawing what reads it" << std::endl;
+}
+
 int main(int argc, char *argv[])
 {
   QApplication app(argc, argv);
 
   std::string filename;
+  MainWindowOptions options;
+
+  // leading options select how the file and REPL lines are evaluated
+  int arg = 1;
+  for(; arg < argc && std::string(argv[arg]).compare(0, 2, "--") == 0; ++arg){
+    std::string option(argv[arg]);
+    if(option == "--vm"){
+      options.mode = Interpreter::BytecodeEval;
+    }
+    else if(option == "--closure"){
+      options.mode = Interpreter::ClosureEval;
+    }
+    else if(option == "--cache"){
+      options.cache = true;
+    }
+    else if(option == "--dead-code"){
+      options.eliminate = true;
+    }
+    else if(option == "--reactive"){
+      options.reactive = true;
+    }
+    else{
+      std::cerr << "Error: Unknown option: " << option << std::endl;
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
 
-  if(argc == 2){
-    filename = argv[1];
+  if(argc - arg == 1){
+    filename = argv[arg];
   }
-  if(argc > 2){
+  if(argc - arg > 1){
     std::cerr << "Error: invalid number of arguments to sldraw" << std::endl;
+    usage();
     return EXIT_FAILURE;
   }
 
-  MainWindow w(filename);
+  MainWindow w(filename, options);
   w.setMinimumSize(800,600);
   w.show();
 
@@ -8,45 +8,149 @@
 #include "interpreter_semantic_error.hpp"
 #include <cstdlib>
 
+// run a whole program text and print its value, and nothing else unless
+// --dump-ast, which also reports the defines eliminated, is given
+int runProgram(Interpreter& interpreter, std::istream& program, const std::string& source) {
+    if (interpreter.parse(program)) {
+        Expression result = interpreter.eval();
+        std::cout << "(" << result << ")" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    std::cerr << "Error: Failed to parse the program from the " << source << "." << std::endl;
+    return EXIT_FAILURE;
+}
+
+// run a program one form at a time in bounded memory and print its value
+int streamProgram(Interpreter& interpreter, std::istream& program) {
+    // slisp never renders graphics, so drop them as each form completes
+    Expression result = interpreter.evalStream(program, [&interpreter](const Expression&) {
+        interpreter.clearGraphics();
+    });
+    std::cout << "(" << result << ")" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+void usage() {
+    std::cerr << "Usage: slisp [--stream] [--vm | --closure] [--optimize] [--typecheck] [--hash-cons] [--result-cache n] [--keep-dead-code] [--cse] [--lazy-define | --lazy-define-errors] [--reactive] [--dump-ast] [--max-depth n] [-e program | file]" << std::endl;
+    std::cerr << "  --stream  evaluate each top-level form as it is read, file may be - for stdin" << std::endl;
+    std::cerr << "  --vm      compile to bytecode and run it on the virtual machine" << std::endl;
+    std::cerr << "  --closure compile to a tree of pre-resolved closures and run that" << std::endl;
+    std::cerr << "  --optimize fold constant expressions and propagate defined constants" << std::endl;
+    std::cerr << "  --typecheck report type errors before they are reached and evaluate proven arithmetic unboxed" << std::endl;
+    std::cerr << "  --hash-cons parse repeated calls of builtins on constants into one shared copy" << std::endl;
+    std::cerr << "  --result-cache n remember up to n values of the calls shared by --hash-cons across REPL lines" << std::endl;
+    std::cerr << "  --keep-dead-code evaluate the defines of a program that nothing uses, which are skipped otherwise" << std::endl;
+    std::cerr << "  --cse     compute the pure calls a form repeats once, into hidden temporaries" << std::endl;
+    std::cerr << "  --lazy-define evaluate the value of a define that cannot fail and is not the last form of a body when first read" << std::endl;
+    std::cerr << "  --lazy-define-errors as --lazy-define, for any call of builtins, raising its errors when read" << std::endl;
+    std::cerr << "  --reactive let a top-level define rebind a symbol a top-level define bound, evaluating again what reads it" << std::endl;
+    std::cerr << "  --dump-ast print each form as evaluated, and what was folded, eliminated and hoisted, to stderr" << std::endl;
+    std::cerr << "  --max-depth n fail to parse lists nested deeper than n, default " << Interpreter::DEFAULT_MAX_NESTING << std::endl;
+}
+
 int main(int argc, char** argv) {
     // Interpreter init
     Interpreter interpreter;
 
+    // Leading options select how a program is run
+    bool stream = false;
+    bool eliminate = true;
+    int arg = 1;
+    for (; arg < argc && std::string(argv[arg]).compare(0, 2, "--") == 0; ++arg) {
+        std::string option(argv[arg]);
+        if (option == "--stream") {
+            stream = true;
+        }
+        else if (option == "--vm") {
+            interpreter.setEvalMode(Interpreter::BytecodeEval);
+        }
+        else if (option == "--closure") {
+            interpreter.setEvalMode(Interpreter::ClosureEval);
+        }
+        else if (option == "--optimize") {
+            interpreter.setOptimizeEnabled(true);
+        }
+        else if (option == "--typecheck") {
+            interpreter.setTypeCheckEnabled(true);
+            interpreter.setTypeErrorReport(&std::cerr);
+        }
+        else if (option == "--hash-cons") {
+            interpreter.setHashConsEnabled(true);
+        }
+        else if (option == "--result-cache" && arg + 1 < argc) {
+            interpreter.setResultCacheCapacity(std::strtoul(argv[++arg], nullptr, 10));
+        }
+        else if (option == "--keep-dead-code") {
+            eliminate = false;
+        }
+        else if (option == "--cse") {
+            interpreter.setCseEnabled(true);
+        }
+        else if (option == "--lazy-define") {
+            interpreter.setDefineMode(Environment::LazyDefine);
+        }
+        else if (option == "--lazy-define-errors") {
+            interpreter.setDefineMode(Environment::LazyDefineDeferErrors);
+        }
+        else if (option == "--reactive") {
+            interpreter.setReactiveEnabled(true);
+        }
+        else if (option == "--dump-ast") {
+            interpreter.setAstDump(&std::cerr);
+        }
+        else if (option == "--max-depth" && arg + 1 < argc) {
+            interpreter.setMaxNesting(std::strtoul(argv[++arg], nullptr, 10));
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << option << std::endl;
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    int remaining = argc - arg;
+    // a whole program has no later lines that could use a define it
+    // does not, unlike the REPL
+    interpreter.setDeadCodeEnabled(eliminate && remaining != 0);
+
     try {
-        if (argc == 3 && std::string(argv[1]) == "-e") {
-            std::string programText = std::string(argv[2]);
+        if (remaining == 2 && std::string(argv[arg]) == "-e") {
+            std::string programText = std::string(argv[arg + 1]);
 
             std::istringstream programStream(programText);
 
-            if (interpreter.parse(programStream)) {
-                Expression result = interpreter.eval();
-                std::cout << "(" << result << ")" << std::endl;
-                return EXIT_SUCCESS;
+            if (stream) {
+                return streamProgram(interpreter, programStream);
             }
-            std::cerr << "Error: Failed to parse the program from the command line." << std::endl;
-            return EXIT_FAILURE;
+            return runProgram(interpreter, programStream, "command line");
         }
-        else if (argc == 2) {
+        else if (remaining == 1) {
+            if (stream && std::string(argv[arg]) == "-") {
+                return streamProgram(interpreter, std::cin);
+            }
+
             // Execute program from file
-            std::ifstream inputFile(argv[1]);
+            std::ifstream inputFile(argv[arg]);
             if (!inputFile) {
-                std::cerr << "Error: Failed to open file: " << argv[1] << std::endl;
+                std::cerr << "Error: Failed to open file: " << argv[arg] << std::endl;
                 return EXIT_FAILURE;
             }
 
-            if (interpreter.parse(inputFile)) {
-                Expression result = interpreter.eval();
-                std::cout << "(" << result << ")" << std::endl;
-                return EXIT_SUCCESS;
+            if (stream) {
+                return streamProgram(interpreter, inputFile);
             }
-            std::cerr << "Error: Failed to parse the program from the file." << std::endl;
+            return runProgram(interpreter, inputFile, "file");
+        }
+        else if (remaining != 0) {
+            usage();
             return EXIT_FAILURE;
         }
         // Interactive mode with REPL
         while (true) {
             std::cout << "slisp> ";
             std::string input;
-            std::getline(std::cin, input);
+            if (!std::getline(std::cin, input)) {
+                break; // Exit REPL at end of input
+            }
             if (input == "quit" || input == "exit") {
                 break; // Exit REPL if "quit" or "exit" is entered
             }
@@ -0,0 +1,137 @@
+#include "symbol.hpp"
+
+// system includes
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const Symbol::Id EMPTY_SLOT = std::numeric_limits<Symbol::Id>::max();
+
+// names of the special forms, in SpecialFormId order
+const char* const SPECIAL_FORM_NAMES[] = { "", "define", "begin", "if", "draw", "for", "repeat", "map", "lambda", "and", "or", "let", "cond" };
+
+static_assert(sizeof(SPECIAL_FORM_NAMES) / sizeof(SPECIAL_FORM_NAMES[0]) == SpecialFormCount,
+    "SPECIAL_FORM_NAMES must list every SpecialFormId");
+
+// FNV-1a
+std::uint32_t hashName(const char* data, std::size_t length) {
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < length; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+} // namespace
+
+Symbol::Symbol(const std::string& name)
+    : id_(SymbolTable::global().intern(name.data(), name.size())) {
+}
+
+Symbol::Symbol(const char* name)
+    : id_(SymbolTable::global().intern(name, std::strlen(name))) {
+}
+
+Symbol::Symbol(const char* data, std::size_t length)
+    : id_(SymbolTable::global().intern(data, length)) {
+}
+
+Symbol Symbol::fromId(Id id) {
+    Symbol sym;
+    sym.id_ = id;
+    return sym;
+}
+
+const std::string& Symbol::name() const {
+    return SymbolTable::global().name(id_);
+}
+
+bool is_special_form(const Symbol& sym) {
+    return sym.id() > NoSymbolId && sym.id() < SpecialFormCount;
+}
+
+bool operator==(const Symbol& sym, const std::string& name) {
+    return sym.name() == name;
+}
+
+bool operator==(const std::string& name, const Symbol& sym) {
+    return sym.name() == name;
+}
+
+bool operator==(const Symbol& sym, const char* name) {
+    return sym.name() == name;
+}
+
+bool operator==(const char* name, const Symbol& sym) {
+    return sym.name() == name;
+}
+
+bool operator!=(const Symbol& sym, const std::string& name) {
+    return !(sym == name);
+}
+
+bool operator!=(const Symbol& sym, const char* name) {
+    return !(sym == name);
+}
+
+std::ostream& operator<<(std::ostream& out, const Symbol& sym) {
+    return out << sym.name();
+}
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::SymbolTable() : buckets(64, EMPTY_SLOT) {
+    for (const char* name : SPECIAL_FORM_NAMES) {
+        intern(name, std::strlen(name));
+    }
+}
+
+Symbol::Id SymbolTable::intern(const char* data, std::size_t length) {
+    std::uint32_t h = hashName(data, length);
+    std::size_t mask = buckets.size() - 1;
+
+    for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+        Symbol::Id id = buckets[i];
+        if (id == EMPTY_SLOT) {
+            id = static_cast<Symbol::Id>(names.size());
+            names.emplace_back(data, length);
+            hashes.push_back(h);
+            buckets[i] = id;
+            // keep the load factor at or below one half
+            if (2 * names.size() > buckets.size()) {
+                grow();
+            }
+            return id;
+        }
+        if (hashes[id] == h && names[id].size() == length &&
+            std::memcmp(names[id].data(), data, length) == 0) {
+            return id;
+        }
+    }
+}
+
+const std::string& SymbolTable::name(Symbol::Id id) const {
+    return names[id];
+}
+
+std::size_t SymbolTable::size() const {
+    return names.size();
+}
+
+void SymbolTable::grow() {
+    std::vector<Symbol::Id> bigger(2 * buckets.size(), EMPTY_SLOT);
+    std::size_t mask = bigger.size() - 1;
+    for (Symbol::Id id = 0; id < names.size(); ++id) {
+        std::size_t i = hashes[id] & mask;
+        while (bigger[i] != EMPTY_SLOT) {
+            i = (i + 1) & mask;
+        }
+        bigger[i] = id;
+    }
+    buckets.swap(bigger);
+}
@@ -0,0 +1,96 @@
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A Symbol is an interned name. Each distinct name is stored once in the
+// global SymbolTable and a Symbol holds only its dense integer id, so
+// symbols copy, compare and hash as integers.
+class Symbol {
+public:
+  typedef std::uint32_t Id;
+
+  // the empty symbol
+  Symbol(): id_(0) {}
+
+  // intern name, only allocates the first time a name is seen
+  Symbol(const std::string & name);
+  Symbol(const char * name);
+  Symbol(const char * data, std::size_t length);
+
+  static Symbol fromId(Id id);
+
+  Id id() const { return id_; }
+  const std::string & name() const;
+
+  bool operator==(const Symbol & sym) const { return id_ == sym.id_; }
+  bool operator!=(const Symbol & sym) const { return id_ != sym.id_; }
+  bool operator<(const Symbol & sym) const { return id_ < sym.id_; }
+
+private:
+  Id id_;
+};
+
+// The special forms are interned first, in this order, so the evaluator
+// can dispatch on their ids directly
+enum SpecialFormId : Symbol::Id {
+  NoSymbolId = 0,
+  DefineId,
+  BeginId,
+  IfId,
+  DrawId,
+  ForId,
+  RepeatId,
+  MapId,
+  LambdaId,
+  AndId,
+  OrId,
+  LetId,
+  CondId,
+  SpecialFormCount
+};
+
+// true if sym names a special form
+bool is_special_form(const Symbol & sym);
+
+// compare a symbol against a name without interning the name
+bool operator==(const Symbol & sym, const std::string & name);
+bool operator==(const std::string & name, const Symbol & sym);
+bool operator==(const Symbol & sym, const char * name);
+bool operator==(const char * name, const Symbol & sym);
+bool operator!=(const Symbol & sym, const std::string & name);
+bool operator!=(const Symbol & sym, const char * name);
+
+std::ostream & operator<<(std::ostream & out, const Symbol & sym);
+
+// The SymbolTable maps names to dense ids using open addressing.
+// It is a process-wide singleton and is not thread safe.
+class SymbolTable {
+public:
+  static SymbolTable & global();
+
+  Symbol::Id intern(const char * data, std::size_t length);
+  const std::string & name(Symbol::Id id) const;
+  std::size_t size() const;
+
+private:
+  SymbolTable();
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable & operator=(const SymbolTable &) = delete;
+
+  void grow();
+
+  // names indexed by id, deque so references stay valid
+  std::deque<std::string> names;
+  std::vector<std::uint32_t> hashes;
+  // hash buckets holding ids, EMPTY_SLOT when unused
+  std::vector<Symbol::Id> buckets;
+};
+
+#endif
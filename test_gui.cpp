@@ -28,6 +28,7 @@ private slots:
   void cleanupTestCase();
   void testCanvasAddGraphic();
   void testCanvasClear();
+  void testCanvasRemoveGraphic();
   void testCanvasDrawLine();
   void testCanvasDrawPoint();
   void testQGraphicsArcItemPainting();
@@ -39,6 +40,7 @@ private slots:
   void testStoreGraphics();
   void testQtInterpreterParsingAndEvaluating();
   void testQtInterpreterOperatorsAndFunctions();
+  void testQtInterpreterReactive();
   
 private:
   MainWindow w;
@@ -272,6 +274,22 @@ void TestGUI::testCanvasClear() {
     QVERIFY2(scene->items().isEmpty(), "Expected the scene to be empty after clearing.");
 }
 
+void TestGUI::testCanvasRemoveGraphic() {
+    QVERIFY(canvas && scene);
+
+    // Add two items to the canvas, then remove the first
+    QGraphicsItem* removed = new QGraphicsEllipseItem(0, 0, 50, 50);
+    QGraphicsItem* kept = new QGraphicsEllipseItem(100, 100, 50, 50);
+    canvas->addGraphic(removed);
+    canvas->addGraphic(kept);
+    canvas->removeGraphic(removed);
+
+    // Check that only the second item is left in the scene
+    QVERIFY2(scene->items().contains(kept), "Expected the kept item to be present in the scene.");
+    QCOMPARE(scene->items().size(), 1);
+    canvas->clear();
+}
+
 void TestGUI::testCanvasDrawLine() {
     QVERIFY(canvas && scene);
 
@@ -468,5 +486,30 @@ void TestGUI::testQtInterpreterOperatorsAndFunctions() {
     QCOMPARE(static_cast<int>(qtInterpreter.getGraphicsVector().size()), 7);
 }
 
+void TestGUI::testQtInterpreterReactive() {
+    qRegisterMetaType<QGraphicsItem*>("QGraphicsItem*");
+    QtInterpreter qtInterpreter;
+    qtInterpreter.setReactiveEnabled(true);
+    QSignalSpy drawn(&qtInterpreter, &QtInterpreter::drawGraphic);
+    QSignalSpy removed(&qtInterpreter, &QtInterpreter::removeGraphic);
+
+    qtInterpreter.parseAndEvaluate("(begin (define radius 5) (define other 1))");
+    qtInterpreter.parseAndEvaluate("(draw (point radius 0) (point 0 radius))");
+    qtInterpreter.parseAndEvaluate("(draw (point other 0))");
+    QCOMPARE(drawn.count(), 3);
+    QCOMPARE(removed.count(), 0);
+
+    // only the items of the form reading radius are replaced
+    qtInterpreter.parseAndEvaluate("(define radius 10)");
+    QCOMPARE(drawn.count(), 5);
+    QCOMPARE(removed.count(), 2);
+    QCOMPARE(static_cast<int>(qtInterpreter.getReactiveStats().recomputed), 1);
+
+    // a redefinition raising an error changes nothing
+    qtInterpreter.parseAndEvaluate("(define radius (point 1 1))");
+    QCOMPARE(drawn.count(), 5);
+    QCOMPARE(removed.count(), 2);
+}
+
 QTEST_MAIN(TestGUI)
 #include "test_gui.moc"
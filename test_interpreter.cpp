@@ -4,6 +4,9 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <algorithm>
 
 #include "interpreter_semantic_error.hpp"
 #include "interpreter.hpp"
@@ -155,6 +158,29 @@ TEST_CASE( "Test Interpreter parser with bad number string", "[interpreter]" ) {
   REQUIRE(ok == false);
 }
 
+TEST_CASE( "Test Interpreter parser with out of range number", "[interpreter]" ) {
+
+  std::string program = "(+ 1e999 1)";
+  std::istringstream iss(program);
+
+  Interpreter interp;
+
+  REQUIRE(interp.parse(iss) == false);
+
+  // the range is reported rather than a generic invalid token
+  std::istringstream stream(program);
+  std::string message;
+  try{
+    interp.evalStream(stream);
+  }
+  catch(const InterpreterSemanticError & e){
+    message = e.what();
+  }
+  REQUIRE(message == "Error: Number out of range: 1e999");
+  REQUIRE_THROWS_WITH(interp.atom("-1e999"), "Error: Number out of range: -1e999");
+  REQUIRE_THROWS_WITH(interp.atom("1abc"), "Error: Invalid token:1abc");
+}
+
 TEST_CASE( "Test Interpreter parser with incorrect input. Regression Test", "[interpreter]" ) {
 
   std::string program = "(+ 1 2) (+ 3 4)";
@@ -363,6 +389,7 @@ TEST_CASE( "Test some semantically invalid expresions", "[interpreter]" ) {
   std::vector<std::string> programs = {"(@ none)", // so such procedure
 				       "(- 1 1 2)", // too many arguments
 				       "(define if 1)", // redefine special form
+				       "(define draw 1)", // redefine special form
 				       "(define pi 3.14)"}; // redefine builtin symbol
     for(auto s : programs){
       Interpreter interp;
@@ -460,3 +487,1003 @@ TEST_CASE( "Test all syntactically and semantically CORRECT files.", "[interpret
     REQUIRE(result == expected_result);
   }
 }
+
+TEST_CASE( "Test streaming evaluation", "[interpreter]" ) {
+
+  {
+    std::istringstream iss("(begin (define a 1) (draw (point a a)) (+ a 2)) (draw (point 0 0)) (* 2 3)");
+    Interpreter interp;
+    int forms = 0;
+    Expression result = interp.evalStream(iss, [&forms](const Expression &){ ++forms; });
+    REQUIRE(result == Expression(6.));
+    REQUIRE(forms == 5);
+    REQUIRE(interp.getGraphicsVector().size() == 2);
+  }
+
+  {
+    std::string fname = TEST_FILE_DIR + "/test4.slp";
+    std::ifstream ifs(fname);
+    Interpreter interp;
+    REQUIRE(interp.evalStream(ifs) == runfile(fname));
+  }
+
+  std::vector<std::string> programs = {"", "hello", "(+ 1 2))", "(begin (+ 1 2)", "(+ 1 True)"};
+  for(auto s : programs){
+    std::istringstream iss(s);
+    Interpreter interp;
+    REQUIRE_THROWS_AS(interp.evalStream(iss), InterpreterSemanticError);
+  }
+}
+
+TEST_CASE( "Test evaluating a program in place", "[interpreter]" ) {
+
+  {
+    // eval reads the program without moving from it, so it can be evaluated again
+    std::istringstream iss("(begin (define p (point 1 2)) (draw p (line p (point 3 4))) "
+      "((lambda (x) (+ x 1)) (- 4 2)))");
+    TokenSequenceType tokens = tokenize(iss);
+    Interpreter interp;
+    const Expression program = interp.read_from_tokens(tokens);
+    const Expression parsed = program;
+    REQUIRE(interp.eval(program) == Expression(3.));
+    REQUIRE(program == parsed);
+
+    Interpreter again;
+    REQUIRE(again.eval(program) == Expression(3.));
+    REQUIRE(program == parsed);
+
+    // draw keeps the values it was given
+    for(auto graphics : {&interp.getGraphicsVector(), &again.getGraphicsVector()}){
+      REQUIRE(graphics->size() == 2);
+      REQUIRE(Expression((*graphics)[0]) == Expression(std::make_tuple(1., 2.)));
+      REQUIRE(Expression((*graphics)[1]) == Expression(std::make_tuple(1., 2.), std::make_tuple(3., 4.)));
+    }
+  }
+
+  {
+    // builtins take and return Atoms, and a define binds the value it is given
+    Environment env;
+    ArgList args;
+    args.push_back(number_atom(1));
+    args.push_back(number_atom(2));
+    REQUIRE(Expression(env.getProc("+")(args)) == Expression(3.));
+    REQUIRE(Expression(env.getProc("point")(args)) == Expression(std::make_tuple(1., 2.)));
+    env.addExp("p", Expression(point_atom(1, 2)));
+    REQUIRE(env.getExp("p") == Expression(std::make_tuple(1., 2.)));
+    REQUIRE(&env.getExp("p") == &env.getExp("p"));
+  }
+}
+
+// the passes runMode enables, all off by default
+struct RunOptions {
+  bool optimize;
+  bool typecheck;
+  // with a result cache small enough to evict
+  bool hashcons;
+  bool deadcode;
+  bool cse;
+
+  RunOptions() : optimize(false), typecheck(false), hashcons(false), deadcode(false), cse(false) {}
+};
+
+// the result, or error, and graphics of program in the given mode
+std::string runMode(const std::string & program, Interpreter::EvalMode mode, const RunOptions & options = RunOptions()){
+
+  std::istringstream iss(program);
+  Interpreter interp;
+  interp.setEvalMode(mode);
+  interp.setOptimizeEnabled(options.optimize);
+  interp.setTypeCheckEnabled(options.typecheck);
+  interp.setHashConsEnabled(options.hashcons);
+  interp.setDeadCodeEnabled(options.deadcode);
+  interp.setCseEnabled(options.cse);
+  interp.setResultCacheCapacity(options.hashcons ? 2 : 0);
+
+  std::ostringstream out;
+  try{
+    if(interp.parse(iss)){
+      out << interp.eval();
+    }
+  }
+  catch(const InterpreterSemanticError & e){
+    out << e.what();
+  }
+  for(auto & graphic : interp.getGraphicsVector()){
+    out << " " << Expression(graphic);
+  }
+  return out.str();
+}
+
+TEST_CASE( "Test bytecode and closure evaluation agree with tree evaluation", "[interpreter]" ) {
+
+  std::vector<std::string> programs = {
+    "(+ 1 2 3)", "(+)", "(+ 1 True)", "(- 5)", "(- 4 2)", "(- 1 2 3)",
+    "(* 2 3 4)", "(/ 1 2)", "(/ 1 0)", "(< 1 2)", "(>= 1 True)", "(= 1 1)",
+    "(begin)", "(begin 1 2 3)", "(if True 1 2)", "(if False 1 2)", "(if 1 2 3)",
+    "(if (< 1 2) (+ 1 1) (undefined))", "(begin (define a 3) (a 4 5))",
+    "(begin (define a 1) (define a 2))", "(define pi 3)", "(define if 1)",
+    "(begin (draw (point 1 1)) (define 5 1))", "(draw)", "(draw 1)",
+    "(draw (point 1 2) (line (point 0 0) (point 1 1)))", "(1 2 3)", "((+ 1 2))",
+    "(foo 1)", "(begin foo)", "(+ +)", "(not 1)", "(sin pi)", "(log10 0)",
+    "(begin (define r 5) (draw (arc (point 0 0) (point r 0) (* 2 pi))) r)",
+    "(begin (define x 1) (if (> x 0) (define y 2) (define z 3)) z)",
+    "(begin (if False (define a 1) 0) a)", "(begin (1 (define a 2)) a)",
+    "(begin (define a pi) (define b (* 2 a)) (a b))", "(+ (define v 1) v)",
+    "(begin (define a 2) (define b (/ a 0)) (define c (+ a 1)) 7)",
+    "(begin (define u (point 1 2)) (define v (line u u)) (define w (range 1 5 0)) 3)",
+    "(begin (define f (lambda (x) x)) (define g (lambda (y) y)) g)",
+    "(begin (define a 3) (+ (* a 2) (* a 2)) (define b (* a 2)) (+ b (* a 2) (* b 3) (* b 3)))",
+    "(for (i 0 4) (for (j 0 3) (draw (point (+ i j) (* i 2)) (point (+ i j) (* i 2)) (point (* i 2) j))))",
+    "(let ((x 2) (y 3)) (let ((x (+ y 1))) (+ (* x y) (* x y))) (+ (* x y) (* x y)))",
+    "(begin (define a 0) (+ (/ 1 a) (/ 1 a)))", "(begin (define a 2) (+ (* a 2) (* a 2)) (foo) (* a 2))",
+    "(begin (define p 2) (draw (map (k (range 0 3)) (line (point (* k p) k) (point (* k p) p)))) (* k p))",
+    "(begin (define a (draw (point 0 0))) a)", "(begin (define a (draw (point 0 0))) (a 1))",
+    "(begin (define a (begin)) (define b (cond (False 1))) (define c (for (i 0 0) i)) (+ (* 2 a) (* 2 a)))"};
+
+  for(int i = 2; i <= 5; ++i){
+    std::ifstream ifs(TEST_FILE_DIR + "/test" + std::to_string(i) + ".slp");
+    programs.push_back(std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()));
+  }
+
+  RunOptions optimize;
+  optimize.optimize = true;
+  RunOptions typecheck;
+  typecheck.typecheck = true;
+  // the passes run with each backend, alone and together
+  std::vector<RunOptions> passes(7);
+  passes[0].hashcons = true;
+  passes[1].optimize = passes[1].hashcons = true;
+  passes[2].typecheck = passes[2].hashcons = true;
+  passes[3].deadcode = true;
+  passes[4].optimize = passes[4].hashcons = passes[4].deadcode = true;
+  passes[5].cse = true;
+  passes[6].optimize = passes[6].typecheck = passes[6].hashcons = passes[6].deadcode = passes[6].cse = true;
+
+  for(auto s : programs){
+    INFO(s);
+    std::string expected = runMode(s, Interpreter::TreeEval);
+    REQUIRE(runMode(s, Interpreter::BytecodeEval) == expected);
+    REQUIRE(runMode(s, Interpreter::ClosureEval) == expected);
+    REQUIRE(runMode(s, Interpreter::TreeEval, optimize) == expected);
+    REQUIRE(runMode(s, Interpreter::BytecodeEval, optimize) == expected);
+    REQUIRE(runMode(s, Interpreter::TreeEval, typecheck) == expected);
+    REQUIRE(runMode(s, Interpreter::BytecodeEval, typecheck) == expected);
+    REQUIRE(runMode(s, Interpreter::ClosureEval, typecheck) == expected);
+    for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+      for(auto & options : passes){
+        REQUIRE(runMode(s, mode, options) == expected);
+      }
+    }
+  }
+
+  for(auto mode : {Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    std::istringstream iss("(begin (define a 1) (draw (point a a)) (+ a 2)) (* 2 3)");
+    Interpreter interp;
+    interp.setEvalMode(mode);
+    REQUIRE(interp.evalStream(iss) == Expression(6.));
+    REQUIRE(interp.getGraphicsVector().size() == 1);
+  }
+}
+
+TEST_CASE( "Test defines whose value is None", "[interpreter]" ) {
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    const std::string none = runMode("(begin)", mode);
+    REQUIRE(runMode("(begin (define a (draw (point 0 0))) a)", mode) == none + " (0,0)");
+    REQUIRE(runMode("(begin (define a (draw (point 0 0))) (a 1))", mode) == none + " (0,0)");
+    REQUIRE(runMode("(begin (define a (begin)) a)", mode) == none);
+    REQUIRE(runMode("(begin (define a (cond (False 1))) a)", mode) == none);
+    REQUIRE(runMode("(begin (define a (for (i 0 0) i)) a)", mode) == none);
+    REQUIRE(runMode("(begin (define a (begin)) (define a 1))", mode) == runMode("(begin (define a 1) (define a 2))", mode));
+
+    // read by a later program
+    Interpreter interp;
+    interp.setEvalMode(mode);
+    std::istringstream define("(define a (begin))");
+    REQUIRE(interp.parse(define));
+    REQUIRE(interp.eval() == Expression());
+    std::istringstream read("(begin a)");
+    REQUIRE(interp.parse(read));
+    REQUIRE(interp.eval() == Expression());
+  }
+}
+
+TEST_CASE( "Test for and repeat loops", "[interpreter]" ) {
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    REQUIRE(runMode("(for (i 0 5) (+ i 10))", mode) == "14");
+    REQUIRE(runMode("(for (i 4 0 -2) (draw (point i 0)) i)", mode) == "2 (4,0) (2,0)");
+    REQUIRE(runMode("(repeat 3 (draw (point 1 1)))", mode) == "None (1,1) (1,1) (1,1)");
+    REQUIRE(runMode("(for (i 0 0) i)", mode) == "None");
+    REQUIRE(runMode("(begin (define n 3) (for (i 0 n) (for (j 0 n) (* i j))))", mode) == "4");
+    REQUIRE(runMode("(begin (for (i 0 2) i) (for (i 0 3) i))", mode) == "2");
+    REQUIRE(runMode("(for (i 0 3) (define x i))", mode) == "Error: Invalid define Symbol.");
+    REQUIRE(runMode("(for (i 0 3 0) i)", mode) == "Error: 'for' step must not be zero.");
+    REQUIRE(runMode("(for (i 0 True) i)", mode) == "Error: 'for' range must evaluate to Numbers.");
+    REQUIRE(runMode("(repeat False 1)", mode) == "Error: 'repeat' count must evaluate to a Number.");
+    REQUIRE(runMode("(for (pi 0 3) 1)", mode) == "Error: Invalid 'for' Symbol.");
+    REQUIRE(runMode("(for (i 0 3))", mode) == "Error: Invalid 'for' syntax.");
+    REQUIRE(runMode("(repeat 3)", mode) == "Error: Invalid 'repeat' syntax.");
+
+    // the index is released when the body raises an error
+    std::istringstream first("(for (i 0 3) (/ 1 i))");
+    Interpreter interp;
+    interp.setEvalMode(mode);
+    REQUIRE(interp.parse(first));
+    REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+    std::istringstream second("(define i 7)");
+    REQUIRE(interp.parse(second));
+    REQUIRE(interp.eval() == Expression(7.));
+  }
+}
+
+TEST_CASE( "Test ranges drawn lazily with map", "[interpreter]" ) {
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    REQUIRE(runMode("(range 2 8 3)", mode) == "(range 2 8 3)");
+    REQUIRE(runMode("(range 4)", mode) == "(range 0 4 1)");
+    REQUIRE(runMode("(draw (point 5 5) (map (t (range 3)) (point t (* t t))) (point 6 6))", mode) ==
+      "None (5,5) (0,0) (1,1) (2,4) (6,6)");
+    REQUIRE(runMode("(begin (define r (range 1 0 -0.5)) (draw (map (t r) (line (point t 0) (point 0 t)))) r)",
+      mode) == "(range 1 0 -0.5) ((1,0),(0,1)) ((0.5,0),(0,0.5))");
+    REQUIRE(runMode("(draw (map (t (range 0)) (point t t)))", mode) == "None");
+    REQUIRE(runMode("(range 0 1 0)", mode) == "range failed, step is zero");
+    REQUIRE(runMode("(map (t (range 3)) (point t t))", mode) ==
+      "Error: 'map' is only valid as an argument of 'draw'.");
+    REQUIRE(runMode("(draw (map (t 3) (point t t)))", mode) == "Error: 'map' sequence must evaluate to a Range.");
+    REQUIRE(runMode("(draw (map (t (range 3)) t))", mode) == "Error: Invalid(non-graphic) atoms after 'draw'.");
+    REQUIRE(runMode("(draw (map (pi (range 3)) (point 1 1)))", mode) == "Error: Invalid 'map' Symbol.");
+    REQUIRE(runMode("(draw (map (t (range 3)) (point 1 1) (point 2 2)))", mode) == "Error: Invalid 'map' syntax.");
+    REQUIRE(runMode("(begin (draw (map (t (range 2)) (point t t))) (define t 1))", mode) == "1 (0,0) (1,1)");
+  }
+}
+
+TEST_CASE( "Test lambda and user procedure calls", "[interpreter]" ) {
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    REQUIRE(runMode("(begin (define sq (lambda (x) (* x x))) (sq 7))", mode) == "49");
+    REQUIRE(runMode("((lambda (x y) (- x y)) 10 3)", mode) == "7");
+    REQUIRE(runMode("(begin (define fact (lambda (n) (if (< n 1) 1 (* n (fact (- n 1)))))) (fact 5))", mode) == "120");
+    // a parameter hides a global, and an enclosing parameter is captured
+    REQUIRE(runMode("(begin (define x 100) (define f (lambda (x) (+ x 1))) (+ (f 1) x))", mode) == "102");
+    REQUIRE(runMode("(begin (define adder (lambda (a) (lambda (b) (+ a b)))) (define add5 (adder 5)) (add5 10))",
+      mode) == "15");
+    REQUIRE(runMode("(begin (define f (lambda (x) (lambda (x) (* x 3)))) ((f 1) 5))", mode) == "15");
+    REQUIRE(runMode("(begin (define f (lambda (h) (h 21))) (f (lambda (a) (* a 2))))", mode) == "42");
+    // a parameter that is not a procedure ignores the rest of the list
+    REQUIRE(runMode("(begin (define f (lambda (x) (x 1 2))) (f 5))", mode) == "5");
+    REQUIRE(runMode("(begin (define f (lambda (p n) (draw p) n)) (f (point 1 1) 2))", mode) == "2 (1,1)");
+    REQUIRE(runMode("(begin (define f (lambda (n) (draw (map (i (range n)) (point i n))))) (f 2))", mode) ==
+      "None (0,2) (1,2)");
+    REQUIRE(runMode("(begin (define f (lambda (x y) (+ x y))) (f 1))", mode) ==
+      "Error: Wrong number of arguments for lambda.");
+    REQUIRE(runMode("(begin (define f (lambda (x) x)) (f))", mode) == "Error: Wrong number of arguments for lambda.");
+    REQUIRE(runMode("(lambda (x))", mode) == "Error: Invalid 'lambda' syntax.");
+    REQUIRE(runMode("(lambda (x 1) x)", mode) == "Error: Invalid 'lambda' syntax.");
+    REQUIRE(runMode("(lambda (x x) x)", mode) == "Error: Invalid 'lambda' Symbol.");
+    REQUIRE(runMode("(lambda (sin) 1)", mode) == "Error: Invalid 'lambda' Symbol.");
+    REQUIRE(runMode("((+ 1 2) 4)", mode) ==
+      "Error: Invalid procedure, expression, number, boolean or special form.");
+  }
+
+  {
+    // a lambda outlives the program that made it
+    Interpreter interp;
+    std::istringstream first("(define tree (lambda (n) (if (< n 1) 1 (+ (tree (- n 1)) (tree (- n 1))))))");
+    REQUIRE(interp.parse(first));
+    interp.eval();
+    std::istringstream second("(tree 10)");
+    REQUIRE(interp.parse(second));
+    REQUIRE(interp.eval() == Expression(1024.));
+  }
+
+  {
+    // recursion in the tree walker uses no native stack
+    std::istringstream iss("(begin (define deep (lambda (n) (if (< n 1) 0 (+ 1 (deep (- n 1)))))) (deep 100000))");
+    Interpreter interp;
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(100000.));
+  }
+}
+
+TEST_CASE( "Test let, cond and short-circuit and/or", "[interpreter]" ) {
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    // the arguments after the first that decides the value are never evaluated
+    REQUIRE(runMode("(and False (/ 1 0))", mode) == "False");
+    REQUIRE(runMode("(or True (draw 1))", mode) == "True");
+    REQUIRE(runMode("(and True (< 1 2) (> 1 2))", mode) == "False");
+    REQUIRE(runMode("(begin (or (< 2 1) (begin (draw (point 1 1)) True) (draw 5)) 3)", mode) == "3 (1,1)");
+    REQUIRE(runMode("(and True 1)", mode) == "Error: 'and' arguments must evaluate to Booleans.");
+    REQUIRE(runMode("(or False 1)", mode) == "Error: 'or' arguments must evaluate to Booleans.");
+    REQUIRE(runMode("(and)", mode) == "Error: Invalid 'and' syntax.");
+
+    // the values are evaluated before any local is in scope
+    REQUIRE(runMode("(let ((x 2) (y 3)) (* x y))", mode) == "6");
+    REQUIRE(runMode("(begin (define x 10) (let ((x 1) (y x)) (+ x y)))", mode) == "11");
+    REQUIRE(runMode("(let ((x 1)) (let ((x (+ x 1)) (y x)) (+ (* 10 x) y)))", mode) == "21");
+    REQUIRE(runMode("(let ((x 1)) (draw (point x x)) x)", mode) == "1 (1,1)");
+    REQUIRE(runMode("(let ((x (let ((y 4)) (* y y)))) x)", mode) == "16");
+    // locals are not globals, and are captured by a lambda
+    REQUIRE(runMode("(begin (let ((x 1)) x) x)", mode) == "Error: Unknown type: x");
+    REQUIRE(runMode("(begin (define f (let ((k 3)) (lambda (n) (* k n)))) (f 5))", mode) == "15");
+    REQUIRE(runMode("(begin (define f (lambda (n) (let ((m (* n 2))) (+ m n)))) (f 4))", mode) == "12");
+    REQUIRE(runMode("(let ((x 1)))", mode) == "Error: Invalid 'let' syntax.");
+    REQUIRE(runMode("(let ((x 1) (x 2)) x)", mode) == "Error: Invalid 'let' Symbol.");
+    REQUIRE(runMode("(let ((sin 1)) sin)", mode) == "Error: Invalid 'let' Symbol.");
+
+    REQUIRE(runMode("(cond ((< 2 1) 1) ((< 1 2) 2) (else 3))", mode) == "2");
+    REQUIRE(runMode("(cond ((< 2 1) 1) (else (draw (point 0 0)) 3))", mode) == "3 (0,0)");
+    REQUIRE(runMode("(cond (False 1))", mode) == "None");
+    REQUIRE(runMode("(cond (True 1) ((/ 1 0) 2))", mode) == "1");
+    REQUIRE(runMode("(cond (1 1))", mode) == "Error: 'cond' test must evaluate to a Boolean.");
+    REQUIRE(runMode("(cond (else 1) (True 2))", mode) == "Error: Invalid 'cond' syntax.");
+    REQUIRE(runMode("(cond)", mode) == "Error: Invalid 'cond' syntax.");
+    REQUIRE(runMode("(begin (define sign (lambda (n) (cond ((< n 0) -1) ((= n 0) 0) (else 1)))) "
+      "(+ (sign -5) (* 10 (sign 3))))", mode) == "9");
+  }
+
+  {
+    // a let in a loop reuses its slots at each iteration
+    std::istringstream iss("(for (i 0 1000) (let ((sq (* i i))) sq))");
+    Interpreter interp;
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(998001.));
+  }
+}
+
+TEST_CASE( "Test type inference and unboxed numeric evaluation", "[interpreter]" ) {
+
+  {
+    // errors are reported before the form runs, and raised only if reached
+    std::istringstream iss("(begin (define b True) (define n 2) (if (< n 1) (+ n b) (* n 3)) "
+      "(if n 1 2) (not (point 1 n)) (draw 5 (map (i (range n)) i)) (- 1 2 3))");
+    std::ostringstream report;
+    Interpreter interp;
+    interp.setTypeCheckEnabled(true);
+    interp.setTypeErrorReport(&report);
+    REQUIRE(interp.parse(iss));
+    REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+    REQUIRE(interp.getTypeCheckStats().errors == 6);
+    REQUIRE(report.str().find("; type error: Invalid argument type for + in (+ n b)\n") != std::string::npos);
+    REQUIRE(report.str().find("'if' condition must evaluate to a Boolean. in (if n 1 2)") != std::string::npos);
+    REQUIRE(report.str().find("not failed, argument not a boolean") != std::string::npos);
+    REQUIRE(report.str().find("'map' sequence") == std::string::npos);
+    REQUIRE(report.str().find("subneg failed, invalid number of arguments in (- 1 2 3)") != std::string::npos);
+  }
+
+  {
+    // only arithmetic on proven Numbers is marked
+    std::istringstream iss("(begin (define a 3) (let ((x (* a 2))) (+ x (- a 1) (/ (sin a) 2))) "
+      "(for (i 0 2) (point (* i a) (+ i 1))) (+ a (if True 1 2)))");
+    Interpreter interp;
+    interp.setTypeCheckEnabled(true);
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(4.));
+    REQUIRE(interp.getTypeCheckStats().numeric == 7);
+    REQUIRE(interp.getTypeCheckStats().errors == 0);
+  }
+
+  RunOptions typecheck;
+  typecheck.typecheck = true;
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    // the errors of the builtins are raised by the unboxed evaluation too
+    REQUIRE(runMode("(begin (define a 2) (+ 1 (/ a (- a 2))))", mode, typecheck) ==
+      "div failed, division by zero");
+    REQUIRE(runMode("(log10 (- 1 1))", mode, typecheck) == "log10 failed, argument must be greater than zero");
+    // a global bound by a define that did not run
+    REQUIRE(runMode("(begin (if False (define z 1) 0) (+ z 1))", mode, typecheck) == "Error: Unknown type: z");
+    REQUIRE(runMode("(begin (if True (define z 1) 0) (+ z 1))", mode, typecheck) == "2");
+    // a define in a loop may run before a use earlier in the loop body
+    REQUIRE(runMode("(begin (for (k 0 3) (if (= k 0) 0 (+ kk 1)) (define kk True)) 1)", mode, typecheck) ==
+      "Invalid argument type for +");
+    REQUIRE(runMode("(begin (define f (lambda (x) (* x x))) (+ (f 3) (* 2 3)))", mode, typecheck) == "15");
+  }
+}
+
+TEST_CASE( "Test inline caching of called procedures", "[interpreter]" ) {
+
+  Interpreter interp;
+  std::istringstream define("(define count (lambda (n) (if (< n 1) 0 (+ 1 (count (- n 1))))))");
+  REQUIRE(interp.parse(define));
+  interp.eval();
+
+  // each call site looks up its head once, then hits the cache
+  std::istringstream program("(+ (count 3) (count 4))");
+  REQUIRE(interp.parse(program));
+  REQUIRE(interp.eval() == Expression(7.));
+  CallCacheStats first = interp.getCallCacheStats();
+  REQUIRE(first.misses == 7);
+  REQUIRE(first.hits == 33 - first.misses);
+
+  // evaluating the parsed program again does no lookups
+  REQUIRE(interp.eval() == Expression(7.));
+  REQUIRE(interp.getCallCacheStats().misses == first.misses);
+  REQUIRE(interp.getCallCacheStats().hits == first.hits + 33);
+
+  // a cache filled in one environment is never used in another
+  Expression call;
+  call.head.type = ListType;
+  call.tail.push_back(Expression(std::string("count")));
+  call.tail.push_back(Expression(3.));
+  REQUIRE(interp.eval(call) == Expression(3.));
+  Interpreter other;
+  std::istringstream redefine("(begin (define unused (lambda (x) x)) (define count (lambda (n) (* n 10))))");
+  REQUIRE(other.parse(redefine));
+  other.eval();
+  REQUIRE(other.eval(call) == Expression(30.));
+
+  // a line parsed again starts cold, unless its calls are shared by hash-consing
+  for(bool hashcons : {false, true}){
+    Interpreter repl;
+    repl.setHashConsEnabled(hashcons);
+    for(int i = 0; i < 3; ++i){
+      std::istringstream line("(draw (line (point 0 0) (point 1 1)) (point 2 (* 2 pi)))");
+      REQUIRE(repl.parse(line));
+      repl.eval();
+    }
+    REQUIRE(repl.getCallCacheStats().hits == (hashcons ? 10 : 0));
+    REQUIRE(repl.getCallCacheStats().misses == (hashcons ? 5 : 15));
+  }
+}
+
+TEST_CASE( "Test hash-consing of repeated calls of builtins", "[interpreter]" ) {
+
+  {
+    std::istringstream iss("(begin (draw (line (point 0 0) (point 1 1)) (line (point 0 0) (point 1 1))) "
+      "(+ (* 2 pi) (* 2 pi)))");
+    Interpreter interp;
+    interp.setHashConsEnabled(true);
+    REQUIRE(interp.parse(iss));
+    HashConsStats stats = interp.getHashConsStats();
+    REQUIRE(stats.lists == 4);
+    REQUIRE(stats.shared == 4);
+    REQUIRE(stats.bytesSaved == 4 * (ARENA_HEADER + 3 * sizeof(Expression)));
+    REQUIRE(interp.eval() == Expression(4 * std::atan2(0, -1)));
+    REQUIRE(interp.getGraphicsVector().size() == 2);
+    REQUIRE(Expression(interp.getGraphicsVector()[1]) == Expression(std::make_tuple(0., 0.), std::make_tuple(1., 1.)));
+
+    // shared with the next program, and with itself when evaluated again
+    std::istringstream again("(+ (* 2 pi) (point 1 1))");
+    REQUIRE(interp.parse(again));
+    REQUIRE(interp.getHashConsStats().shared == 6);
+    REQUIRE(interp.getHashConsStats().lists == 4);
+  }
+
+  {
+    // only globals bound before the program is parsed may be read
+    Interpreter interp;
+    interp.setHashConsEnabled(true);
+    std::istringstream define("(define x 2)");
+    REQUIRE(interp.parse(define));
+    interp.eval();
+    std::istringstream iss("(begin (define y 3) (+ (* x 2) (* x 2) (* y 2) (* y 2)))");
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.getHashConsStats().shared == 1);
+    REQUIRE(interp.eval() == Expression(20.));
+  }
+
+  RunOptions hashcons;
+  hashcons.hashcons = true;
+  RunOptions checked = hashcons;
+  checked.typecheck = true;
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    // a shared list reading a global is copied where a local hides it
+    REQUIRE(runMode("(begin (+ (* 2 pi) 0) (let ((pi 1)) (+ (* 2 pi) 0)))", mode, hashcons) == "2");
+    REQUIRE(runMode("(begin (+ (* 2 pi) 0) ((lambda (pi) (+ (* 2 pi) 0)) 3))", mode, hashcons) == "6");
+    REQUIRE(runMode("(begin (+ (* 2 pi) 0) ((lambda (pi) (+ (* 2 pi) 0)) 3))", mode, checked) == "6");
+    REQUIRE(runMode("(- (+ (/ 1 0) 1) (+ (/ 1 0) 1))", mode, checked) == "div failed, division by zero");
+  }
+}
+
+TEST_CASE( "Test caching the values of shared lists across programs", "[interpreter]" ) {
+
+  Interpreter interp;
+  interp.setHashConsEnabled(true);
+  interp.setResultCacheCapacity(Interpreter::DEFAULT_RESULT_CACHE);
+  auto run = [&interp](const std::string & program){
+    std::istringstream iss(program);
+    REQUIRE(interp.parse(iss));
+    return interp.eval();
+  };
+
+  REQUIRE(run("(define r 5)") == Expression(5.));
+  // (point 0 0) and (point r 0) are evaluated once each, then found
+  REQUIRE(run("(draw (arc (point 0 0) (point r 0) (* 2 pi)) (line (point 0 0) (point r 0)))") == Expression());
+  REQUIRE(interp.getResultCacheStats().misses == 5);
+  REQUIRE(interp.getResultCacheStats().hits == 2);
+  // a line entered again is found whole
+  REQUIRE(run("(draw (arc (point 0 0) (point r 0) (* 2 pi)) (line (point 0 0) (point r 0)))") == Expression());
+  REQUIRE(interp.getResultCacheStats().misses == 5);
+  REQUIRE(interp.getResultCacheStats().hits == 4);
+  REQUIRE(interp.getGraphicsVector().size() == 4);
+  REQUIRE(interp.getGraphicsVector()[0].type == ArcType);
+  REQUIRE(interp.getGraphicsVector()[2].type == ArcType);
+  REQUIRE(Expression(interp.getGraphicsVector()[3]) == Expression(std::make_tuple(0., 0.), std::make_tuple(5., 0.)));
+
+  // errors are raised each time, and never cached
+  REQUIRE_THROWS_AS(run("(+ 1 (/ r 0))"), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(run("(+ 1 (/ r 0))"), InterpreterSemanticError);
+  REQUIRE(interp.getResultCacheStats().hits == 4);
+
+  // a capacity of one keeps only the last value
+  interp.setResultCacheCapacity(1);
+  REQUIRE(run("(+ (* 2 r) (* 3 r) (* 2 r))") == Expression(35.));
+  REQUIRE(interp.getResultCacheStats().hits == 4);
+  REQUIRE(run("(+ 1 (* 2 r))") == Expression(11.));
+  REQUIRE(interp.getResultCacheStats().hits == 5);
+
+  // turned off, nothing is looked up
+  interp.setResultCacheCapacity(0);
+  ResultCacheStats off = interp.getResultCacheStats();
+  REQUIRE(run("(+ 1 (* 3 r))") == Expression(16.));
+  REQUIRE(interp.getResultCacheStats().hits == off.hits);
+  REQUIRE(interp.getResultCacheStats().misses == off.misses);
+}
+
+TEST_CASE( "Test constant folding and propagation", "[interpreter]" ) {
+
+  {
+    std::string program = "(begin (define r (* 2 pi)) (define d (+ r 1)) "
+      "(if (< r 7) (draw (point r 0)) (/ 1 0)) (+ d (sin 0)))";
+    std::istringstream iss(program);
+    std::ostringstream dump;
+    Interpreter interp;
+    interp.setOptimizeEnabled(true);
+    interp.setAstDump(&dump);
+
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(2 * atan2(0, -1) + 1));
+    REQUIRE(interp.getGraphicsVector().size() == 1);
+    REQUIRE(interp.getOptimizerStats().folded == 7);
+    REQUIRE(interp.getOptimizerStats().propagated == 5);
+    REQUIRE(dump.str().find("(draw (6.28319,0))") != std::string::npos);
+  }
+
+  {
+    // a call that fails is left to fail when evaluated
+    std::istringstream iss("(begin (draw (point 1 1)) (/ 1 0))");
+    Interpreter interp;
+    interp.setOptimizeEnabled(true);
+
+    REQUIRE(interp.parse(iss));
+    REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+    REQUIRE(interp.getGraphicsVector().size() == 1);
+    REQUIRE(interp.getOptimizerStats().folded == 1);
+  }
+}
+
+TEST_CASE( "Test parsing deeply nested lists", "[interpreter]" ) {
+
+  // (+ 1 (+ 1 ... 1)) nested depth lists deep
+  auto nested = [](std::size_t depth) {
+    std::string program;
+    for (std::size_t i = 0; i < depth; ++i) {
+      program += "(+ 1 ";
+    }
+    return program + "1" + std::string(depth, ')');
+  };
+
+  {
+    // deeper than the native stack allows a recursive parser
+    std::istringstream iss(nested(100000));
+    Interpreter interp;
+    interp.setMaxNesting(100000);
+    REQUIRE(interp.parse(iss));
+  }
+
+  {
+    std::istringstream iss(nested(Interpreter::DEFAULT_MAX_NESTING));
+    Interpreter interp;
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(10001.));
+  }
+
+  {
+    std::istringstream iss(nested(Interpreter::DEFAULT_MAX_NESTING + 1));
+    Interpreter interp;
+    REQUIRE_FALSE(interp.parse(iss));
+  }
+
+  {
+    std::istringstream iss("(begin (+ 1 (+ 2 3)))");
+    Interpreter interp;
+    interp.setMaxNesting(2);
+    REQUIRE_THROWS_AS(interp.evalStream(iss), InterpreterSemanticError);
+  }
+
+  {
+    std::istringstream iss("(begin (+ 1 2) (+ 3 4))");
+    Interpreter interp;
+    interp.setMaxNesting(2);
+    REQUIRE(interp.evalStream(iss) == Expression(7.));
+  }
+
+  {
+    std::istringstream iss(nested(50000));
+    TokenSequenceType tokens = tokenize(iss);
+    Interpreter interp;
+    interp.setMaxNesting(50000);
+    Expression exp = interp.read_from_tokens(tokens);
+    REQUIRE(exp.head.type == ListType);
+    REQUIRE(tokens.empty());
+  }
+}
+
+TEST_CASE( "Test evaluating deeply nested expressions", "[interpreter]" ) {
+
+  {
+    // far deeper than a recursive eval could go
+    std::string program;
+    for (std::size_t i = 0; i < 100000; ++i) {
+      program += "(+ 1 ";
+    }
+    program += "1" + std::string(100000, ')');
+    std::istringstream iss(program);
+    Interpreter interp;
+    interp.setMaxNesting(100000);
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(100001.));
+  }
+
+  {
+    // the branches of if and the last form of begin are tail positions
+    std::string program;
+    for (std::size_t i = 0; i < 40000; ++i) {
+      program += "(if True (begin (draw (point 0 0)) ";
+    }
+    program += "7";
+    for (std::size_t i = 0; i < 40000; ++i) {
+      program += ") False)";
+    }
+    std::istringstream iss(program);
+    Interpreter interp;
+    interp.setMaxNesting(100000);
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(7.));
+    REQUIRE(interp.getGraphicsVector().size() == 40000);
+  }
+
+  {
+    // an error leaves the evaluator ready for the next program
+    Interpreter interp;
+    std::istringstream first("(begin (define a 1) (+ 1 (- 2 (draw a))))");
+    REQUIRE(interp.parse(first));
+    REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+    std::istringstream second("(+ a (* 2 3))");
+    REQUIRE(interp.parse(second));
+    REQUIRE(interp.eval() == Expression(7.));
+  }
+}
+
+TEST_CASE( "Test eliminating unused pure defines", "[interpreter]" ) {
+
+  auto eliminated = [](const std::string & program, bool optimize){
+    std::istringstream iss(program);
+    Interpreter interp;
+    interp.setOptimizeEnabled(optimize);
+    interp.setDeadCodeEnabled(true);
+    REQUIRE(interp.parse(iss));
+    interp.eval();
+    return interp.getDeadCodeStats();
+  };
+
+  {
+    std::istringstream iss("(begin (define r 5) (define unused (point r 0)) (define chain (* 2 r)) "
+      "(define helper (line (point 0 0) (point chain 0))) (define f (lambda (x) x)) "
+      "(define used (point r r)) (draw used) (+ r 1))");
+    Interpreter interp;
+    interp.setDeadCodeEnabled(true);
+    REQUIRE(interp.parse(iss));
+    REQUIRE(interp.eval() == Expression(6.));
+    // helper goes first, leaving chain unused
+    REQUIRE(interp.getDeadCodeStats().defines == 3);
+    REQUIRE(interp.getDeadCodeStats().nodes == 7 + 7 + 13);
+    REQUIRE(interp.getGraphicsVector().size() == 1);
+    REQUIRE(Expression(interp.getGraphicsVector()[0]) == Expression(std::make_tuple(5., 5.)));
+
+    // removed defines are never bound
+    std::istringstream later("(begin r used unused)");
+    REQUIRE(interp.parse(later));
+    REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+  }
+
+  // defines that may raise an error are kept
+  REQUIRE(eliminated("(begin (define a (log10 1)) (define b (/ 1 2)) (define c (range 1 3)) 0)", false).defines == 3);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a (/ 1 0)) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a (log10 0)) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a (range 1 3 0)) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a (not 1)) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a 1) (define a 2) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define pi 1) 0)", false), InterpreterSemanticError);
+  REQUIRE_THROWS_AS(eliminated("(begin (define a (/ 1 b)) (define b 0) 0)", false), InterpreterSemanticError);
+
+  // as are the last form, defines used anywhere, lambdas and defines
+  // in other forms
+  REQUIRE(eliminated("(begin 1 (define a 2))", false).defines == 0);
+  REQUIRE(eliminated("(begin (define a 2) (if False (for (a 0 1) a) 0) 0)", false).defines == 0);
+  REQUIRE(eliminated("(begin (define a 2) (lambda (a) 1) 0)", false).defines == 0);
+  REQUIRE(eliminated("(begin (define f (lambda (x) x)) 0)", false).defines == 0);
+  REQUIRE(eliminated("(begin (if True (define a 1) 0) 0)", false).defines == 0);
+  REQUIRE(eliminated("(define a 1)", false).defines == 0);
+
+  // the uses the Optimizer propagates away no longer count
+  REQUIRE(eliminated("(begin (define n 4) (draw (point n n)) 0)", false).defines == 0);
+  REQUIRE(eliminated("(begin (define n 4) (draw (point n n)) 0)", true).nodes == 4);
+
+  // streamed forms are never seen whole
+  std::istringstream iss("(begin (define a 1) 0)");
+  Interpreter interp;
+  interp.setDeadCodeEnabled(true);
+  REQUIRE(interp.evalStream(iss) == Expression(0.));
+  REQUIRE(interp.getDeadCodeStats().defines == 0);
+}
+
+TEST_CASE( "Test hoisting common subexpressions into temporaries", "[interpreter]" ) {
+
+  auto hoisted = [](const std::string & program){
+    std::istringstream iss(program);
+    Interpreter interp;
+    interp.setCseEnabled(true);
+    REQUIRE(interp.parse(iss));
+    interp.eval();
+    return interp.getCseStats();
+  };
+  RunOptions cse;
+  cse.cse = true;
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    std::ifstream ifs(TEST_FILE_DIR + "/test_car.slp");
+    std::string car((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    REQUIRE(runMode(car, mode, cse) == runMode(car, mode));
+
+    std::istringstream iss(car);
+    Interpreter interp;
+    interp.setEvalMode(mode);
+    interp.setCseEnabled(true);
+    REQUIRE(interp.parse(iss));
+    interp.eval();
+    REQUIRE(interp.getCseStats().temporaries == 9);
+    REQUIRE(interp.getCseStats().replaced == 18);
+  }
+
+  // computed once per iteration of the loops whose indices they use,
+  // and once for all of them otherwise
+  {
+    std::istringstream iss("(begin (define r 2) (for (i 0 2) (for (j 0 2) "
+      "(draw (point (* r i) j) (point (* r i) (+ j 1)) (point (* r r) (* r r))))))");
+    std::ostringstream dump;
+    Interpreter interp;
+    interp.setCseEnabled(true);
+    interp.setAstDump(&dump);
+    REQUIRE(interp.parse(iss));
+    interp.eval();
+    REQUIRE(dump.str().find("(begin\n  (define r 2)\n  (let (($1 (* r r))) (for (i 0 2) (let (($0 (* r i))) "
+      "(for (j 0 2) (draw (point $0 j) (point $0 (+ j 1)) (point $1 $1))))))\n)") != std::string::npos);
+    REQUIRE(dump.str().find("; hoisted 4 subexpressions into 2 temporaries") != std::string::npos);
+    REQUIRE(interp.getGraphicsVector().size() == 12);
+    REQUIRE(Expression(interp.getGraphicsVector()[11]) == Expression(std::make_tuple(4., 4.)));
+  }
+
+  // a value read by another is bound first
+  REQUIRE(hoisted("(let ((a 3)) (+ (* (+ a 1) 2) (* (+ a 1) 2) (+ a 1)))").temporaries == 2);
+  REQUIRE(hoisted("(begin (define a 3) (+ (* a 2) (* a 2)) (define b (* a 2)) (+ b (* b 3) (* b 3)))").replaced == 5);
+
+  // calls that may raise an error, use anything but literals, globals,
+  // loop indices and locals, or are in different loops are left alone
+  REQUIRE(hoisted("(begin (define a 2) (+ (/ 2 a) (/ 2 a) (log10 a) (log10 a)) (range 0 a a) (range 0 a a))").temporaries == 0);
+  REQUIRE(hoisted("(begin (define a 2) (if False (+ (- a 3 4) (- a 3 4) (+ a True) (+ a True)) 0))").temporaries == 0);
+  REQUIRE(hoisted("(begin (define f (lambda (x) (+ (* x 2) (* x 2)))) (+ (f 1) (f 1)))").temporaries == 0);
+  REQUIRE(hoisted("(begin (for (i 0 2) (* i 2)) (for (i 0 3) (* i 2)))").temporaries == 0);
+  REQUIRE(hoisted("(begin (if True (define a 2) 0) (+ (* a 2) (* a 2)))").temporaries == 0);
+  REQUIRE(hoisted("(begin (if False (+ (* a 2) (* a 2)) 0) (define a 2) (* a 2))").temporaries == 0);
+  REQUIRE_THROWS_AS(hoisted("(begin (define a 0) (+ (/ 1 a) (/ 1 a)))"), InterpreterSemanticError);
+
+  // hoisted values are computed even where no use would be reached
+  REQUIRE(hoisted("(begin (define a 2) (if False (* a 3) (* a 3)))").temporaries == 1);
+  REQUIRE(runMode("(begin (define a 2) (if False (* a 3) (+ (* a 3) 1)))", Interpreter::TreeEval, cse) == "7");
+}
+
+TEST_CASE( "Test deferring the values of unused defines", "[interpreter]" ) {
+
+  auto lazily = [](const std::string & program, Interpreter::EvalMode mode, Environment::DefineMode defines){
+    std::istringstream iss(program);
+    Interpreter interp;
+    interp.setEvalMode(mode);
+    interp.setDefineMode(defines);
+    std::ostringstream out;
+    try{
+      REQUIRE(interp.parse(iss));
+      out << interp.eval();
+    }
+    catch(const InterpreterSemanticError & e){
+      out << e.what();
+    }
+    for(auto & graphic : interp.getGraphicsVector()){
+      out << " " << Expression(graphic);
+    }
+    return out.str();
+  };
+
+  std::vector<std::string> programs = {
+    "(begin (define a (+ 1 2)) (define b (* a a)) b)",
+    "(begin (define p (point 1 2)) (define q (point 3 4)) (define l (line p q)) (draw l p) 0)",
+    "(begin (for (i 0 3) (define x (+ i 1)) (draw (point x x))) 0)",
+    "(begin (define a (+ 1 2)) (define a 3) 0)", "(begin (define pi (+ 1 2)) 0)",
+    "(begin (define a (/ 1 0)) (define b (+ a 1)) 7)", "(begin (define a (+ True 1)) (if True a 0))",
+    "(begin (define f (lambda (x) (begin (define y (* x 2)) (+ y 1)))) (f 4))",
+    "(let ((x 1)) (define z (+ 1 2)) (+ x z))", "(cond (True (define c (+ 1 1)) c))",
+    "(begin (define a (+ 1 2)) (a 4 5))", "(begin (define s (sin 1)) (define t (cos s)) (arctan s t))",
+  };
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    // values that cannot fail give the same results whenever they are computed
+    for(auto & program : programs){
+      INFO(program);
+      REQUIRE(lazily(program, mode, Environment::LazyDefine) == runMode(program, Interpreter::TreeEval));
+    }
+
+    // otherwise errors are raised where the value is read, if it is
+    REQUIRE(lazily("(begin (define a (/ 1 0)) (define b (+ a 1)) 7)", mode, Environment::LazyDefineDeferErrors) == "7");
+    REQUIRE(lazily("(begin (define a (+ True 1)) (if False a 0))", mode, Environment::LazyDefineDeferErrors) == "0");
+    REQUIRE(lazily("(begin (define a (+ True 1)) (if True a 0))", mode, Environment::LazyDefineDeferErrors) ==
+      "Invalid argument type for +");
+    REQUIRE(lazily("(begin (define a (/ 1 0)) (define a 3) 0)", mode, Environment::LazyDefineDeferErrors) ==
+      "Error: Invalid define Symbol.");
+    // the value of the last form is the value of the program
+    REQUIRE(lazily("(begin 1 (define a (/ 1 0)))", mode, Environment::LazyDefineDeferErrors) ==
+      "div failed, division by zero");
+  }
+
+  // a value read on a later line is computed there, raising its error at every read
+  {
+    Interpreter interp;
+    interp.setDefineMode(Environment::LazyDefineDeferErrors);
+    std::istringstream first("(begin (define d 0) (define q (/ 1 d)) (define r (+ d 1)) 1)");
+    REQUIRE(interp.parse(first));
+    REQUIRE(interp.eval() == Expression(1.));
+    for(int i = 0; i < 2; ++i){
+      std::istringstream read("(+ q 1)");
+      REQUIRE(interp.parse(read));
+      REQUIRE_THROWS_AS(interp.eval(), InterpreterSemanticError);
+    }
+    std::istringstream other("(begin (define s (* r 2)) (+ s r))");
+    REQUIRE(interp.parse(other));
+    REQUIRE(interp.eval() == Expression(3.));
+  }
+}
+
+TEST_CASE( "Test redefining symbols reactively", "[interpreter]" ) {
+
+  auto run = [](Interpreter & interp, const std::string & program){
+    std::istringstream iss(program);
+    REQUIRE(interp.parse(iss));
+    return interp.eval();
+  };
+  // the graphics each recorded form draws now, by id
+  auto picture = [](const Interpreter & interp, std::map<std::size_t, std::vector<std::string>> & forms){
+    const std::vector<Atom> & graphics = interp.getGraphicsVector();
+    for(std::size_t i = 0; i < graphics.size(); ++i){
+      std::ostringstream out;
+      out << Expression(graphics[i]);
+      forms[interp.getGraphicForms()[i]].push_back(out.str());
+    }
+    for(auto & update : interp.getGraphicsUpdates()){
+      forms[update.form].clear();
+      for(auto & graphic : update.graphics){
+        std::ostringstream out;
+        out << Expression(graphic);
+        forms[update.form].push_back(out.str());
+      }
+    }
+  };
+  auto scene = [](const std::string & radius){
+    return "(begin (define r " + radius + ") (define c (point 0 0)) (define rim (arc c (point r 0) pi))"
+      " (define s 2) (define scale (lambda (x) (* x r))) (draw rim) (draw (point s s))"
+      " (for (i 0 2) (draw (point (scale i) 0))) (+ r 1))";
+  };
+
+  for(auto mode : {Interpreter::TreeEval, Interpreter::BytecodeEval, Interpreter::ClosureEval}){
+    INFO(mode);
+    Interpreter interp;
+    interp.setEvalMode(mode);
+
+    // a redefinition is an error unless reactive
+    run(interp, "(define a 1)");
+    REQUIRE_THROWS_AS(run(interp, "(define a 2)"), InterpreterSemanticError);
+
+    interp.setReactiveEnabled(true);
+    REQUIRE(run(interp, scene("5")) == Expression(6.));
+    REQUIRE(interp.getGraphicsVector().size() == 4);
+    REQUIRE(interp.getReactiveStats().forms == 8);
+    std::map<std::size_t, std::vector<std::string>> forms;
+    picture(interp, forms);
+    interp.clearGraphics();
+
+    // only the defines and draws reading r, directly or not, are evaluated again
+    REQUIRE(run(interp, "(define r 7)") == Expression(7.));
+    REQUIRE(interp.getGraphicsVector().empty());
+    REQUIRE(interp.getReactiveStats().redefinitions == 1);
+    REQUIRE(interp.getReactiveStats().recomputed == 4);
+    picture(interp, forms);
+    interp.clearGraphics();
+    std::vector<std::string> redrawn;
+    for(auto & form : forms){
+      redrawn.insert(redrawn.end(), form.second.begin(), form.second.end());
+    }
+    std::sort(redrawn.begin(), redrawn.end());
+
+    // as if the scene had been run with the new value
+    Interpreter fresh;
+    run(fresh, scene("7"));
+    std::vector<std::string> expected;
+    for(auto & graphic : fresh.getGraphicsVector()){
+      std::ostringstream out;
+      out << Expression(graphic);
+      expected.push_back(out.str());
+    }
+    std::sort(expected.begin(), expected.end());
+    REQUIRE(redrawn == expected);
+    REQUIRE(run(interp, "(scale 2)") == Expression(14.));
+
+    // a redefinition raising an error, or whose dependents raise one, changes nothing
+    REQUIRE_THROWS_AS(run(interp, "(define r (/ 1 0))"), InterpreterSemanticError);
+    REQUIRE_THROWS_AS(run(interp, "(define r (point 1 1))"), InterpreterSemanticError);
+    REQUIRE(interp.getGraphicsUpdates().empty());
+    REQUIRE(run(interp, "(scale 2)") == Expression(14.));
+    REQUIRE(run(interp, "(+ r 0)") == Expression(7.));
+
+    // a form that does not read it is left alone
+    REQUIRE(run(interp, "(define s 3)") == Expression(3.));
+    REQUIRE(interp.getGraphicsUpdates().size() == 3);
+    REQUIRE(interp.getGraphicsUpdates()[2].graphics.size() == 1);
+    interp.clearGraphics();
+
+    // builtins, and symbols defined other than by a top-level define, stay bound
+    REQUIRE_THROWS_AS(run(interp, "(define pi 3)"), InterpreterSemanticError);
+    run(interp, "(define t (begin (define u 1) u))");
+    REQUIRE_THROWS_AS(run(interp, "(define u 2)"), InterpreterSemanticError);
+
+    // forms streamed are recorded the same
+    std::istringstream stream("(define v 1) (draw (point v v)) (define v 2)");
+    REQUIRE(interp.evalStream(stream) == Expression(2.));
+    REQUIRE(interp.getGraphicsUpdates().back().graphics.size() == 1);
+    REQUIRE(Expression(interp.getGraphicsUpdates().back().graphics[0]) == Expression(std::make_tuple(2., 2.)));
+  }
+
+  {
+    // a define whose value is None is redefined like any other
+    Interpreter interp;
+    interp.setReactiveEnabled(true);
+    REQUIRE(run(interp, "(define a (draw (point 1 1)))") == Expression());
+    interp.clearGraphics();
+    REQUIRE(run(interp, "(define a (draw (point 2 2)))") == Expression());
+    REQUIRE(interp.getGraphicsUpdates().size() == 2);
+    REQUIRE(interp.getGraphicsUpdates()[0].graphics.empty());
+    REQUIRE(Expression(interp.getGraphicsUpdates()[1].graphics[0]) == Expression(std::make_tuple(2., 2.)));
+    interp.clearGraphics();
+    REQUIRE_THROWS_AS(run(interp, "(define a (draw (/ 1 0)))"), InterpreterSemanticError);
+    REQUIRE(run(interp, "(begin a)") == Expression());
+
+    // and restored, with the defines its dependents rebound, on an error
+    run(interp, "(define d 1)");
+    run(interp, "(define n (draw (point d d)))");
+    run(interp, "(define m (/ 1 (- 2 d)))");
+    interp.clearGraphics();
+    REQUIRE_THROWS_AS(run(interp, "(define d 2)"), InterpreterSemanticError);
+    REQUIRE(interp.getGraphicsUpdates().empty());
+    REQUIRE(run(interp, "(begin n)") == Expression());
+    REQUIRE(run(interp, "(+ d m)") == Expression(2.));
+    REQUIRE(run(interp, "(define d 3)") == Expression(3.));
+    REQUIRE(run(interp, "(+ d m)") == Expression(2.));
+  }
+}
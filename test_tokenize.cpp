@@ -2,6 +2,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "tokenize.hpp"
 
@@ -82,3 +83,108 @@ TEST_CASE( "Test Tokenizer with empty expression", "[tokenize]" ) {
   REQUIRE( tokens[1] == ")" );
 }
 
+
+TEST_CASE( "Test TokenStream kinds and values", "[tokenize]" ) {
+
+  std::string program = "(define r -1.5e2) ; comment ( ignored\n(draw True False 1abc <=)";
+
+  TokenStream tokens(program);
+
+  std::vector<TokenKind> kinds;
+  std::vector<std::string> texts;
+  while(!tokens.empty()){
+    kinds.push_back(tokens.front().kind);
+    texts.push_back(std::string(tokens.text(tokens.front()), tokens.front().length));
+    if(tokens.front().kind == NumberToken){
+      REQUIRE(tokens.front().number == -150);
+    }
+    tokens.pop_front();
+  }
+
+  std::vector<TokenKind> expected = {OpenToken, SymbolToken, SymbolToken, NumberToken, CloseToken,
+				     OpenToken, SymbolToken, BooleanToken, BooleanToken, InvalidToken,
+				     SymbolToken, CloseToken};
+  REQUIRE(kinds == expected);
+  REQUIRE(texts[1] == "define");
+  REQUIRE(texts[9] == "1abc");
+  REQUIRE(texts[10] == "<=");
+}
+
+TEST_CASE( "Test TokenStream agrees with tokenize", "[tokenize]" ) {
+
+  std::string program = "Line 1\r\n(Line 2 ; Comment\r\nLine 3)\n  (Line 4)";
+
+  std::istringstream iss(program);
+  TokenSequenceType expected = tokenize(iss);
+
+  TokenStream tokens(program);
+  TokenSequenceType result;
+  while(!tokens.empty()){
+    result.push_back(std::string(tokens.text(tokens.front()), tokens.front().length));
+    tokens.pop_front();
+  }
+
+  REQUIRE(result == expected);
+}
+
+TEST_CASE( "Test TokenStream with empty input", "[tokenize]" ) {
+
+  std::string program = "  ; only a comment";
+
+  TokenStream tokens(program);
+
+  REQUIRE(tokens.empty());
+}
+
+TEST_CASE( "Test StreamLexer across buffer refills", "[tokenize]" ) {
+
+  std::string program = "(begin (define radius 12.5) ; a comment longer than the buffer\n"
+                        "(draw (point radius -3e1)) averyveryverylongsymbol True)";
+
+  TokenStream expected(program);
+
+  // a tiny buffer forces tokens and comments to straddle refills
+  std::istringstream iss(program);
+  StreamLexer tokens(iss, 4);
+
+  while(!expected.empty()){
+    REQUIRE_FALSE(tokens.empty());
+    REQUIRE(tokens.front().kind == expected.front().kind);
+    REQUIRE(std::string(tokens.text(tokens.front()), tokens.front().length) ==
+	    std::string(expected.text(expected.front()), expected.front().length));
+    if(expected.front().kind == NumberToken){
+      REQUIRE(tokens.front().number == expected.front().number);
+    }
+    tokens.pop_front();
+    expected.pop_front();
+  }
+  REQUIRE(tokens.empty());
+}
+
+TEST_CASE( "Test StreamLexer with a token ending the input", "[tokenize]" ) {
+
+  // a number and a symbol ending exactly at the end of the input, within
+  // one buffer, and, with a tiny buffer, read across refills up to it
+  std::vector<std::string> programs = {"(+ 1 2) foo", "(+ 1 2) 12.5", "foo", "-3e1",
+                                       "(draw p) averyveryverylongsymbol", "1 234567890"};
+  for(auto program : programs){
+    for(std::size_t capacity : {std::size_t(65536), std::size_t(4), std::size_t(1)}){
+      INFO(program << " " << capacity);
+      TokenStream expected(program);
+      std::istringstream iss(program);
+      StreamLexer tokens(iss, capacity);
+      while(!expected.empty()){
+        REQUIRE_FALSE(tokens.empty());
+        REQUIRE(tokens.front().kind == expected.front().kind);
+        REQUIRE(std::string(tokens.text(tokens.front()), tokens.front().length) ==
+                std::string(expected.text(expected.front()), expected.front().length));
+        if(expected.front().kind == NumberToken){
+          REQUIRE(tokens.front().number == expected.front().number);
+        }
+        tokens.pop_front();
+        expected.pop_front();
+      }
+      REQUIRE(tokens.empty());
+    }
+  }
+}
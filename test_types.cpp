@@ -49,3 +49,88 @@ TEST_CASE( "Test Expression Constructors", "[types]" ) {
 
   REQUIRE(exp1 == Expression());
 }
+
+TEST_CASE( "Test Atom copy and assignment across types", "[types]" ) {
+
+  Atom sym;
+  REQUIRE(token_to_atom("var", sym));
+
+  Atom copy(sym);
+  REQUIRE(copy.type == SymbolType);
+  REQUIRE(copy.value.sym_value == "var");
+
+  Atom num;
+  REQUIRE(token_to_atom("3.5", num));
+  copy = num;
+  REQUIRE(copy.type == NumberType);
+  REQUIRE(copy.value.num_value == 3.5);
+
+  copy = sym;
+  REQUIRE(copy.type == SymbolType);
+  REQUIRE(copy.value.sym_value == "var");
+
+  Atom moved(std::move(copy));
+  REQUIRE(moved.type == SymbolType);
+  REQUIRE(moved.value.sym_value == "var");
+
+  REQUIRE(token_to_atom("True", moved));
+  REQUIRE(moved.type == BooleanType);
+  REQUIRE(moved.value.bool_value == true);
+}
+
+TEST_CASE( "Test Symbol interning", "[types]" ) {
+
+  Symbol a("radius");
+  Symbol b(std::string("radius"));
+  Symbol c("diameter");
+
+  REQUIRE(a == b);
+  REQUIRE(a.id() == b.id());
+  REQUIRE(a != c);
+  REQUIRE(a.name() == "radius");
+  REQUIRE(a == "radius");
+  REQUIRE(c == std::string("diameter"));
+
+  std::size_t size = SymbolTable::global().size();
+  Symbol again("radius");
+  REQUIRE(SymbolTable::global().size() == size);
+  REQUIRE(Symbol::fromId(again.id()) == a);
+
+  REQUIRE(Symbol("define").id() == DefineId);
+  REQUIRE(is_special_form(Symbol("draw")));
+  REQUIRE_FALSE(is_special_form(a));
+}
+
+TEST_CASE( "Test Arena allocation", "[types]" ) {
+
+  Arena arena(256);
+  Arena::Mark start = arena.mark();
+
+  {
+    ArenaScope scope(&arena);
+    REQUIRE(Arena::current() == &arena);
+
+    ExpressionList list;
+    for (int i = 0; i < 100; ++i) {
+      list.push_back(Expression(Number(i)));
+    }
+    REQUIRE(list[99].head.value.num_value == 99);
+    REQUIRE(arena.capacity() > 0);
+
+    {
+      ArenaScope heap(nullptr);
+      REQUIRE(Arena::current() == nullptr);
+    }
+    REQUIRE(Arena::current() == &arena);
+  }
+  REQUIRE(Arena::current() == nullptr);
+
+  std::size_t capacity = arena.capacity();
+  arena.release(start);
+  {
+    ArenaScope scope(&arena);
+    ExpressionList list(100);
+  }
+  // released blocks are reused rather than reallocated
+  REQUIRE(arena.capacity() == capacity);
+}
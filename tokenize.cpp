@@ -1,5 +1,6 @@
 #include "tokenize.hpp"
 #include <cctype>
+#include <cstring>
 
 TokenSequenceType tokenize(std::istream& seq) {
     TokenSequenceType tokens;
@@ -47,3 +48,180 @@ TokenSequenceType tokenize(std::istream& seq) {
 
     return tokens;
 }
+
+namespace {
+
+// Set the kind, length and decoded value of a space-delimited token
+void classify_token(const char* token, std::size_t len, Token& current) {
+    current.length = static_cast<std::uint32_t>(len);
+
+    if (is_valid_number(token, len)) {
+        current.kind = parse_number(token, len, current.number) ? NumberToken : InvalidToken;
+    }
+    else if ((len == 4 && std::memcmp(token, "True", 4) == 0) ||
+        (len == 5 && std::memcmp(token, "False", 5) == 0)) {
+        current.kind = BooleanToken;
+        current.boolean = (len == 4);
+    }
+    else if (is_valid_symbol(token, len)) {
+        current.kind = SymbolToken;
+    }
+    else {
+        current.kind = InvalidToken;
+    }
+}
+
+} // namespace
+
+TokenStream::TokenStream(const std::string& source)
+    : TokenStream(source.data(), source.size()) {
+}
+
+TokenStream::TokenStream(const char* data, std::size_t length)
+    : data(data), length(length), pos(0), has_current(false) {
+    advance();
+}
+
+void TokenStream::advance() {
+    has_current = false;
+
+    while (pos < length) {
+        char c = data[pos];
+
+        // Skip whitespace
+        if (std::isspace(static_cast<unsigned char>(c)) != 0) {
+            pos++;
+            continue;
+        }
+
+        // Ignore from a COMMENT character to the end of the line
+        if (c == COMMENT) {
+            const void* eol = std::memchr(data + pos, '\n', length - pos);
+            pos = (eol == nullptr) ? length : static_cast<const char*>(eol) - data;
+            continue;
+        }
+
+        has_current = true;
+        current.offset = pos;
+
+        if (c == OPEN || c == CLOSE) {
+            // Parentheses are individual tokens
+            current.kind = (c == OPEN) ? OpenToken : CloseToken;
+            current.length = 1;
+            pos++;
+            return;
+        }
+
+        // A space-delimited string
+        while (pos < length && std::isspace(static_cast<unsigned char>(data[pos])) == 0 &&
+            data[pos] != OPEN && data[pos] != CLOSE) {
+            pos++;
+        }
+        classify_token(data + current.offset, pos - current.offset, current);
+        return;
+    }
+}
+
+StreamLexer::StreamLexer(std::istream& input, std::size_t capacity)
+    : input(input), buffer(capacity > 0 ? capacity : 1), pos(0), end(0),
+      has_current(false), in_comment(false) {
+    advance();
+}
+
+void StreamLexer::advance() {
+    has_current = false;
+
+    for (;;) {
+        if (pos == end && !fill(pos)) {
+            return; // end of input
+        }
+
+        // Ignore from a COMMENT character to the end of the line,
+        // which may lie several buffer refills ahead
+        if (in_comment) {
+            const void* eol = std::memchr(buffer.data() + pos, '\n', end - pos);
+            if (eol == nullptr) {
+                pos = end;
+            }
+            else {
+                pos = static_cast<const char*>(eol) - buffer.data();
+                in_comment = false;
+            }
+            continue;
+        }
+
+        char c = buffer[pos];
+
+        // Skip whitespace
+        if (std::isspace(static_cast<unsigned char>(c)) != 0) {
+            pos++;
+            continue;
+        }
+
+        if (c == COMMENT) {
+            in_comment = true;
+            continue;
+        }
+
+        has_current = true;
+
+        if (c == OPEN || c == CLOSE) {
+            // Parentheses are individual tokens
+            current.offset = pos;
+            current.kind = (c == OPEN) ? OpenToken : CloseToken;
+            current.length = 1;
+            pos++;
+            return;
+        }
+
+        // A space-delimited string, refilling until it is complete
+        std::size_t start = pos;
+        for (;;) {
+            while (pos < end && std::isspace(static_cast<unsigned char>(buffer[pos])) == 0 &&
+                buffer[pos] != OPEN && buffer[pos] != CLOSE) {
+                pos++;
+            }
+            if (pos < end) {
+                break;
+            }
+            // fill moves the token to the front even at the end of input
+            const bool more = fill(start);
+            start = 0;
+            if (!more) {
+                break;
+            }
+        }
+        current.offset = start;
+        classify_token(buffer.data() + start, pos - start, current);
+        return;
+    }
+}
+
+bool StreamLexer::fill(std::size_t keep) {
+    // Move the text still in use to the front of the buffer
+    std::size_t kept = end - keep;
+    if (keep > 0) {
+        std::memmove(buffer.data(), buffer.data() + keep, kept);
+    }
+    pos -= keep;
+    end = kept;
+
+    // Only a single token longer than the buffer makes it grow
+    if (end == buffer.size()) {
+        buffer.resize(2 * buffer.size());
+    }
+
+    input.read(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+    std::size_t count = static_cast<std::size_t>(input.gcount());
+    end += count;
+    return count > 0;
+}
+
+std::string read_source(std::istream& seq) {
+    std::string source;
+    char buffer[65536];
+    while (seq.read(buffer, sizeof(buffer)) || seq.gcount() > 0) {
+        source.append(buffer, static_cast<std::size_t>(seq.gcount()));
+    }
+    return source;
+}
@@ -4,6 +4,9 @@
 #include <iostream>
 #include <deque>
 #include <string>
+#include <vector>
+
+#include "expression.hpp"
 
 typedef std::deque<std::string> TokenSequenceType;
 
@@ -16,4 +19,77 @@ const char COMMENT = ';';
 // ignores any whitespace and from any ";" to end-of-line
 TokenSequenceType tokenize(std::istream& seq);
 
+// The kind of a lexed token, numbers and booleans are decoded when lexed
+enum TokenKind { OpenToken, CloseToken, NumberToken, BooleanToken,
+                 SymbolToken, InvalidToken };
+
+// A Token is its kind and the position of its text in the source,
+// it does not own or copy the text
+struct Token {
+  std::size_t offset;
+  std::uint32_t length;
+  TokenKind kind;
+  union {
+    Number number;
+    Boolean boolean;
+  };
+};
+
+// A TokenStream lexes a contiguous source buffer on demand, using the
+// same rules as tokenize, without copying any token text.
+// The buffer must outlive the stream.
+class TokenStream {
+public:
+  explicit TokenStream(const std::string & source);
+  TokenStream(const char * data, std::size_t length);
+
+  bool empty() const { return !has_current; }
+  const Token & front() const { return current; }
+  void pop_front() { advance(); }
+
+  // the text of a token
+  const char * text(const Token & token) const { return data + token.offset; }
+
+private:
+  void advance();
+
+  const char * data;
+  std::size_t length;
+  std::size_t pos;
+  Token current;
+  bool has_current;
+};
+
+// A StreamLexer lexes an input stream through a fixed-size buffer with
+// the same rules as TokenStream. The text of the front token is valid
+// until the next pop_front. The buffer only grows to fit a single token
+// longer than its capacity.
+class StreamLexer {
+public:
+  explicit StreamLexer(std::istream & input, std::size_t capacity = 65536);
+
+  bool empty() const { return !has_current; }
+  const Token & front() const { return current; }
+  void pop_front() { advance(); }
+
+  // the text of a token
+  const char * text(const Token & token) const { return buffer.data() + token.offset; }
+
+private:
+  void advance();
+  // discard the buffer before keep and read more input
+  bool fill(std::size_t keep);
+
+  std::istream & input;
+  std::vector<char> buffer;
+  std::size_t pos;
+  std::size_t end;
+  Token current;
+  bool has_current;
+  bool in_comment;
+};
+
+// read the remainder of a stream into one contiguous buffer
+std::string read_source(std::istream & seq);
+
 #endif
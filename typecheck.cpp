@@ -0,0 +1,524 @@
+#include "typecheck.hpp"
+
+// system includes
+#include <cmath>
+
+// module includes
+#include "interpreter_semantic_error.hpp"
+
+namespace {
+
+const Signature SIGNATURES[] = {
+    { "+", 1, 0, { NumberType, NumberType, NumberType }, NumberType, NumericAdd },
+    { "-", 1, 2, { NumberType, NumberType, NumberType }, NumberType, NumericSub },
+    { "*", 1, 0, { NumberType, NumberType, NumberType }, NumberType, NumericMul },
+    { "/", 2, 2, { NumberType, NumberType, NumberType }, NumberType, NumericDiv },
+    { "pow", 2, 2, { NumberType, NumberType, NumberType }, NumberType, NumericPow },
+    { "log10", 1, 1, { NumberType, NumberType, NumberType }, NumberType, NumericLog10 },
+    { "sin", 1, 1, { NumberType, NumberType, NumberType }, NumberType, NumericSin },
+    { "cos", 1, 1, { NumberType, NumberType, NumberType }, NumberType, NumericCos },
+    { "arctan", 2, 2, { NumberType, NumberType, NumberType }, NumberType, NumericArctan },
+    { "<", 2, 2, { NumberType, NumberType, NumberType }, BooleanType, NotNumeric },
+    { ">", 2, 2, { NumberType, NumberType, NumberType }, BooleanType, NotNumeric },
+    { "<=", 2, 2, { NumberType, NumberType, NumberType }, BooleanType, NotNumeric },
+    { ">=", 2, 2, { NumberType, NumberType, NumberType }, BooleanType, NotNumeric },
+    { "=", 2, 2, { NumberType, NumberType, NumberType }, BooleanType, NotNumeric },
+    { "not", 1, 1, { BooleanType, BooleanType, BooleanType }, BooleanType, NotNumeric },
+    { "point", 2, 2, { NumberType, NumberType, NumberType }, PointType, NotNumeric },
+    { "line", 2, 2, { PointType, PointType, PointType }, LineType, NotNumeric },
+    { "arc", 3, 3, { PointType, PointType, NumberType }, ArcType, NotNumeric },
+    { "range", 1, 3, { NumberType, NumberType, NumberType }, RangeType, NotNumeric },
+};
+
+// a value of type that every builtin taking one accepts, so that a
+// call on such values fails only on a wrong type or arity
+Atom representative(Type type) {
+    const Point p = { 1, 1 };
+    switch (type) {
+    case NumberType:
+        return number_atom(1);
+    case BooleanType:
+        return boolean_atom(true);
+    case PointType:
+        return point_atom(1, 1);
+    case LineType:
+        return line_atom(p, p);
+    case ArcType:
+        return arc_atom(p, p, 1);
+    case RangeType:
+        return range_atom(0, 1, 1);
+    default: {
+        Atom atom;
+        atom.type = type;
+        return atom;
+    }
+    }
+}
+
+// true if exp is a Number literal, set to its value
+bool literal_number(const Expression& exp, Number& value) {
+    if (exp.head.type != NumberType || !exp.tail.empty()) {
+        return false;
+    }
+    value = exp.head.value.num_value;
+    return true;
+}
+
+// true if eval_numeric can evaluate exp, once proven to be a Number
+bool unboxed(const Expression& exp) {
+    switch (exp.head.type) {
+    case NumberType:
+    case SlotType:
+    case SymbolType:
+        return true;
+    case ListType:
+        return exp.head.value.list_info.numeric_op != NotNumeric;
+    case SharedType:
+        return unboxed(*exp.head.value.shared_value);
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+const Signature* builtin_signature(const Symbol& name) {
+    for (const Signature& sig : SIGNATURES) {
+        if (sig.name == name) {
+            return &sig;
+        }
+    }
+    return nullptr;
+}
+
+const Signature* infallible_call(const Expression& exp, const Environment& env) {
+    if (exp.tail.empty() || exp.tail[0].head.type != SymbolType || !env.isProc(exp.tail[0].head.value.sym_value)) {
+        return nullptr;
+    }
+    const Signature* sig = builtin_signature(exp.tail[0].head.value.sym_value);
+    const std::size_t args = exp.tail.size() - 1;
+    if (sig == nullptr || args < sig->min || (sig->max != 0 && args > sig->max)) {
+        return nullptr;
+    }
+
+    // the builtins that raise an error on some values of their types
+    Number value;
+    if (sig->op == NumericDiv && !(literal_number(exp.tail[2], value) && value != 0)) {
+        return nullptr;
+    }
+    if (sig->op == NumericLog10 && !(literal_number(exp.tail[1], value) && value > 0)) {
+        return nullptr;
+    }
+    if (sig->result == RangeType && args == 3 && !(literal_number(exp.tail[3], value) && value != 0)) {
+        return nullptr;
+    }
+    return sig;
+}
+
+TypeChecker::TypeChecker(const Environment& env, std::ostream* out) : env(env), out(out) {
+}
+
+void TypeChecker::check(Expression& exp) {
+    globals.clear();
+    locals.clear();
+    visit(exp, false);
+}
+
+const TypeCheckStats& TypeChecker::stats() const {
+    return counts;
+}
+
+TypeChecker::Inferred TypeChecker::unknown() {
+    Inferred inferred = { false, NoneType };
+    return inferred;
+}
+
+TypeChecker::Inferred TypeChecker::proven(Type type) {
+    Inferred inferred = { true, type };
+    return inferred;
+}
+
+// the value of one of two expressions
+TypeChecker::Inferred TypeChecker::merge(const Inferred& a, const Inferred& b) {
+    return a.known && b.known && a.type == b.type ? a : unknown();
+}
+
+// the type of a global, which can never be bound to another value
+TypeChecker::Inferred TypeChecker::global(const Symbol& sym) const {
+    if (sym.id() < globals.size() && globals[sym.id()].known) {
+        return globals[sym.id()];
+    }
+    const Environment::EnvResult* binding = env.lookup(sym);
+    if (binding != nullptr && binding->type == Environment::ExpressionType) {
+        return proven(binding->exp.head.type);
+    }
+    if (binding != nullptr && binding->type == Environment::ThunkType && binding->result != NoneType) {
+        return proven(binding->result);
+    }
+    return unknown();
+}
+
+void TypeChecker::report(const std::string& message, const Expression& exp) {
+    ++counts.errors;
+    if (out != nullptr) {
+        *out << "; type error: " << message << " in ";
+        write_sexp(*out, exp);
+        *out << std::endl;
+    }
+}
+
+// report message if value is proven, but not valid
+void TypeChecker::expect(const Inferred& value, bool valid, const char* message, const Expression& exp) {
+    if (value.known && !valid) {
+        report(message, exp);
+    }
+}
+
+// conditional is true inside a branch that may not be taken, where
+// a define does not bind its symbol for later forms
+TypeChecker::Inferred TypeChecker::visit(Expression& exp, bool conditional) {
+    switch (exp.head.type) {
+    case ListType:
+        return visitList(exp, conditional);
+    case SymbolType:
+        // a builtin alone is called with no arguments
+        return env.isProc(exp.head.value.sym_value) ? unknown() : global(exp.head.value.sym_value);
+    case SlotType:
+        return exp.head.value.slot_value < locals.size() ? locals[exp.head.value.slot_value] : unknown();
+    case SharedType:
+        // proven the same wherever it is shared
+        return visit(*exp.head.value.shared_value, conditional);
+    case NoneType:
+        return unknown();
+    default:
+        return proven(exp.head.type);
+    }
+}
+
+// the value of exp.tail[first..] evaluated in order
+TypeChecker::Inferred TypeChecker::visitBody(Expression& exp, std::size_t first, bool conditional) {
+    Inferred last = proven(NoneType);
+    for (std::size_t i = first; i < exp.tail.size(); ++i) {
+        last = visit(exp.tail[i], conditional);
+    }
+    return last;
+}
+
+// the body exp.tail[first..] of a loop, which may run any number of times
+TypeChecker::Inferred TypeChecker::visitLoop(Expression& exp, std::size_t first, const Symbol& index) {
+    if (globals.size() <= index.id()) {
+        globals.resize(index.id() + 1, unknown());
+    }
+    // the index is a Number only while the loop runs
+    Inferred outside = globals[index.id()];
+    globals[index.id()] = proven(NumberType);
+    Inferred last = visitBody(exp, first, true);
+    globals[index.id()] = outside;
+    return last;
+}
+
+// a map that is an argument of draw
+void TypeChecker::visitMap(Expression& exp, bool conditional) {
+    if (!is_valid_map(exp)) {
+        return;
+    }
+    Expression& range = exp.tail[1];
+    Inferred sequence = visit(range.tail[1], conditional);
+    expect(sequence, sequence.type == RangeType, "Error: 'map' sequence must evaluate to a Range.", exp);
+    Inferred graphic = visitLoop(exp, 2, range.tail[0].head.value.sym_value);
+    expect(graphic, is_graphic(representative(graphic.type)), "Error: Invalid(non-graphic) atoms after 'draw'.",
+        exp);
+}
+
+TypeChecker::Inferred TypeChecker::visitList(Expression& exp, bool conditional) {
+    // a list is only marked once proven again
+    exp.head.value.list_info.numeric_op = NotNumeric;
+    if (exp.tail.empty()) {
+        return unknown();
+    }
+
+    const Expression& first = exp.tail[0];
+
+    if (first.head.type == BooleanType || first.head.type == NumberType) {
+        // the rest of the list is never evaluated
+        return proven(first.head.type);
+    }
+    if (first.head.type != SymbolType) {
+        // a user procedure called on the rest, if the head is one
+        visitBody(exp, 0, true);
+        return unknown();
+    }
+
+    const Symbol name = first.head.value.sym_value;
+    switch (name.id()) {
+    case DefineId: {
+        if (exp.tail.size() != 3 || exp.tail[1].head.type != SymbolType) {
+            return unknown();
+        }
+        Inferred value = visit(exp.tail[2], conditional);
+        const Symbol& sym = exp.tail[1].head.value.sym_value;
+        // a define that will fail binds nothing
+        if (!conditional && value.known && !is_special_form(sym) && !global(sym).known &&
+            env.lookup(sym) == nullptr) {
+            if (globals.size() <= sym.id()) {
+                globals.resize(sym.id() + 1, unknown());
+            }
+            globals[sym.id()] = value;
+        }
+        return value;
+    }
+    case BeginId:
+        return visitBody(exp, 1, conditional);
+    case IfId: {
+        if (exp.tail.size() != 4) {
+            return unknown();
+        }
+        Inferred condition = visit(exp.tail[1], conditional);
+        expect(condition, condition.type == BooleanType, "Error: 'if' condition must evaluate to a Boolean.", exp);
+        Inferred consequent = visit(exp.tail[2], true);
+        return merge(consequent, visit(exp.tail[3], true));
+    }
+    case DrawId:
+        if (exp.tail.size() < 2) {
+            return unknown();
+        }
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            Expression& arg = exp.tail[i];
+            if (is_map(arg)) {
+                visitMap(arg, conditional);
+                continue;
+            }
+            Inferred graphic = visit(arg, conditional);
+            expect(graphic, is_graphic(representative(graphic.type)),
+                "Error: Invalid(non-graphic) atoms after 'draw'.", exp);
+        }
+        return proven(NoneType);
+    case ForId: {
+        if (!is_valid_for(exp)) {
+            return unknown();
+        }
+        Expression& range = exp.tail[1];
+        for (std::size_t i = 1; i < range.tail.size(); ++i) {
+            Inferred bound = visit(range.tail[i], conditional);
+            expect(bound, bound.type == NumberType, "Error: 'for' range must evaluate to Numbers.", exp);
+        }
+        visitLoop(exp, 2, range.tail[0].head.value.sym_value);
+        // None if the body never runs
+        return unknown();
+    }
+    case RepeatId: {
+        if (exp.tail.size() < 3) {
+            return unknown();
+        }
+        Inferred count = visit(exp.tail[1], conditional);
+        expect(count, count.type == NumberType, "Error: 'repeat' count must evaluate to a Number.", exp);
+        visitBody(exp, 2, true);
+        return unknown();
+    }
+    case MapId:
+        // only valid as an argument of draw
+        return unknown();
+    case LambdaId:
+        // a lambda form that does not raise an error makes a lambda
+        return proven(LambdaType);
+    case AndId:
+    case OrId:
+        if (exp.tail.size() < 2) {
+            return unknown();
+        }
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            // only the first argument is certain to be evaluated
+            Inferred arg = visit(exp.tail[i], conditional || i > 1);
+            expect(arg, arg.type == BooleanType, name.id() == AndId ?
+                "Error: 'and' arguments must evaluate to Booleans." :
+                "Error: 'or' arguments must evaluate to Booleans.", exp);
+        }
+        return proven(BooleanType);
+    case LetId: {
+        if (!is_valid_let(exp) || !is_resolved_let(exp)) {
+            return unknown();
+        }
+        Expression& bindings = exp.tail[1];
+        std::vector<Inferred> values;
+        for (Expression& binding : bindings.tail) {
+            values.push_back(visit(binding.tail[1], conditional));
+        }
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            std::uint32_t slot = bindings.tail[i].tail[0].head.value.slot_value;
+            if (locals.size() <= slot) {
+                locals.resize(slot + 1, unknown());
+            }
+            locals[slot] = values[i];
+        }
+        return visitBody(exp, 2, conditional);
+    }
+    case CondId: {
+        if (!is_valid_cond(exp)) {
+            return unknown();
+        }
+        Inferred value;
+        for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+            Expression& clause = exp.tail[i];
+            if (!is_else_clause(clause)) {
+                // only the first test is certain to be evaluated
+                Inferred test = visit(clause.tail[0], conditional || i > 1);
+                expect(test, test.type == BooleanType, "Error: 'cond' test must evaluate to a Boolean.", exp);
+            }
+            Inferred body = visitBody(clause, 1, true);
+            value = i == 1 ? body : merge(value, body);
+        }
+        // None when no clause is taken
+        return is_else_clause(exp.tail.back()) ? value : merge(value, proven(NoneType));
+    }
+    default:
+        break;
+    }
+
+    const Environment::EnvResult* binding = env.lookup(name);
+    if (binding != nullptr && binding->type == Environment::ProcedureType) {
+        return visitCall(exp, binding->proc, conditional);
+    }
+    // a defined symbol at the head is the value of the list, unless it
+    // is a user procedure, which is called on the rest
+    visitBody(exp, 1, true);
+    Inferred head = global(name);
+    return head.known && head.type != LambdaType ? head : unknown();
+}
+
+TypeChecker::Inferred TypeChecker::visitCall(Expression& exp, Procedure proc, bool conditional) {
+    const std::size_t base = argTypes.size();
+    for (std::size_t i = 1; i < exp.tail.size(); ++i) {
+        Inferred arg = visit(exp.tail[i], conditional);
+        argTypes.push_back(arg);
+    }
+    // the types of the arguments, on top of argTypes until this returns
+    const Inferred* args = argTypes.data() + base;
+    const std::size_t count = argTypes.size() - base;
+
+    const Signature* sig = builtin_signature(exp.tail[0].head.value.sym_value);
+    if (sig == nullptr) {
+        argTypes.resize(base);
+        return unknown();
+    }
+
+    bool valid = count >= sig->min && (sig->max == 0 || count <= sig->max);
+    bool numeric = sig->op != NotNumeric;
+    for (std::size_t i = 0; i < count; ++i) {
+        valid = valid && (!args[i].known || args[i].type == sig->args[i < 2 ? i : 2]);
+        numeric = numeric && args[i].known && args[i].type == NumberType && unboxed(exp.tail[i + 1]);
+    }
+    if (!valid) {
+        // call the builtin on values of the types proven, or else of the
+        // types it takes, for the error it raises on any values
+        try {
+            ArenaRegion region;
+            ArgList values;
+            for (std::size_t i = 0; i < count; ++i) {
+                values.push_back(representative(args[i].known ? args[i].type : sig->args[i < 2 ? i : 2]));
+            }
+            proc(values);
+        }
+        catch (const InterpreterSemanticError& error) {
+            report(error.what(), exp);
+        }
+        argTypes.resize(base);
+        // the call never has a value
+        return unknown();
+    }
+    argTypes.resize(base);
+
+    if (numeric) {
+        exp.head.value.list_info.numeric_op = sig->op;
+        ++counts.numeric;
+    }
+    return proven(sig->result);
+}
+
+namespace {
+
+Number eval_list(const Expression& exp, Environment& env, const Atom* frame);
+
+// the value of an argument, without a call unless it is a list
+inline Number eval_arg(const Expression& exp, Environment& env, const Atom* frame) {
+    switch (exp.head.type) {
+    case NumberType:
+        return exp.head.value.num_value;
+    case SlotType:
+        return frame[exp.head.value.slot_value].value.num_value;
+    case SymbolType: {
+        // a global defined by a form that may not have run
+        const Atom* value = env.value(exp.head.value.sym_value);
+        if (value == nullptr) {
+            throw InterpreterSemanticError("Error: Unknown type: " + exp.head.value.sym_value.name());
+        }
+        return value->value.num_value;
+    }
+    case SharedType:
+        return eval_arg(*exp.head.value.shared_value, env, frame);
+    default:
+        return eval_list(exp, env, frame);
+    }
+}
+
+// computed as the builtin does, with the checks on values it makes
+Number eval_list(const Expression& exp, Environment& env, const Atom* frame) {
+    const ExpressionList& args = exp.tail;
+    switch (exp.head.value.list_info.numeric_op) {
+    case NumericAdd: {
+        Number result = 0.0;
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            result += eval_arg(args[i], env, frame);
+        }
+        return result;
+    }
+    case NumericMul: {
+        Number result = 1.0;
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            result *= eval_arg(args[i], env, frame);
+        }
+        return result;
+    }
+    case NumericSub: {
+        Number a = eval_arg(args[1], env, frame);
+        if (args.size() == 2) {
+            return -a;
+        }
+        return a - eval_arg(args[2], env, frame);
+    }
+    case NumericDiv: {
+        Number a = eval_arg(args[1], env, frame);
+        Number b = eval_arg(args[2], env, frame);
+        if (b == 0) {
+            throw InterpreterSemanticError("div failed, division by zero");
+        }
+        return a / b;
+    }
+    case NumericPow: {
+        Number base = eval_arg(args[1], env, frame);
+        return std::pow(base, eval_arg(args[2], env, frame));
+    }
+    case NumericLog10: {
+        Number a = eval_arg(args[1], env, frame);
+        if (a <= 0) {
+            throw InterpreterSemanticError("log10 failed, argument must be greater than zero");
+        }
+        return float(std::log10(a));
+    }
+    case NumericSin:
+        return std::sin(eval_arg(args[1], env, frame));
+    case NumericCos:
+        return std::cos(eval_arg(args[1], env, frame));
+    case NumericArctan: {
+        Number y = eval_arg(args[1], env, frame);
+        return std::atan2(y, eval_arg(args[2], env, frame));
+    }
+    default:
+        throw InterpreterSemanticError("Error: Invalid procedure, expression, number, boolean or special form.");
+    }
+}
+
+} // namespace
+
+Number eval_numeric(const Expression& exp, Environment& env, const Atom* frame) {
+    return eval_arg(exp, env, frame);
+}
@@ -0,0 +1,116 @@
+#ifndef TYPECHECK_HPP
+#define TYPECHECK_HPP
+
+// system includes
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+
+// Counts of what a TypeChecker found
+struct TypeCheckStats {
+    // subexpressions that raise a type error whenever they are evaluated
+    std::size_t errors;
+    // lists proven to evaluate to a Number, marked to be evaluated unboxed
+    std::size_t numeric;
+
+    TypeCheckStats() : errors(0), numeric(0) {}
+};
+
+// The arithmetic builtin a list proven to evaluate to a Number calls,
+// kept in the ListInfo of its head
+enum NumericOp : std::uint32_t {
+    NotNumeric,
+    NumericAdd,
+    NumericSub,
+    NumericMul,
+    NumericDiv,
+    NumericPow,
+    NumericLog10,
+    NumericSin,
+    NumericCos,
+    NumericArctan
+};
+
+// The types of the arguments and value of a builtin, by name
+struct Signature {
+    Symbol name;
+    // how many arguments it takes, any number from min if max is 0
+    std::size_t min;
+    std::size_t max;
+    // the type of each argument, the last for any after it
+    Type args[3];
+    Type result;
+    NumericOp op;
+};
+
+// the signature of the builtin name, nullptr if it has none
+const Signature* builtin_signature(const Symbol& name);
+
+// the signature of the builtin the list exp calls, if it passes as many
+// arguments as it takes and cannot raise an error given arguments of
+// the types it takes, nullptr otherwise
+const Signature* infallible_call(const Expression& exp, const Environment& env);
+
+// The TypeChecker infers the types of the subexpressions of a resolved
+// form before it is evaluated, from its literals, the globals already
+// bound in env and the defines certain to run first, the results of
+// builtins and special forms, and the indices of loops and the locals
+// of lets. A subexpression that raises a type or arity error whenever
+// it is evaluated is reported with the message it raises, and left to
+// raise it if evaluation reaches it. A call of an arithmetic builtin on
+// arguments proven to be Numbers is marked to be evaluated by
+// eval_numeric. The bodies of lambdas are left alone, as their
+// parameters may be anything.
+class TypeChecker {
+public:
+    // report each type error to out, if not nullptr
+    TypeChecker(const Environment& env, std::ostream* out);
+
+    void check(Expression& exp);
+
+    const TypeCheckStats& stats() const;
+
+private:
+    // What is proven of the value of an expression, if it has one
+    struct Inferred {
+        bool known;
+        Type type;
+    };
+
+    static Inferred unknown();
+    static Inferred proven(Type type);
+    static Inferred merge(const Inferred& a, const Inferred& b);
+
+    Inferred visit(Expression& exp, bool conditional);
+    Inferred visitList(Expression& exp, bool conditional);
+    Inferred visitCall(Expression& exp, Procedure proc, bool conditional);
+    Inferred visitBody(Expression& exp, std::size_t first, bool conditional);
+    Inferred visitLoop(Expression& exp, std::size_t first, const Symbol& index);
+    void visitMap(Expression& exp, bool conditional);
+    Inferred global(const Symbol& sym) const;
+    void expect(const Inferred& value, bool valid, const char* message, const Expression& exp);
+    void report(const std::string& message, const Expression& exp);
+
+    const Environment& env;
+    std::ostream* out;
+    // the types of the globals bound by defines certain to have run,
+    // and of the indices of the loops running, by symbol id
+    std::vector<Inferred> globals;
+    // the types of the locals of the lets running, by slot
+    std::vector<Inferred> locals;
+    // the types of the arguments of the calls being checked
+    std::vector<Inferred> argTypes;
+    TypeCheckStats counts;
+};
+
+// the value of exp, a Number, Slot or Symbol proven to hold a Number or
+// a list marked by a TypeChecker, computed without boxing arguments or
+// checking their types, in a frame of slots, forcing the thunks it
+// reads. Raises the same errors as evaluating exp would.
+Number eval_numeric(const Expression& exp, Environment& env, const Atom* frame);
+
+#endif
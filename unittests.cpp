@@ -193,6 +193,7 @@ TEST_CASE("token_to_atom tests") {
         REQUIRE_FALSE(token_to_atom("[22abc", atom));
         REQUIRE_FALSE(token_to_atom("54True123", atom));
         REQUIRE_FALSE(token_to_atom("%5", atom));
+        REQUIRE_FALSE(token_to_atom("1e999", atom));
     }
 }
 
@@ -250,9 +251,10 @@ TEST_CASE("Environment Expression Manipulation") {
         REQUIRE(env.isProc(">="));
         REQUIRE(env.isProc("+"));
         REQUIRE(env.isProc("<="));
-        REQUIRE(env.isProc("and"));
+        // and and or are special forms, which short-circuit
+        REQUIRE(!env.isProc("and"));
         REQUIRE(env.isProc("not"));
-        REQUIRE(env.isProc("or"));
+        REQUIRE(!env.isProc("or"));
         REQUIRE(env.isProc("="));
         REQUIRE(env.isProc(">"));
         REQUIRE(env.isProc("*"));
@@ -328,6 +330,136 @@ TEST_CASE("Environment Expression Reassignment") {
     }
 }
 
+TEST_CASE("Environment Generation") {
+    Environment env;
+    std::uint32_t start = env.generation();
+
+    SECTION("Binding values keeps the generation") {
+        env.addExp("a", Expression(1.0));
+        env.setExp("a", Expression(2.0));
+        env.removeExp("a");
+        REQUIRE(env.generation() == start);
+    }
+
+    SECTION("Unbinding a user procedure or reinitializing starts a new one") {
+        env.addExp("f", Expression(lambda_atom(0)));
+        REQUIRE(env.generation() == start);
+        env.removeExp("f");
+        REQUIRE(env.generation() != start);
+
+        std::uint32_t removed = env.generation();
+        env.init();
+        REQUIRE(env.generation() != removed);
+        REQUIRE(env.generation() != start);
+    }
+
+    SECTION("Undoing a define starts a new one") {
+        env.addExp("a", Expression(1.0));
+        env.undefine("a");
+        REQUIRE(env.generation() != start);
+        REQUIRE(env.lookup("a") == nullptr);
+        env.addExp("a", Expression(2.0));
+        REQUIRE(env.getExp("a") == Expression(2.0));
+    }
+
+    SECTION("No two environments share a generation") {
+        Environment other;
+        REQUIRE(other.generation() != env.generation());
+    }
+}
+
+TEST_CASE("Environment Global Values") {
+    Environment env;
+
+    SECTION("Only symbols bound to expressions have a value") {
+        REQUIRE(env.global("pi") != nullptr);
+        REQUIRE(env.global("pi")->value.num_value == env.getExp("pi").head.value.num_value);
+        REQUIRE(env.global("+") == nullptr);
+        REQUIRE(env.global("never_bound_global") == nullptr);
+    }
+
+    SECTION("The value follows the binding") {
+        env.addExp("g", Expression(1.0));
+        REQUIRE(env.global("g")->value.num_value == 1.0);
+        env.setExp("g", Expression(2.0));
+        REQUIRE(env.global("g")->value.num_value == 2.0);
+        env.removeExp("g");
+        REQUIRE(env.global("g") == nullptr);
+        env.addExp("g", Expression(3.0));
+        REQUIRE(env.global("g")->value.num_value == 3.0);
+        env.init();
+        REQUIRE(env.global("g") == nullptr);
+    }
+}
+
+// the call (name arg...) of a builtin
+Expression call(const std::string& name, const std::vector<Expression>& args) {
+    Expression exp;
+    exp.head.type = ListType;
+    exp.tail.push_back(Expression(name));
+    for (const Expression& arg : args) {
+        exp.tail.push_back(arg);
+    }
+    return exp;
+}
+
+TEST_CASE("Environment Thunks") {
+    Environment env;
+    env.addExp("g", Expression(2.0));
+    const Expression sum = call("+", { Expression(std::string("g")), Expression(1.0) });
+    const Expression quotient = call("/", { Expression(1.0), Expression(std::string("g")) });
+
+    SECTION("Nothing is deferred by default") {
+        REQUIRE(env.defineMode() == Environment::EagerDefine);
+        REQUIRE_FALSE(env.defer("t", sum));
+        REQUIRE_FALSE(env.isKnown("t"));
+    }
+
+    SECTION("A thunk is evaluated when first read, and only then") {
+        env.setDefineMode(Environment::LazyDefine);
+        REQUIRE(env.defer("t", sum));
+        REQUIRE(env.isKnown("t"));
+        REQUIRE_FALSE(env.isExp("t"));
+        REQUIRE(env.global("t") == nullptr);
+        REQUIRE(env.value("t")->value.num_value == 3.0);
+        REQUIRE(env.isExp("t"));
+        REQUIRE(env.global("t") == env.value("t"));
+        REQUIRE(env.force("t") == nullptr);
+    }
+
+    SECTION("The globals a thunk reads are those bound when it was") {
+        env.setDefineMode(Environment::LazyDefine);
+        REQUIRE(env.defer("t", sum));
+        env.setExp("g", Expression(5.0));
+        REQUIRE(env.defer("u", call("*", { Expression(std::string("t")), Expression(std::string("g")) })));
+        REQUIRE(env.value("u")->value.num_value == 15.0);
+        REQUIRE(env.global("t")->value.num_value == 3.0);
+    }
+
+    SECTION("Only calls that cannot fail are deferred unless errors are") {
+        env.setDefineMode(Environment::LazyDefine);
+        REQUIRE_FALSE(env.defer("q", quotient));
+        REQUIRE_FALSE(env.defer("q", Expression(1.0)));
+        REQUIRE_FALSE(env.defer("q", call("+", { Expression(std::string("unbound")) })));
+        REQUIRE_FALSE(env.isKnown("q"));
+
+        env.setDefineMode(Environment::LazyDefineDeferErrors);
+        env.setExp("g", Expression(0.0));
+        REQUIRE(env.defer("q", quotient));
+        REQUIRE_THROWS_AS(env.value("q"), InterpreterSemanticError);
+        REQUIRE_THROWS_AS(env.value("q"), InterpreterSemanticError);
+        REQUIRE(env.lookup("q")->type == Environment::ThunkType);
+    }
+
+    SECTION("A bound symbol cannot be deferred") {
+        env.setDefineMode(Environment::LazyDefine);
+        REQUIRE_THROWS_AS(env.defer("pi", sum), InterpreterSemanticError);
+        REQUIRE_THROWS_AS(env.defer("if", sum), InterpreterSemanticError);
+        REQUIRE(env.defer("t", sum));
+        REQUIRE_THROWS_AS(env.defer("t", sum), InterpreterSemanticError);
+    }
+}
+
 TEST_CASE("Environment Additional Test Cases") {
     Environment env;
 
@@ -432,6 +564,29 @@ TEST_CASE("Environment Additional Test Cases 2") {
     }
 }
 
+TEST_CASE("Environment lookup") {
+    Environment env;
+
+    SECTION("Lookup builtins and defined expressions") {
+        const Environment::EnvResult* plus = env.lookup("+");
+        REQUIRE(plus != nullptr);
+        REQUIRE(plus->type == Environment::ProcedureType);
+        REQUIRE(plus->proc == env.getProc("+"));
+
+        const Environment::EnvResult* pi = env.lookup("pi");
+        REQUIRE(pi != nullptr);
+        REQUIRE(pi->type == Environment::ExpressionType);
+        REQUIRE(&pi->exp == &env.getExp("pi"));
+
+        REQUIRE(env.lookup("undefined_symbol") == nullptr);
+
+        env.addExp("defined_later", Expression(2.0));
+        const Environment::EnvResult* defined = env.lookup("defined_later");
+        REQUIRE(defined != nullptr);
+        REQUIRE(defined->exp == Expression(2.0));
+    }
+}
+
 TEST_CASE("Interpreter Basic Tests") {
     Interpreter interpreter;
 